@@ -0,0 +1,583 @@
+﻿//local
+#include "fsm.h"
+#include "fsm_journal.h"
+#include "fsm_hub.h"
+#include "fsm_columns.h"
+#include "fsm_clock.h"
+//std
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace XYH_StatusMachine;
+
+namespace {
+    typedef boost::asio::steady_timer::clock_type Clock;
+
+    //信号定义
+    enum {
+        SIG_GO      = 1,    //A -> B
+        SIG_BACK    = 2,    //B -> A
+        SIG_SELF    = 3,    //A、B上的自环
+        SIG_TIMEOUT = 4     //B上的定时标签
+    };
+
+    /**
+     说明：单项测试结果
+    */
+    struct Result {
+        //测试名称
+        string name;
+
+        //规模参数名与取值
+        string param;
+        unsigned long long value;
+
+        //操作次数
+        unsigned long long ops;
+
+        //耗时，单位为s
+        double seconds;
+    };
+
+    /**
+     说明：测试用状态；信号处理函数只计数
+    */
+    class BenchStatus : public Xyh_Status {
+    public:
+        BenchStatus(unsigned int id) : Xyh_Status(id, "bench"), routines(0), timers(0) { }
+
+        virtual void routine(shared_ptr<Xyh_Event>& e, unsigned int label, const void* msg) { routines++; }
+
+        virtual void timerRoutine(unsigned int label, shared_ptr<Xyh_Event>& e) { timers++; }
+
+        unsigned long long routines;
+        unsigned long long timers;
+    };
+
+    /**
+     说明：A、B两个状态的测试状态机
+    */
+    struct Machine {
+        boost::asio::io_service io;
+        Xyh_Jsm jsm;
+        shared_ptr<Xyh_Status> a;
+        shared_ptr<Xyh_Status> b;
+
+        explicit Machine(unsigned long long timeoutMs = 0) :
+            jsm(1, io),
+            a(new BenchStatus(1)),
+            b(new BenchStatus(2)) {
+            a->addLink(SIG_GO, b);
+            a->addLink(SIG_SELF);
+            b->addLink(SIG_BACK, a);
+            b->addLink(SIG_SELF);
+            if (timeoutMs) {
+                b->regularMs(SIG_TIMEOUT, timeoutMs);
+            }
+            jsm.addStatus(a);
+            jsm.addStatus(b);
+            jsm.freeze();
+        }
+
+        /**
+         描述：创建n个事件放入指定状态
+         参数：
+           s：       状态
+           first：   第一个事件的id
+           n：       事件数量
+           handles： 返回事件句柄；可为0
+         返回值：无
+        */
+        void populate(shared_ptr<Xyh_Status>& s, unsigned int first, size_t n, vector<Xyh_Handle>* handles) {
+            for (size_t i = 0; i < n; i++) {
+                shared_ptr<Xyh_Event> e = jsm.createEvent(first + (unsigned int)i, "");
+                Xyh_Handle h = jsm.addEvent(e);
+                e->place(s, 0, 0);
+                if (handles) {
+                    handles->push_back(h);
+                }
+            }
+        }
+    };
+
+    double since(Clock::time_point start) {
+        return boost::asio::chrono::duration_cast<boost::asio::chrono::duration<double> >(Clock::now() - start).count();
+    }
+
+    vector<Result> g_results;
+    const char* g_filter = 0;
+    unsigned long long g_scale = 1;
+
+    bool selected(const char* name) {
+        return !g_filter || std::strstr(name, g_filter);
+    }
+
+    void record(const char* name, const char* param, unsigned long long value, unsigned long long ops, double seconds) {
+        Result r;
+        r.name = name;
+        r.param = param;
+        r.value = value;
+        r.ops = ops;
+        r.seconds = seconds;
+        g_results.push_back(r);
+        std::fprintf(stderr, "%-16s %s=%-8llu %10.1f ns/op\n", name, param, value, ops ? seconds * 1e9 / ops : 0.0);
+    }
+
+    /**
+     描述：单个事件在A、B之间往返，A、B中各有perState个其他事件
+    */
+    void benchDispatch(size_t perState) {
+        const unsigned long long ops = 2000000 / g_scale;
+
+        Machine m;
+        m.populate(m.a, 1, perState, 0);
+        m.populate(m.b, 1 + (unsigned int)perState, perState, 0);
+        vector<Xyh_Handle> hs;
+        m.populate(m.a, 0xF0000000, 1, &hs);
+        Xyh_Handle h = hs[0];
+
+        if (selected("process")) {
+            Clock::time_point start = Clock::now();
+            for (unsigned long long i = 0; i < ops; i += 2) {
+                m.jsm.process(h, SIG_GO, 0);
+                m.jsm.process(h, SIG_BACK, 0);
+            }
+            record("process", "per_state", perState, ops, since(start));
+        }
+
+        if (selected("process_norec")) {
+            m.jsm.setRecorder(shared_ptr<Xyh_Recorder>());
+            Clock::time_point start = Clock::now();
+            for (unsigned long long i = 0; i < ops; i += 2) {
+                m.jsm.process(h, SIG_GO, 0);
+                m.jsm.process(h, SIG_BACK, 0);
+            }
+            record("process_norec", "per_state", perState, ops, since(start));
+            m.jsm.setRecorder(shared_ptr<Xyh_Recorder>(new Xyh_Recorder));
+        }
+
+        if (selected("digestion")) {
+            Clock::time_point start = Clock::now();
+            for (unsigned long long i = 0; i < ops; i++) {
+                m.jsm.digestion(h, SIG_SELF, 0);
+            }
+            record("digestion", "per_state", perState, ops, since(start));
+        }
+    }
+
+    /**
+     描述：n个事件在A、B之间整体往返
+    */
+    void benchBroadcast(size_t n) {
+        if (!selected("broadcast")) { return; }
+
+        Machine m;
+        m.populate(m.a, 0, n, 0);
+
+        unsigned long long rounds = std::max<unsigned long long>(2, 4000000 / g_scale / n) & ~1ULL;
+        Clock::time_point start = Clock::now();
+        for (unsigned long long i = 0; i < rounds; i += 2) {
+            m.jsm.process(SIG_GO, 0);
+            m.jsm.process(SIG_BACK, 0);
+        }
+        record("broadcast", "events", n, rounds * n, since(start));
+    }
+
+    /**
+     描述：在已有resident个事件的状态机上反复创建、放置、删除事件
+    */
+    void benchChurn(size_t resident) {
+        if (!selected("churn")) { return; }
+
+        const unsigned long long ops = 1000000 / g_scale;
+
+        Machine m;
+        m.populate(m.a, 0, resident, 0);
+
+        unsigned int id = 0x80000000;
+        Clock::time_point start = Clock::now();
+        for (unsigned long long i = 0; i < ops; i++, id++) {
+            shared_ptr<Xyh_Event> e = m.jsm.createEvent(id, "");
+            Xyh_Handle h = m.jsm.addEvent(e);
+            e->place(m.a, 0, 0);
+            m.jsm.relEvent(h);
+        }
+        record("churn", "resident", resident, ops, since(start));
+    }
+
+    /**
+     描述：A中有n个事件，逐个转移到B，测量离开大状态的开销
+    */
+    void benchPopulatedExit(size_t n) {
+        if (!selected("populated_exit")) { return; }
+
+        Machine m;
+        vector<Xyh_Handle> hs;
+        hs.reserve(n);
+        m.populate(m.a, 0, n, &hs);
+
+        //按步长跳跃访问，避免只从列表头部移除
+        size_t stride = 7919;
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0, k = 0; i < n; i++, k = (k + stride) % n) {
+            m.jsm.process(hs[k], SIG_GO, 0);
+        }
+        record("populated_exit", "events", n, n, since(start));
+    }
+
+    /**
+     描述：n个事件同时进入带定时的状态，测量定时集中到期时的处理开销
+    */
+    void benchTimerStorm(size_t n) {
+        if (!selected("timer_storm")) { return; }
+
+        Machine m(1);
+        m.populate(m.b, 0, n, 0);
+
+        Clock::time_point start = Clock::now();
+        m.io.run();
+        double seconds = since(start);
+
+        BenchStatus* b = (BenchStatus*)m.b.get();
+        record("timer_storm", "events", n, b->timers, seconds);
+    }
+
+    /**
+     描述：启用预写日志后单个事件在A、B之间往返，sync表示是否同步到磁盘
+    */
+    void benchJournal(bool sync) {
+        const char* name = sync ? "journal_sync" : "journal_nosync";
+        if (!selected(name)) { return; }
+
+        const unsigned long long ops = 2000000 / g_scale;
+        const char* path = "jsm_bench.journal";
+        std::remove(path);
+
+        Clock::time_point start;
+        {
+            Machine m;
+            vector<Xyh_Handle> hs;
+            m.populate(m.a, 0, 1, &hs);
+
+            Xyh_Journal::Policy policy;
+            policy.sync = sync;
+            m.jsm.enableJournal(shared_ptr<Xyh_Journal>(new Xyh_Journal(path, policy)));
+
+            start = Clock::now();
+            for (unsigned long long i = 0; i < ops; i += 2) {
+                m.jsm.process(hs[0], SIG_GO, 0);
+                m.jsm.process(hs[0], SIG_BACK, 0);
+            }
+            m.jsm.journal()->flush();
+        }
+        record(name, "sync", sync ? 1 : 0, ops, since(start));
+        std::remove(path);
+    }
+
+    /**
+     描述：n个状态机各有一个事件进入带定时的状态，测量所有定时到期的处理开销；
+          hub表示是否使用共享定时中心
+    */
+    void benchTenants(size_t n, bool hub) {
+        const char* name = hub ? "tenants_hub" : "tenants_own";
+        if (!selected(name)) { return; }
+
+        boost::asio::io_service io;
+        shared_ptr<Xyh_TimerHub> timers(new Xyh_TimerHub(io));
+        vector<shared_ptr<Xyh_Jsm> > machines;
+        vector<shared_ptr<Xyh_Status> > states;
+        machines.reserve(n);
+        states.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            shared_ptr<Xyh_Jsm> jsm(new Xyh_Jsm((unsigned int)i, io));
+            if (hub) {
+                jsm->useTimerHub(timers);
+            }
+            shared_ptr<Xyh_Status> s(new BenchStatus(1));
+            s->regularMs(SIG_TIMEOUT, 1);
+            jsm->addStatus(s);
+            jsm->freeze();
+            machines.push_back(jsm);
+            states.push_back(s);
+        }
+
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < n; i++) {
+            shared_ptr<Xyh_Event> e = machines[i]->createEvent(0, "");
+            machines[i]->addEvent(e);
+            e->place(states[i], 0, 0);
+        }
+        io.run();
+        record(name, "machines", n, n, since(start));
+    }
+
+    /**
+     描述：创建n个带A、B两个状态的状态机，每个状态机中一个事件往返一次；
+          shared表示是否共享同一个状态机定义
+    */
+    void benchMachines(size_t n, bool shared) {
+        const char* name = shared ? "machines_shared" : "machines_own";
+        if (!selected(name)) { return; }
+
+        boost::asio::io_service io;
+        shared_ptr<Xyh_Definition> def;
+        if (shared) {
+            def.reset(new Xyh_Definition);
+            shared_ptr<Xyh_Status> a(new BenchStatus(1));
+            shared_ptr<Xyh_Status> b(new BenchStatus(2));
+            a->addLink(SIG_GO, b);
+            b->addLink(SIG_BACK, a);
+            def->addStatus(a);
+            def->addStatus(b);
+            def->freeze();
+        }
+
+        Clock::time_point start = Clock::now();
+        vector<shared_ptr<Xyh_Jsm> > machines;
+        machines.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            shared_ptr<Xyh_Jsm> jsm;
+            if (shared) {
+                jsm.reset(new Xyh_Jsm((unsigned int)i, io, def));
+            }
+            else {
+                jsm.reset(new Xyh_Jsm((unsigned int)i, io));
+                shared_ptr<Xyh_Status> a(new BenchStatus(1));
+                shared_ptr<Xyh_Status> b(new BenchStatus(2));
+                a->addLink(SIG_GO, b);
+                b->addLink(SIG_BACK, a);
+                jsm->addStatus(a);
+                jsm->addStatus(b);
+                jsm->freeze();
+            }
+
+            shared_ptr<Xyh_Event> e = jsm->createEvent(0, "");
+            jsm->addEvent(e);
+            e->place(jsm->findStatus(1), 0, 0);
+            jsm->process(0u, SIG_GO, 0);
+            jsm->process(0u, SIG_BACK, 0);
+            machines.push_back(jsm);
+        }
+        record(name, "machines", n, n, since(start));
+    }
+
+    /**
+     说明：定时到期时通过状态机把事件送回A的状态，用于回放测试
+    */
+    class ReturnStatus : public BenchStatus {
+    public:
+        ReturnStatus(unsigned int id, Xyh_Jsm& jsm) : BenchStatus(id), jsm(jsm) { }
+
+        virtual void timerRoutine(unsigned int label, shared_ptr<Xyh_Event>& e) {
+            timers++;
+            jsm.tryProcess(e->getId(), SIG_BACK, 0);
+        }
+
+        Xyh_Jsm& jsm;
+    };
+
+    /**
+     说明：使用虚拟时钟的A、B两个状态机；事件进入B后300s超时回到A
+    */
+    struct VirtualMachine {
+        boost::asio::io_service io;
+        shared_ptr<Xyh_VirtualClock> clock;
+        Xyh_Jsm jsm;
+        shared_ptr<Xyh_Status> a;
+        shared_ptr<Xyh_Status> b;
+
+        VirtualMachine() :
+            clock(new Xyh_VirtualClock),
+            jsm(1, io),
+            a(new BenchStatus(1)),
+            b(new ReturnStatus(2, jsm)) {
+            a->addLink(SIG_GO, b);
+            b->addLink(SIG_BACK, a);
+            b->regularMs(SIG_TIMEOUT, 300000);
+            jsm.addStatus(a);
+            jsm.addStatus(b);
+            jsm.freeze();
+            jsm.useClock(clock);
+        }
+
+        unsigned long long timers() const { return ((BenchStatus*)b.get())->timers; }
+    };
+
+    /**
+     描述：在虚拟时钟上生成n个事件一小时的信号日志，再在新的状态机上按虚拟时刻回放；
+          测量回放每条记录的开销，并校验两次运行的定时次数与状态分布一致
+    */
+    void benchReplay(size_t n) {
+        if (!selected("replay_virtual")) { return; }
+
+        const unsigned long long hourMs = 3600 * 1000;
+        const unsigned long long stepMs = 10 * g_scale;
+        const char* path = "jsm_bench.replay";
+        std::remove(path);
+
+        unsigned long long timers = 0;
+        size_t inB = 0;
+        unsigned long long records = 0;
+        {
+            VirtualMachine m;
+            Xyh_Journal::Policy policy;
+            policy.sync = false;
+            m.jsm.enableJournal(shared_ptr<Xyh_Journal>(new Xyh_Journal(path, policy)));
+            for (size_t i = 0; i < n; i++) {
+                shared_ptr<Xyh_Event> e = m.jsm.createEvent((unsigned int)i, "");
+                m.jsm.addEvent(e);
+                e->place(m.a, 0, 0);
+            }
+
+            unsigned int next = 0;
+            for (unsigned long long t = 0; t < hourMs; t += stepMs) {
+                m.clock->advance(stepMs);
+                m.jsm.tryProcess(next, SIG_GO, 0);
+                next = (next + 1) % (unsigned int)n;
+            }
+            m.jsm.journal()->flush();
+            records = m.jsm.journal()->sequence();
+            timers = m.timers();
+            inB = m.b->eventCount();
+        }
+
+        VirtualMachine r;
+        Clock::time_point start = Clock::now();
+        r.jsm.replay(path);
+        r.clock->advance(hourMs - r.jsm.timestampMs());
+        record("replay_virtual", "events", n, records, since(start));
+
+        if (r.timers() != timers || r.b->eventCount() != inB) {
+            std::fprintf(stderr, "replay_virtual: timers %llu/%llu, in B %lu/%lu\n", r.timers(), timers,
+                (unsigned long)r.b->eventCount(), (unsigned long)inB);
+        }
+        std::remove(path);
+    }
+
+    /**
+     描述：A、B中各有n/2个事件，反复查询A中的事件；
+          columns表示是否启用事件列存储
+    */
+    void benchScan(size_t n, bool columns) {
+        const char* name = columns ? "scan_columns" : "scan_objects";
+        if (!selected(name)) { return; }
+
+        Machine m;
+        m.populate(m.a, 0, n / 2, 0);
+        m.populate(m.b, (unsigned int)(n / 2), n - n / 2, 0);
+        if (columns) {
+            m.jsm.enableEventColumns();
+        }
+
+        Xyh_EventFilter filter;
+        filter.status = 1;
+        vector<Xyh_Handle> hs;
+        hs.reserve(n);
+
+        unsigned long long rounds = std::max<unsigned long long>(1, 20000000 / g_scale / n);
+        unsigned long long hits = 0;
+        Clock::time_point start = Clock::now();
+        for (unsigned long long i = 0; i < rounds; i++) {
+            hs.clear();
+            hits += m.jsm.selectEvents(filter, hs);
+        }
+        record(name, "events", n, rounds * n, since(start));
+        if (hits != rounds * (n / 2)) {
+            std::fprintf(stderr, "%s: unexpected hit count %llu\n", name, hits);
+        }
+    }
+
+    void printJson(const char* label) {
+        std::printf("{\n  \"benchmark\": \"jsm\",\n");
+        if (label) {
+            std::printf("  \"label\": \"%s\",\n", label);
+        }
+        std::printf("  \"scale\": %llu,\n  \"results\": [\n", g_scale);
+        for (size_t i = 0; i < g_results.size(); i++) {
+            const Result& r = g_results[i];
+            double ns = r.ops ? r.seconds * 1e9 / r.ops : 0.0;
+            double rate = r.seconds > 0 ? r.ops / r.seconds : 0.0;
+            std::printf("    {\"name\": \"%s\", \"params\": {\"%s\": %llu}, \"ops\": %llu, "
+                "\"seconds\": %.6f, \"ns_per_op\": %.2f, \"ops_per_sec\": %.0f}%s\n",
+                r.name.c_str(), r.param.c_str(), r.value, r.ops, r.seconds, ns, rate,
+                i + 1 < g_results.size() ? "," : "");
+        }
+        std::printf("  ]\n}\n");
+    }
+
+    void usage(const char* self) {
+        std::fprintf(stderr,
+            "usage: %s [--quick] [--label <text>] [filter]\n"
+            "  --quick   run each case with 1/10 of the default work\n"
+            "  --label   text copied into the JSON output, e.g. a commit id\n"
+            "  filter    only run cases whose name contains this text\n", self);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* label = 0;
+    for (int i = 1; i < argc; i++) {
+        if (0 == std::strcmp(argv[i], "--quick")) {
+            g_scale = 10;
+        }
+        else if (0 == std::strcmp(argv[i], "--label") && i + 1 < argc) {
+            label = argv[++i];
+        }
+        else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        }
+        else {
+            g_filter = argv[i];
+        }
+    }
+
+    const size_t perState[] = { 1, 100, 10000, 100000 };
+    for (size_t i = 0; i < sizeof(perState) / sizeof(perState[0]); i++) {
+        benchDispatch(perState[i]);
+    }
+
+    for (size_t n = 1000; n <= 1000000; n *= 10) {
+        benchBroadcast(n);
+    }
+
+    const size_t resident[] = { 0, 10000, 1000000 };
+    for (size_t i = 0; i < sizeof(resident) / sizeof(resident[0]); i++) {
+        benchChurn(resident[i]);
+    }
+
+    for (size_t n = 1000; n <= 1000000; n *= 10) {
+        benchPopulatedExit(n);
+    }
+
+    for (size_t n = 1000; n <= 1000000 / g_scale; n *= 10) {
+        benchTimerStorm(n);
+    }
+
+    benchJournal(false);
+    benchJournal(true);
+
+    for (size_t n = 1000; n <= 100000 / g_scale; n *= 10) {
+        benchTenants(n, false);
+        benchTenants(n, true);
+    }
+
+    for (size_t n = 1000; n <= 100000 / g_scale; n *= 10) {
+        benchMachines(n, false);
+        benchMachines(n, true);
+    }
+
+    for (size_t n = 1000; n <= 100000; n *= 10) {
+        benchReplay(n);
+    }
+
+    for (size_t n = 1000; n <= 1000000; n *= 10) {
+        benchScan(n, false);
+        benchScan(n, true);
+    }
+
+    printJson(label);
+    return 0;
+}
@@ -1,32 +1,78 @@
 ﻿//local
 #include "fsm.h"
+#include "fsm_journal.h"
+#include "fsm_hub.h"
+#include "fsm_clock.h"
+#include "fsm_columns.h"
 //std
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <algorithm>
 #include <exception>
 #include <sstream>
 //boost
 #include "boost/bind.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/condition_variable.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/interprocess/file_mapping.hpp"
+#include "boost/interprocess/mapped_region.hpp"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define XYH_PREFETCH(p) __builtin_prefetch(p)
+#elif defined(_MSC_VER)
+#include <xmmintrin.h>
+#define XYH_PREFETCH(p) _mm_prefetch((const char*)(p), _MM_HINT_T0)
+#else
+#define XYH_PREFETCH(p) ((void)0)
+#endif
 
 namespace XYH_StatusMachine {
 
     void Xyh_Event::handle(unsigned int signal, const void* msg) throw (std::logic_error) {
-        //过期的event不再处理
-        if (expired()) { return; }
-
-        shared_ptr<Xyh_Status> ns = m_curStatus->route(signal);
-        if (ns) {
-            move(ns, signal, msg);
-        }
-        else {
+        if (RES_NO_ROUTE == tryHandle(signal, msg)) {
             std::stringstream ss;
             ss << "not found link trigger by signal(" << signal
-                << "). curren status(" << m_curStatus->getId()
-                << ")";
+                << "). curren status(";
+            if (m_curStatus) {
+                ss << m_curStatus->getId();
+            }
+            else {
+                ss << "none";
+            }
+            ss << ")";
             throw std::logic_error(ss.str());
         }
     }
 
-    void Xyh_Event::place(shared_ptr<Xyh_Status> s, unsigned int signal, const void* msg) throw (std::logic_error) {
+    Xyh_Result Xyh_Event::tryHandle(unsigned int signal, const void* msg) {
+        Xyh_Jsm* machine = hostOf(m_curStatus.get());
+
+        //过期的event不再处理
+        if (expired()) {
+            if (machine) { machine->reject(RES_EXPIRED, m_curStatus.get(), signal); }
+            return RES_EXPIRED;
+        }
+
+        if (m_suspended && machine) {
+            machine->defer(*this, signal, msg, false, 0);
+            return RES_DEFERRED;
+        }
+
+        //尚未放入任何状态的事件没有转移路线
+        shared_ptr<Xyh_Status> ns = m_curStatus ? m_curStatus->route(signal) : shared_ptr<Xyh_Status>();
+        if (!ns) {
+            if (machine) { machine->reject(RES_NO_ROUTE, m_curStatus.get(), signal); }
+            return RES_NO_ROUTE;
+        }
+
+        move(ns, signal, msg);
+        return RES_OK;
+    }
+
+    void Xyh_Event::place(shared_ptr<Xyh_Status> s, unsigned int signal, const void* msg) {
         if (expired()) {
             throw std::logic_error("event has expired");
         }
@@ -35,20 +81,34 @@ namespace XYH_StatusMachine {
             throw std::logic_error("event has valid status");
         }
 
+        Xyh_Jsm* machine = hostOf(s.get());
+        if (machine) {
+            machine->journal(Xyh_Journal::REC_PLACE, m_id, signal, s->getId(), msg);
+        }
+        Xyh_Jsm::_JournalScope scope(machine);
+
         shared_ptr<Xyh_Event> self = shared_from_this();
 
-        setCurrentStatus(s);
+        m_curStatus = s;
+        m_entries++;
 
-        enterTime(s->timestamp());
+        enterTimeMs(machine ? machine->timestampMs() : 0);
+        if (machine) {
+            machine->trace(Xyh_Recorder::ENT_PLACE, m_id, Xyh_Recorder::NO_STATUS, s->m_Id, signal, m_enterTime);
+        }
 
         if (marked() && s->fade()) {
             m_stt = STT_RECYCLE;
+            if (machine) {
+                machine->recycle(this);
+            }
         }
         else {
             s->addEvent(self);
         }
+        touch();
 
-        s->routine(self, signal, msg);
+        s->invoke(self, signal, msg);
     }
 
     bool Xyh_Event::operator<(const Xyh_Event & rhs) {
@@ -61,32 +121,93 @@ namespace XYH_StatusMachine {
 
     void Xyh_Event::setCurrentStatus(shared_ptr<Xyh_Status> s) {
         m_curStatus = s;
+        touch();
+    }
+
+    void Xyh_Event::touch() {
+        if (m_machine) {
+            m_machine->m_events.refresh(this);
+        }
+    }
+
+    Xyh_Jsm* Xyh_Event::hostOf(const Xyh_Status* s) const {
+        if (!s) {
+            return m_machine;
+        }
+        if (s->m_machine) {
+            return s->m_machine;
+        }
+        if (m_machine && s->m_definition && m_machine->m_definition.get() == s->m_definition) {
+            return m_machine;
+        }
+        return 0;
+    }
+
+    void Xyh_Event::detach() {
+        if (m_memberOf) {
+            Xyh_Status::EventList& list = m_machine->members(m_memberOf);
+            list.erase(list.iterator_to(*this));
+
+            Xyh_Metrics* metrics = m_machine->m_metrics.get();
+            if (metrics) {
+                metrics->leave(m_memberOf->m_index, Xyh_Metrics::now() - m_enterNs);
+            }
+            m_memberOf = 0;
+        }
+
+        while (!m_timers.empty()) {
+            Xyh_Timer& t = m_timers.front();
+            t.wheel->cancel(&t);
+        }
     }
 
     void Xyh_Event::move(shared_ptr<Xyh_Status> s, unsigned int signal, const void* msg) {
+        if (!enter(s, signal)) { return; }
+
+        //执行
+        shared_ptr<Xyh_Event> self = shared_from_this();
+        s->invoke(self, signal, msg);
+    }
+
+    bool Xyh_Event::enter(shared_ptr<Xyh_Status>& s, unsigned int signal) {
         //过期的event不再处理
-        if (expired()) { return; }
+        if (expired()) { return false; }
 
         shared_ptr<Xyh_Event> self = shared_from_this();
 
+        unsigned int fromId = Xyh_Recorder::NO_STATUS;
         if (m_curStatus) {
+            fromId = m_curStatus->m_Id;
+            Xyh_Jsm* from = hostOf(m_curStatus.get());
+            Xyh_Metrics* metrics = from ? from->m_metrics.get() : 0;
+            if (metrics) {
+                metrics->transition(m_curStatus->m_index, signal);
+            }
             m_curStatus->removeEvent(self);
         }
 
-        setCurrentStatus(s);
+        m_curStatus = s;
+        m_entries++;
 
-        enterTime(s->timestamp());
+        Xyh_Jsm* machine = hostOf(s.get());
+        enterTimeMs(machine ? machine->timestampMs() : 0);
+        if (machine) {
+            machine->trace(Xyh_Recorder::ENT_MOVE, m_id, fromId, s->m_Id, signal, m_enterTime);
+        }
 
         //若时间已被标记过期，且当前状态允许停止事件则讲event状态置为待回收
         if (marked() && s->fade()) {
             m_stt = STT_RECYCLE;
+            if (machine) {
+                machine->recycle(this);
+            }
         }
         else {
             s->addEvent(self);
         }
+        touch();
 
-        //执行
-        s->routine(self, signal, msg);
+        return true;
     }
 
 
@@ -95,10 +216,18 @@ namespace XYH_StatusMachine {
         m_owner(0),
         m_name(name),
         m_fade(fade),
-        m_ticktock(0) {
+        m_machine(0),
+        m_definition(0),
+        m_dispatch(0),
+        m_index(0) {
     }
 
     shared_ptr<Xyh_Status> Xyh_Status::route(unsigned int signal) {
+        if (m_dispatch) {
+            int next = m_dispatch->route(m_index, signal);
+            return next < 0 ? shared_ptr<Xyh_Status>() : m_dispatch->status(next);
+        }
+
         if (1 == m_setSelfLink.count(signal)) {
             return shared_from_this();
         }
@@ -113,37 +242,76 @@ namespace XYH_StatusMachine {
     }
 
     void Xyh_Status::addLink(unsigned int signal, shared_ptr<Xyh_Status>& status) {
+        if (m_dispatch) {
+            throw std::logic_error("status has been frozen");
+        }
         m_mapLink.insert(std::make_pair(signal, status));
     }
 
     void Xyh_Status::addLink(unsigned int signal) {
+        if (m_dispatch) {
+            throw std::logic_error("status has been frozen");
+        }
         m_setSelfLink.insert(signal);
     }
 
     void Xyh_Status::regular(unsigned int tabel, unsigned int period) {
-        m_regularEvt.push_back(std::pair<unsigned int, unsigned int>(tabel, period));
+        regularMs(tabel, period * 1000ULL);
     }
 
-    void Xyh_Status::ticktock(const unsigned long long ticktock, const boost::system::error_code& e) {
-        if (e) {
-            std::cout << "Xyh_Status::_ticktock. timer be cancel(" << m_Id << ")" << e.message() << std::endl;
-            return;
+    void Xyh_Status::regularMs(unsigned int tabel, unsigned long long period) {
+        m_regularEvt.push_back(std::pair<unsigned int, unsigned long long>(tabel, period));
+    }
+
+    unsigned long long Xyh_Status::timestamp() {
+        return m_machine ? m_machine->timestamp() : 0;
+    }
+
+    unsigned long long Xyh_Status::timestampMs() {
+        return m_machine ? m_machine->timestampMs() : 0;
+    }
+
+    namespace {
+        /**
+         描述：获取成员列表中最早进入的n个事件
+        */
+        size_t collectOldest(Xyh_Status::EventList& list, size_t n, vector<shared_ptr<Xyh_Event> >& out) {
+            size_t count = 0;
+            for (Xyh_Status::EventList::iterator it = list.begin(); it != list.end() && count < n; ++it, ++count) {
+                out.push_back(it->shared_from_this());
+            }
+            return count;
         }
 
-        m_ticktock = ticktock;
+        /**
+         描述：获取成员列表中在now时刻已停留不少于ms的事件
+        */
+        size_t collectOlderThan(Xyh_Status::EventList& list, unsigned long long now, unsigned long long ms,
+            vector<shared_ptr<Xyh_Event> >& out) {
+            if (now < ms) {
+                return 0;
+            }
 
-        //处理到期事件
-        typedef map<unsigned int, shared_ptr<_InStore> >::iterator ItType;
-        std::pair<ItType, ItType> r = m_mapTEvent.equal_range(m_ticktock);
-        for (ItType it = r.first; it != r.second; it++) {
-            //若event当前所在status Id与m_id 不相等，说明event已转移，忽略超时
-            if (!it->second->_event->expired() &&
-                (it->second->_event->getCurrentStatus()->getId() == m_Id)) {
-                timerRoutine(it->second->_tabel, it->second->_event);
+            size_t count = 0;
+            unsigned long long cutoff = now - ms;
+            for (Xyh_Status::EventList::iterator it = list.begin(); it != list.end(); ++it, ++count) {
+                if (it->enterTimeMs() > cutoff) { break; }
+                out.push_back(it->shared_from_this());
             }
+            return count;
         }
-        //清除到期事件
-        m_mapTEvent.erase(m_ticktock);
+    }
+
+    size_t Xyh_Status::eventCount() const {
+        return m_machine ? m_machine->members(this).size() : 0;
+    }
+
+    size_t Xyh_Status::oldest(size_t n, vector<shared_ptr<Xyh_Event> >& out) {
+        return m_machine ? collectOldest(m_machine->members(this), n, out) : 0;
+    }
+
+    size_t Xyh_Status::olderThan(unsigned long long ms, vector<shared_ptr<Xyh_Event> >& out) {
+        return m_machine ? collectOlderThan(m_machine->members(this), m_machine->timestampMs(), ms, out) : 0;
     }
 
     Xyh_Status::compare::compare(shared_ptr<Xyh_Event>& s) : _s(s) {}
@@ -152,189 +320,2223 @@ namespace XYH_StatusMachine {
         return e->getId() == _s->getId();
     }
 
+    void Xyh_Status::invoke(shared_ptr<Xyh_Event>& e, unsigned int label, const void* msg) {
+        Xyh_Jsm* machine = e->hostOf(this);
+        Xyh_Metrics* metrics = machine ? machine->m_metrics.get() : 0;
+        if (!metrics) {
+            routine(e, label, msg);
+            return;
+        }
+
+        unsigned long long start = Xyh_Metrics::now();
+        routine(e, label, msg);
+        metrics->routine(m_index, Xyh_Metrics::now() - start);
+    }
+
     void Xyh_Status::removeEvent(shared_ptr<Xyh_Event>& s) {
-        m_listEvent.remove_if(compare(s));
+        if (s->m_memberOf == this) {
+            s->detach();
+        }
     }
 
     void Xyh_Status::addEvent(shared_ptr<Xyh_Event>& s) {
-        m_listEvent.push_back(s);
-        typedef list<std::pair<unsigned int, unsigned int> >::value_type VType;
+        s->detach();
+
+        Xyh_Jsm* machine = s->hostOf(this);
+        if (!machine) {
+            return;
+        }
+
+        //通常进入时间不早于列表末尾的事件，直接追加
+        EventList& members = machine->members(this);
+        EventList::iterator pos = members.end();
+        while (pos != members.begin()) {
+            EventList::iterator prev = pos;
+            if ((--prev)->m_enterTime <= s->m_enterTime) { break; }
+            pos = prev;
+        }
+        members.insert(pos, *s);
+        s->m_memberOf = this;
+        s->m_machine = machine;
+
+        if (machine->m_metrics) {
+            s->m_enterNs = Xyh_Metrics::now();
+            machine->m_metrics->enter(m_index);
+        }
+
+        unsigned long long now = machine->timestampMs();
+        typedef list<std::pair<unsigned int, unsigned long long> >::value_type VType;
         BOOST_FOREACH(VType v, m_regularEvt) {
-            typedef multimap<unsigned int, shared_ptr<_InStore> >::value_type MVType;
-            m_mapTEvent.insert(MVType(m_ticktock + v.second, shared_ptr<_InStore>(new _InStore(v.first, s))));
+            s->m_timers.push_back(*machine->m_wheel.schedule(now + v.second, v.first, s.get(), this));
+            machine->armBefore(now + v.second);
         }
     }
 
 
-    Xyh_Jsm::Xyh_Jsm(unsigned int _id, boost::asio::io_service & _io_Servivce) :
-	    m_ioService(_io_Servivce),
-        m_timer(_io_Servivce),
-        m_ticktock(0) {
+    Xyh_Metrics::Xyh_Metrics(shared_ptr<Xyh_Dispatch> dispatch) :
+        m_dispatch(dispatch),
+        m_states(new Counter[dispatch->size() * STRIDE]),
+        m_transitions(new Counter[dispatch->size() * dispatch->columns()]) {
+        for (size_t i = 0; i < dispatch->size() * STRIDE; i++) {
+            m_states[i].store(0, boost::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < dispatch->size() * dispatch->columns(); i++) {
+            m_transitions[i].store(0, boost::memory_order_relaxed);
+        }
+    }
 
-        m_timer.expires_from_now(boost::posix_time::seconds(1));
-        m_timer.async_wait(boost::bind(&Xyh_Jsm::ticktock, this, _1));
+    unsigned long long Xyh_Metrics::now() {
+        return boost::asio::chrono::duration_cast<boost::asio::chrono::nanoseconds>(
+            boost::asio::steady_timer::clock_type::now().time_since_epoch()).count();
     }
 
-    void Xyh_Jsm::digestion(unsigned int eid, unsigned int sig, const void* msg) {
-        shared_ptr<Xyh_Event> event = findEvent(eid);
-        if (event) {
-            //过期的event不再处理
-            if (event->expired()) {
-                return;
+    Xyh_Metrics::Snapshot Xyh_Metrics::snapshot() const {
+        Snapshot snap;
+        snap.at = now();
+
+        unsigned int n = m_dispatch->size();
+        unsigned int cols = m_dispatch->columns();
+        snap.states.resize(n);
+        for (unsigned int s = 0; s < n; s++) {
+            StateStats& st = snap.states[s];
+            const Counter* c = &m_states[s * STRIDE];
+            st.id = m_dispatch->status(s)->getId();
+            st.occupancy = c[OCCUPANCY].load(boost::memory_order_relaxed);
+            st.entries = c[ENTRIES].load(boost::memory_order_relaxed);
+            st.timers = c[TIMERS].load(boost::memory_order_relaxed);
+            for (unsigned int b = 0; b < BUCKETS; b++) {
+                st.dwell[b] = c[DWELL + b].load(boost::memory_order_relaxed);
+                st.routine[b] = c[ROUTINE + b].load(boost::memory_order_relaxed);
+            }
+
+            for (unsigned int col = 0; col < cols; col++) {
+                unsigned long long count = m_transitions[s * cols + col].load(boost::memory_order_relaxed);
+                if (!count) { continue; }
+
+                TransitionStats t;
+                t.from = st.id;
+                t.signal = m_dispatch->signal(col);
+                int to = m_dispatch->route(s, t.signal);
+                t.to = to < 0 ? st.id : m_dispatch->status(to)->getId();
+                t.count = count;
+                snap.transitions.push_back(t);
+            }
+        }
+        return snap;
+    }
+
+
+    Xyh_Pool::Xyh_Pool(size_t size, size_t perChunk) :
+        m_size((std::max(size, sizeof(Node)) + 15) & ~(size_t)15),
+        m_perChunk(perChunk ? perChunk : 1),
+        m_free(0) {
+    }
+
+    Xyh_Pool::~Xyh_Pool() {
+        BOOST_FOREACH(char* c, m_chunks) {
+            delete[] c;
+        }
+    }
+
+    void Xyh_Pool::reserve(size_t n) {
+        size_t avail = (size_t)(m_stats.capacity - m_stats.inUse());
+        if (n > avail) {
+            grow(n - avail);
+        }
+    }
+
+    void Xyh_Pool::grow(size_t n) {
+        char* c = new char[m_size * n];
+        m_chunks.push_back(c);
+        //倒序压入空闲链表，使分配顺序与地址顺序一致
+        for (size_t i = n; i > 0; i--) {
+            deallocate(c + m_size * (i - 1));
+            m_stats.frees--;
+        }
+        m_stats.chunks++;
+        m_stats.capacity += n;
+    }
+
+
+    const unsigned long long Xyh_TimerWheel::NEVER;
+
+    Xyh_TimerWheel::Xyh_TimerWheel() :
+        m_next(0),
+        m_size(0),
+        m_pool(sizeof(Xyh_Timer)) {
+    }
+
+    Xyh_TimerWheel::~Xyh_TimerWheel() {
+        for (unsigned int l = 0; l < WHEEL_LEVELS; l++) {
+            for (unsigned int i = 0; i < WHEEL_SLOTS; i++) {
+                while (!m_slots[l][i].empty()) {
+                    cancel(&m_slots[l][i].front());
+                }
             }
+        }
+        while (!m_due.empty()) {
+            cancel(&m_due.front());
+        }
+    }
+
+    Xyh_Timer* Xyh_TimerWheel::schedule(unsigned long long deadline, unsigned int label, Xyh_Event* e, Xyh_Status* s) {
+        Xyh_Timer* t = new (m_pool.allocate()) Xyh_Timer;
+        t->deadline = deadline;
+        t->label = label;
+        t->event = e;
+        t->status = s;
+        t->wheel = this;
+        place(t);
+        m_size++;
+        return t;
+    }
+
+    void Xyh_TimerWheel::cancel(Xyh_Timer* t) {
+        t->wheelHook.unlink();
+        t->eventHook.unlink();
+        release(t);
+        m_size--;
+    }
+
+    void Xyh_TimerWheel::release(Xyh_Timer* t) {
+        t->~Xyh_Timer();
+        m_pool.deallocate(t);
+    }
+
+    void Xyh_TimerWheel::place(Xyh_Timer* t) {
+        //已过期的定时放入下一个待处理的槽位
+        unsigned long long deadline = t->deadline < m_next ? m_next : t->deadline;
+        unsigned long long delta = deadline - m_next;
+
+        unsigned int level = 0;
+        while (level < WHEEL_LEVELS - 1 && delta >= (1ULL << (WHEEL_BITS * (level + 1)))) {
+            level++;
+        }
+        //超出时间轮范围的定时暂放在最高层最远的槽位，下放时重新计算
+        if (delta >= (1ULL << (WHEEL_BITS * WHEEL_LEVELS))) {
+            deadline = m_next + (1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+        }
+
+        m_slots[level][(deadline >> (WHEEL_BITS * level)) & WHEEL_MASK].push_back(*t);
+    }
 
-            shared_ptr<XYH_StatusMachine::Xyh_Status> cS = event->getCurrentStatus();
+    bool Xyh_TimerWheel::cascade(unsigned int level, unsigned int index) {
+        Slot slot;
+        slot.swap(m_slots[level][index]);
+        while (!slot.empty()) {
+            Xyh_Timer& t = slot.front();
+            slot.pop_front();
+            place(&t);
+        }
+        return index == 0;
+    }
 
-            shared_ptr<XYH_StatusMachine::Xyh_Status> nS = cS->route(sig);
+    unsigned long long Xyh_TimerWheel::nextPending() const {
+        unsigned long long next = NEVER;
+        for (unsigned int l = 0; l < WHEEL_LEVELS; l++) {
+            //本层下一个需要处理的槽位起点；第0层即m_next，上层为下一个对齐的下放时刻
+            unsigned int bits = WHEEL_BITS * l;
+            unsigned long long first = m_next >> bits;
+            if (m_next & ((1ULL << bits) - 1)) {
+                first++;
+            }
 
-            if (nS) {
-                if (cS->getId() == nS->getId()) {
-                    cS->routine(event, sig, msg);
+            for (unsigned int k = 0; k < WHEEL_SLOTS; k++) {
+                if (!m_slots[l][(first + k) & WHEEL_MASK].empty()) {
+                    unsigned long long at = (first + k) << bits;
+                    if (at < next) {
+                        next = at;
+                    }
+                    break;
                 }
-                else {
-                    event->move(nS, sig, msg);
+            }
+        }
+        return next;
+    }
+
+    Xyh_Timer* Xyh_TimerWheel::expire(unsigned long long now) {
+        while (m_due.empty() && m_next <= now) {
+            //跳过没有定时需要处理的区间
+            unsigned long long next = nextPending();
+            if (next > now) {
+                m_next = now + 1;
+                break;
+            }
+            m_next = next;
+
+            unsigned int index = m_next & WHEEL_MASK;
+            //第0层转完一圈后，从上层槽位下放定时记录
+            if (index == 0) {
+                for (unsigned int l = 1; l < WHEEL_LEVELS; l++) {
+                    if (!cascade(l, (m_next >> (WHEEL_BITS * l)) & WHEEL_MASK)) {
+                        break;
+                    }
                 }
             }
-            else {
-                std::stringstream ss;
-                ss << "not found next status. current status:"
-                    << cS->getId()
-                    << " Signal:"
-                    << sig;
 
+            m_due.splice(m_due.end(), m_slots[0][index]);
+            m_next++;
+        }
+
+        if (m_due.empty()) {
+            return 0;
+        }
+
+        Xyh_Timer* t = &m_due.front();
+        m_due.pop_front();
+        t->eventHook.unlink();
+        m_size--;
+        return t;
+    }
+
+
+    Xyh_Dispatch::Xyh_Dispatch(const vector<shared_ptr<Xyh_Status> >& statuses) throw (std::logic_error) :
+        m_statuses(statuses),
+        m_dense(true),
+        m_sorted(false),
+        m_base(0),
+        m_cols(0),
+        m_mul(0),
+        m_shift(0) {
+
+        //将状态id映射为下标
+        map<unsigned int, unsigned int> index;
+        for (unsigned int i = 0; i < m_statuses.size(); i++) {
+            if (m_statuses[i]->m_dispatch) {
+                std::stringstream ss;
+                ss << "status(" << m_statuses[i]->getId() << ") has been frozen by another machine";
                 throw std::logic_error(ss.str());
             }
+            index[m_statuses[i]->getId()] = i;
         }
-        else {
-            std::stringstream ss;
-            ss << "not found event(" << eid << ") signal(" << sig << ")";
-            throw std::logic_error(ss.str());
+
+        //收集所有出现在转移路线中的信号
+        set<unsigned int> sigs;
+        BOOST_FOREACH(const shared_ptr<Xyh_Status>& s, m_statuses) {
+            typedef map<unsigned int, shared_ptr<Xyh_Status> >::value_type LType;
+            BOOST_FOREACH(const LType& l, s->m_mapLink) {
+                sigs.insert(l.first);
+                if (!index.count(l.second->getId())) {
+                    std::stringstream ss;
+                    ss << "link target status(" << l.second->getId() << ") from status("
+                        << s->getId() << ") is not in machine";
+                    throw std::logic_error(ss.str());
+                }
+            }
+            sigs.insert(s->m_setSelfLink.begin(), s->m_setSelfLink.end());
+        }
+
+        vector<unsigned int> signals(sigs.begin(), sigs.end());
+        if (!signals.empty()) {
+            //信号范围不超过信号数量的两倍时(或范围本身很小)直接按差值索引，否则使用完美哈希；
+            //找不到完美哈希时退回有序信号表，不按信号范围分配行
+            unsigned long long range = (unsigned long long)signals.back() - signals.front() + 1;
+            if (range <= 64 || range <= 2 * (unsigned long long)signals.size()) {
+                m_dense = true;
+                m_base = signals.front();
+                m_cols = (unsigned int)range;
+            }
+            else if (!perfectHash(signals)) {
+                m_dense = false;
+                m_sorted = true;
+                m_keys = signals;
+                m_cols = (unsigned int)signals.size();
+            }
+        }
+
+        m_table.assign(m_statuses.size() * m_cols, -1);
+        for (unsigned int i = 0; i < m_statuses.size(); i++) {
+            Xyh_Status& s = *m_statuses[i];
+            int* row = m_table.empty() ? 0 : &m_table[i * m_cols];
+
+            typedef map<unsigned int, shared_ptr<Xyh_Status> >::value_type LType;
+            BOOST_FOREACH(const LType& l, s.m_mapLink) {
+                row[column(l.first)] = index[l.second->getId()];
+            }
+            //自环优先于非自环转移
+            BOOST_FOREACH(unsigned int sig, s.m_setSelfLink) {
+                row[column(sig)] = i;
+            }
+        }
+
+        for (unsigned int i = 0; i < m_statuses.size(); i++) {
+            m_statuses[i]->m_dispatch = this;
+            m_statuses[i]->m_index = i;
         }
     }
 
-    void Xyh_Jsm::process(unsigned int eid, unsigned int sig, const void * msg) {
-        shared_ptr<Xyh_Event> event = findEvent(eid);
-        if (event) {
-            //过期的event不再处理
-            if (event->expired()) {
-                return;
+    Xyh_Dispatch::~Xyh_Dispatch() {
+        BOOST_FOREACH(const shared_ptr<Xyh_Status>& s, m_statuses) {
+            if (s->m_dispatch == this) {
+                s->m_dispatch = 0;
             }
+        }
+    }
+
+    bool Xyh_Dispatch::perfectHash(const vector<unsigned int>& signals) {
+        unsigned int cols = 1;
+        while (cols < signals.size()) {
+            cols <<= 1;
+        }
 
-            shared_ptr<XYH_StatusMachine::Xyh_Status> cS = event->getCurrentStatus();
+        //依次尝试1倍、2倍、4倍大小的行，每种大小随机尝试若干乘数
+        unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+        for (int grow = 0; grow < 3; grow++, cols <<= 1) {
+            vector<char> used(cols);
+            for (int attempt = 0; attempt < 512; attempt++) {
+                seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+                unsigned long long mul = (seed & 0xFFFFFFFFULL) | 1;
+                unsigned int shift = 16 + (unsigned int)((seed >> 40) % 17);
 
-            shared_ptr<XYH_StatusMachine::Xyh_Status> nS = cS->route(sig);
+                std::fill(used.begin(), used.end(), 0);
+                bool ok = true;
+                BOOST_FOREACH(unsigned int sig, signals) {
+                    unsigned int c = (unsigned int)(((unsigned long long)sig * mul) >> shift) & (cols - 1);
+                    if (used[c]) { ok = false; break; }
+                    used[c] = 1;
+                }
 
-            if (nS) {
-                event->move(nS, sig, msg);
+                if (ok) {
+                    m_dense = false;
+                    m_cols = cols;
+                    m_mul = mul;
+                    m_shift = shift;
+                    //未使用的位置填入一个不会被映射到该位置的信号，保证校验失败
+                    m_keys.assign(cols, 0);
+                    for (unsigned int c = 0; c < cols; c++) {
+                        if (!used[c]) {
+                            unsigned int k = 0;
+                            while (((((unsigned long long)k * mul) >> shift) & (cols - 1)) == c) { k++; }
+                            m_keys[c] = k;
+                        }
+                    }
+                    BOOST_FOREACH(unsigned int sig, signals) {
+                        m_keys[(((unsigned long long)sig * mul) >> shift) & (cols - 1)] = sig;
+                    }
+                    return true;
+                }
             }
-            else {
-                std::stringstream ss;
-                ss << "not found next status. current status:"
-                    << cS->getId()
-                    << " Signal:"
-                    << sig;
+        }
+        return false;
+    }
 
-                throw std::logic_error(ss.str());
+
+    Xyh_Definition::Xyh_Definition() {
+    }
+
+    Xyh_Definition::~Xyh_Definition() {
+        BOOST_FOREACH(const shared_ptr<Xyh_Status>& s, m_statuses) {
+            if (s->m_definition == this) {
+                s->m_definition = 0;
             }
         }
-        else {
+    }
+
+    void Xyh_Definition::addStatus(shared_ptr<Xyh_Status> s) throw (std::logic_error) {
+        if (m_dispatch) {
+            throw std::logic_error("machine definition has been frozen");
+        }
+        if (s->m_definition && s->m_definition != this) {
             std::stringstream ss;
-            ss << "not found event(" << eid << ") signal(" << sig << ")";
+            ss << "status(" << s->getId() << ") belongs to another machine";
             throw std::logic_error(ss.str());
         }
+        if (m_mapStatus.count(s->getId())) {
+            return;
+        }
+
+        s->m_definition = this;
+        s->m_index = (unsigned int)m_statuses.size();
+        m_statuses.push_back(s);
+        m_mapStatus.insert(std::make_pair(s->getId(), s));
     }
 
-    void Xyh_Jsm::process(unsigned int sig, const void * msg) {
-        typedef map<unsigned int, shared_ptr<Xyh_Event> >::iterator ItType;
-        
-        for (ItType it = m_mapEvent.begin(); it != m_mapEvent.end(); it++) {
-            //过期的event不再处理
-            if (it->second->expired()) {
-                continue;
-            }
+    shared_ptr<Xyh_Status> Xyh_Definition::findStatus(unsigned int id) const {
+        map<unsigned int, shared_ptr<Xyh_Status> >::const_iterator it = m_mapStatus.find(id);
+        return it == m_mapStatus.end() ? shared_ptr<Xyh_Status>() : it->second;
+    }
 
-            shared_ptr<XYH_StatusMachine::Xyh_Status> cS = it->second->getCurrentStatus();
+    void Xyh_Definition::freeze() throw (std::logic_error) {
+        if (!m_dispatch) {
+            //转移表按加入顺序排列状态，与状态下标一致
+            m_dispatch.reset(new Xyh_Dispatch(m_statuses));
+        }
+    }
 
-            shared_ptr<XYH_StatusMachine::Xyh_Status> nS = cS->route(sig);
 
-            if (nS) {
-                it->second->move(nS, sig, msg);
-            }
-            else {
-                std::cout << "not found next status. current status:" 
-                    << cS->getId()
-                    << " Signal:" 
-                    << sig
-                    << std::endl;
+    Xyh_EventTable::Xyh_EventTable() :
+        m_free(EMPTY),
+        m_shift(0) {
+        rehash(16);
+    }
+
+    Xyh_Handle Xyh_EventTable::insert(const shared_ptr<Xyh_Event>& e) {
+        Xyh_Handle old = find(e->getId());
+        if (old.valid()) {
+            if (get(old) == e.get()) {
+                return old;
             }
+            erase(old);
+        }
+
+        if (((m_dense.size() + 1) << 1) > m_buckets.size()) {
+            rehash(m_buckets.size() << 1);
+        }
+
+        if (m_free == EMPTY) {
+            Slot s = { 0, 1, EMPTY };
+            m_free = (unsigned int)m_slots.size();
+            m_slots.push_back(s);
+        }
+
+        unsigned int index = m_free;
+        Slot& slot = m_slots[index];
+        m_free = slot.next;
+        slot.event = e.get();
+        slot.next = (unsigned int)m_dense.size();
+        m_dense.push_back(e);
+        m_denseSlot.push_back(index);
+        if (m_columns) {
+            m_columns->push(*e);
+        }
+
+        size_t b = bucket(e->getId());
+        while (m_buckets[b].slot != EMPTY) {
+            b = (b + 1) & (m_buckets.size() - 1);
         }
+        m_buckets[b].id = e->getId();
+        m_buckets[b].slot = index;
+
+        e->m_handle = Xyh_Handle(index, slot.generation);
+        return e->m_handle;
     }
 
-    void Xyh_Jsm::addStatus(shared_ptr<Xyh_Status> s) {
-        m_mapStatus.insert(std::make_pair(s->getId(), s));
+    bool Xyh_EventTable::erase(Xyh_Handle h) {
+        Xyh_Event* event = get(h);
+        if (!event) {
+            return false;
+        }
+
+        unhash(event->getId());
+        event->m_handle = Xyh_Handle();
+
+        //用末尾的事件填补空位
+        Slot& slot = m_slots[h.index()];
+        unsigned int pos = slot.next;
+        unsigned int last = (unsigned int)m_dense.size() - 1;
+        if (pos != last) {
+            m_dense[pos].swap(m_dense[last]);
+            m_denseSlot[pos] = m_denseSlot[last];
+            m_slots[m_denseSlot[pos]].next = pos;
+        }
+        if (m_columns) {
+            m_columns->remove(pos);
+        }
+        //最后释放事件，事件的析构可能再次访问事件表
+        shared_ptr<Xyh_Event> released;
+        released.swap(m_dense[last]);
+        m_dense.pop_back();
+        m_denseSlot.pop_back();
+
+        slot.event = 0;
+        if (++slot.generation == 0) {
+            slot.generation = 1;
+        }
+        slot.next = m_free;
+        m_free = h.index();
+        return true;
     }
 
-    shared_ptr<Xyh_Status> Xyh_Jsm::findStatus(unsigned int id) {
-        if (m_mapStatus.end() == m_mapStatus.find(id)) {
-            return shared_ptr<Xyh_Status>();
+    Xyh_Handle Xyh_EventTable::find(unsigned int id) const {
+        size_t b = bucket(id);
+        while (m_buckets[b].slot != EMPTY) {
+            if (m_buckets[b].id == id) {
+                unsigned int index = m_buckets[b].slot;
+                return Xyh_Handle(index, m_slots[index].generation);
+            }
+            b = (b + 1) & (m_buckets.size() - 1);
         }
-        else {
-            return m_mapStatus[id];
+        return Xyh_Handle();
+    }
+
+    void Xyh_EventTable::reserve(size_t n) {
+        m_slots.reserve(n);
+        m_dense.reserve(n);
+        m_denseSlot.reserve(n);
+        if (m_columns) {
+            m_columns->reserve(n);
+        }
+
+        size_t capacity = m_buckets.size();
+        while (capacity < (n << 1)) {
+            capacity <<= 1;
+        }
+        if (capacity != m_buckets.size()) {
+            rehash(capacity);
         }
     }
 
-    void Xyh_Jsm::addEvent(shared_ptr<Xyh_Event> e) {
-        if (!m_mapEvent.count(e->getId())) {
-            m_mapEvent.insert(std::make_pair(e->getId(), e));
-        } else {
-            m_mapEvent[e->getId()] = e;
+    void Xyh_EventTable::enableColumns(const Xyh_Definition* definition) {
+        shared_ptr<Xyh_EventColumns> columns(new Xyh_EventColumns(definition));
+        columns->reserve(m_dense.capacity());
+        for (size_t i = 0; i < m_dense.size(); i++) {
+            columns->push(*m_dense[i]);
         }
-        
+        m_columns = columns;
     }
 
-    void Xyh_Jsm::relEvent(unsigned int id) {
-        if (m_mapEvent.count(id)) {
-            m_mapEvent[id]->expire();
+    void Xyh_EventTable::update(const Xyh_Event* e) {
+        if (get(e->m_handle) == e) {
+            m_columns->set(m_slots[e->m_handle.index()].next, *e);
+        }
+    }
+
+    void Xyh_EventTable::rehash(size_t capacity) {
+        Bucket empty = { 0, EMPTY };
+        m_buckets.assign(capacity, empty);
+        m_shift = 32;
+        for (size_t c = capacity; c > 1; c >>= 1) {
+            m_shift--;
         }
 
-        m_mapEvent.erase(id);
+        for (unsigned int i = 0; i < m_denseSlot.size(); i++) {
+            unsigned int id = m_dense[i]->getId();
+            size_t b = bucket(id);
+            while (m_buckets[b].slot != EMPTY) {
+                b = (b + 1) & (m_buckets.size() - 1);
+            }
+            m_buckets[b].id = id;
+            m_buckets[b].slot = m_denseSlot[i];
+        }
     }
 
-    void Xyh_Jsm::expireEvent(unsigned int id) {
-        if (m_mapEvent.count(id)) {
-            m_mapEvent[id]->expire();
+    void Xyh_EventTable::unhash(unsigned int id) {
+        size_t mask = m_buckets.size() - 1;
+        size_t b = bucket(id);
+        while (m_buckets[b].id != id || m_buckets[b].slot == EMPTY) {
+            b = (b + 1) & mask;
+        }
+
+        //将后续同一探测链上的元素前移，保持探测链连续
+        size_t hole = b;
+        for (size_t n = (hole + 1) & mask; m_buckets[n].slot != EMPTY; n = (n + 1) & mask) {
+            size_t home = bucket(m_buckets[n].id);
+            //home不在(hole, n]区间内时，元素可以移动到hole
+            if (((n - home) & mask) >= ((n - hole) & mask)) {
+                m_buckets[hole] = m_buckets[n];
+                hole = n;
+            }
         }
+        m_buckets[hole].slot = EMPTY;
     }
 
-    shared_ptr<Xyh_Event> Xyh_Jsm::findEvent(unsigned int id) {
-        if (m_mapEvent.end() != m_mapEvent.find(id)) {
-            return m_mapEvent[id];
+
+    Xyh_IngressQueue::Xyh_IngressQueue(size_t capacity) :
+        m_cells(0),
+        m_mask(0),
+        m_tail(0),
+        m_head(0) {
+
+        size_t n = 2;
+        while (n < capacity) {
+            n <<= 1;
         }
-        else {
-            return shared_ptr<Xyh_Event>();
+        m_mask = n - 1;
+        m_cells = new Cell[n];
+        for (size_t i = 0; i < n; i++) {
+            m_cells[i].seq.store(i, boost::memory_order_relaxed);
         }
     }
 
-    void Xyh_Jsm::ticktock(const boost::system::error_code & e) {
-        typedef map<unsigned int, shared_ptr<Xyh_Status> >::iterator ItType;
+    Xyh_IngressQueue::~Xyh_IngressQueue() {
+        delete[] m_cells;
+    }
 
-        if (e) {
-            return;
+    bool Xyh_IngressQueue::push(const Xyh_Signal& r, unsigned char kind) {
+        size_t pos = m_tail.load(boost::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(boost::memory_order_acquire);
+            long diff = (long)seq - (long)pos;
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                //槽位尚未被消费者读取，队列已满
+                return false;
+            }
+            else {
+                pos = m_tail.load(boost::memory_order_relaxed);
+            }
         }
 
-        //遍历所有status，并查看是否有定时事件到期
-        for (ItType it = m_mapStatus.begin(); it != m_mapStatus.end(); it++) {
-            it->second->ticktock(m_ticktock, e);
+        cell->data = r;
+        cell->kind = kind;
+        cell->seq.store(pos + 1, boost::memory_order_release);
+        return true;
+    }
+
+    bool Xyh_IngressQueue::pop(Xyh_Signal& r, unsigned char& kind) {
+        size_t pos = m_head.load(boost::memory_order_relaxed);
+        Cell* cell = &m_cells[pos & m_mask];
+        if (cell->seq.load(boost::memory_order_acquire) != pos + 1) {
+            return false;
         }
 
-        //滴答数+1
-        m_ticktock++;
-        m_timer.expires_from_now(boost::posix_time::seconds(1));
-        m_timer.async_wait(boost::bind(&Xyh_Jsm::ticktock, this, _1));
+        r = cell->data;
+        kind = cell->kind;
+        cell->seq.store(pos + m_mask + 1, boost::memory_order_release);
+        m_head.store(pos + 1, boost::memory_order_relaxed);
+        return true;
     }
 
-    void Xyh_Jsm::stop() {
-        m_timer.cancel();
+
+    const unsigned int Xyh_Jsm::NO_STATUS;
+    const unsigned int Xyh_Jsm::LANES;
+
+    Xyh_Jsm::Xyh_Jsm(unsigned int _id, boost::asio::io_service & _io_Servivce, FinishNotify fr) :
+	    m_ioService(_io_Servivce),
+        m_definition(new Xyh_Definition),
+        m_timer(_io_Servivce),
+        m_epoch(boost::asio::steady_timer::clock_type::now()),
+        m_armed(Xyh_TimerWheel::NEVER),
+        m_stopped(false),
+        m_hubSlot(0),
+        m_clockSlot(0),
+        m_finishNotify(fr),
+        m_reclaimSlice(256),
+        m_reclaimTimer(_io_Servivce),
+        m_reclaimPending(false),
+        m_broadcastMisses(0),
+        m_id(_id),
+        m_recorder(Xyh_Recorder::global()),
+        m_journalDepth(0),
+        m_timerDepth(0),
+        m_snapshotSeq(0),
+        m_ingressHighWater(0),
+        m_ingressBatch(0),
+        m_drainPending(false),
+        m_ingressBusy(0),
+        m_ingressRejected(0),
+        m_queued(0),
+        m_coalesced(0),
+        m_deliverPending(false) {
+    }
+
+    Xyh_Jsm::Xyh_Jsm(unsigned int _id, boost::asio::io_service& _io_Servivce, shared_ptr<Xyh_Definition> definition,
+        FinishNotify fr) throw (std::logic_error) :
+        Xyh_Jsm(_id, _io_Servivce, fr) {
+        definition->freeze();
+        m_definition = definition;
+        m_dispatch = definition->m_dispatch;
+        allocRejects();
+        for (size_t i = 0; i < definition->size(); i++) {
+            m_members.emplace_back();
+        }
+    }
+
+    void Xyh_Jsm::digestion(unsigned int eid, unsigned int sig, const void* msg) {
+        Xyh_Handle h = m_events.find(eid);
+        Xyh_Result r = tryDigest(h, sig, msg);
+        if (RES_NO_EVENT == r) {
+            std::stringstream ss;
+            ss << "not found event(" << eid << ") signal(" << sig << ")";
+            throw std::logic_error(ss.str());
+        }
+        raise(r, h, sig);
+    }
+
+    void Xyh_Jsm::digestion(Xyh_Handle h, unsigned int sig, const void* msg) {
+        raise(tryDigest(h, sig, msg), h, sig);
+    }
+
+    void Xyh_Jsm::process(unsigned int eid, unsigned int sig, const void * msg) {
+        Xyh_Handle h = m_events.find(eid);
+        Xyh_Result r = tryProcess(h, sig, msg);
+        if (RES_NO_EVENT == r) {
+            std::stringstream ss;
+            ss << "not found event(" << eid << ") signal(" << sig << ")";
+            throw std::logic_error(ss.str());
+        }
+        raise(r, h, sig);
+    }
+
+    void Xyh_Jsm::process(Xyh_Handle h, unsigned int sig, const void * msg) {
+        raise(tryProcess(h, sig, msg), h, sig);
+    }
+
+    Xyh_Result Xyh_Jsm::tryProcess(unsigned int eid, unsigned int sig, const void* msg) {
+        return tryProcess(m_events.find(eid), sig, msg);
+    }
+
+    Xyh_Result Xyh_Jsm::tryProcess(Xyh_Handle h, unsigned int sig, const void* msg) {
+        Xyh_Event* event = m_events.get(h);
+        if (!event) {
+            reject(RES_NO_EVENT, 0, sig);
+            return RES_NO_EVENT;
+        }
+
+        journal(Xyh_Journal::REC_PROCESS, event->m_id, sig, 0, msg);
+        _JournalScope scope(this);
+        return tryDispatch(*event, sig, msg, false);
+    }
+
+    Xyh_Result Xyh_Jsm::tryDigest(unsigned int eid, unsigned int sig, const void* msg) {
+        return tryDigest(m_events.find(eid), sig, msg);
+    }
+
+    Xyh_Result Xyh_Jsm::tryDigest(Xyh_Handle h, unsigned int sig, const void* msg) {
+        Xyh_Event* event = m_events.get(h);
+        if (!event) {
+            reject(RES_NO_EVENT, 0, sig);
+            return RES_NO_EVENT;
+        }
+
+        journal(Xyh_Journal::REC_DIGEST, event->m_id, sig, 0, msg);
+        _JournalScope scope(this);
+        return tryDispatch(*event, sig, msg, true);
+    }
+
+    void Xyh_Jsm::raise(Xyh_Result r, Xyh_Handle h, unsigned int sig) const {
+        std::stringstream ss;
+        if (RES_NO_EVENT == r) {
+            ss << "not found event handle(" << h.value() << ") signal(" << sig << ")";
+        }
+        else if (RES_NO_ROUTE == r) {
+            const Xyh_Status* s = m_events.get(h)->m_curStatus.get();
+            ss << "not found next status. current status:";
+            if (s) {
+                ss << s->m_Id;
+            }
+            else {
+                ss << "none";
+            }
+            ss << " Signal:" << sig;
+        }
+        else {
+            return;
+        }
+        throw std::logic_error(ss.str());
+    }
+
+    void Xyh_Jsm::reject(Xyh_Result r, const Xyh_Status* s, unsigned int sig, unsigned long long n) {
+        Xyh_Rejects* slot = 0;
+
+        //冻结后使用freeze时分配的定长表，不分配内存；不属于本状态机的状态计入NO_STATUS行
+        if (m_dispatch) {
+            int col = m_dispatch->column(sig);
+            size_t width = m_dispatch->columns() + 1;
+            size_t row = (s && s->m_dispatch == m_dispatch.get()) ? s->m_index : m_dispatch->size();
+            slot = &m_rejectTable[row * width + (col >= 0 ? (size_t)col : width - 1)];
+        }
+        else {
+            slot = &m_rejectMap[std::make_pair(s ? s->m_Id : NO_STATUS, sig)];
+        }
+
+        switch (r) {
+        case RES_NO_EVENT:
+            slot->noEvent += n;
+            m_rejectTotal.noEvent += n;
+            break;
+        case RES_EXPIRED:
+            slot->expired += n;
+            m_rejectTotal.expired += n;
+            break;
+        case RES_NO_ROUTE:
+            slot->noRoute += n;
+            m_rejectTotal.noRoute += n;
+            break;
+        default:
+            break;
+        }
+    }
+
+    Xyh_Rejects Xyh_Jsm::rejects(unsigned int status, unsigned int sig) const {
+        Xyh_Rejects r;
+        if (m_dispatch) {
+            int col = m_dispatch->column(sig);
+            size_t width = m_dispatch->columns() + 1;
+            size_t row = m_dispatch->size();
+            if (NO_STATUS != status) {
+                map<unsigned int, shared_ptr<Xyh_Status> >::const_iterator it = m_definition->m_mapStatus.find(status);
+                row = (it == m_definition->m_mapStatus.end()) ? row + 1 : it->second->getIndex();
+            }
+            if (row <= m_dispatch->size()) {
+                r = m_rejectTable[row * width + (col >= 0 ? (size_t)col : width - 1)];
+            }
+        }
+
+        map<pair<unsigned int, unsigned int>, Xyh_Rejects>::const_iterator it = m_rejectMap.find(std::make_pair(status, sig));
+        if (it != m_rejectMap.end()) {
+            r.noEvent += it->second.noEvent;
+            r.expired += it->second.expired;
+            r.noRoute += it->second.noRoute;
+        }
+        return r;
+    }
+
+    Xyh_Result Xyh_Jsm::tryDispatch(Xyh_Event& event, unsigned int sig, const void* msg, bool self) {
+        //过期的event不再处理
+        if (event.expired()) {
+            reject(RES_EXPIRED, event.m_curStatus.get(), sig);
+            return RES_EXPIRED;
+        }
+
+        //异步处理函数完成前，同一事件的信号按到达顺序排队
+        if (event.m_suspended) {
+            defer(event, sig, msg, self, 0);
+            return RES_DEFERRED;
+        }
+
+        shared_ptr<XYH_StatusMachine::Xyh_Status> cS = event.getCurrentStatus();
+
+        //尚未放入任何状态的事件没有转移路线，计入NO_STATUS的拒绝计数
+        if (!cS) {
+            reject(RES_NO_ROUTE, 0, sig);
+            return RES_NO_ROUTE;
+        }
+
+        shared_ptr<XYH_StatusMachine::Xyh_Status> nS = cS->route(sig);
+
+        if (!nS) {
+            reject(RES_NO_ROUTE, cS.get(), sig);
+            return RES_NO_ROUTE;
+        }
+
+        if (self && cS->getId() == nS->getId()) {
+            //持有事件的引用，防止信号处理函数中删除事件
+            shared_ptr<Xyh_Event> e = event.shared_from_this();
+            if (m_recorder) {
+                trace(Xyh_Recorder::ENT_SELF, event.m_id, cS->m_Id, cS->m_Id, sig, timestampMs());
+            }
+            cS->invoke(e, sig, msg);
+        }
+        else {
+            event.move(nS, sig, msg);
+        }
+        return RES_OK;
+    }
+
+    size_t Xyh_Jsm::processBatch(const Xyh_Signal* records, size_t n, Xyh_Result* results) {
+        return batch(records, n, results, false);
+    }
+
+    size_t Xyh_Jsm::digestBatch(const Xyh_Signal* records, size_t n, Xyh_Result* results) {
+        return batch(records, n, results, true);
+    }
+
+    size_t Xyh_Jsm::batch(const Xyh_Signal* records, size_t n, Xyh_Result* results, bool self) {
+        vector<_BatchItem> items;
+        items.swap(m_batch);
+        items.resize(n);
+
+        //第一遍：查找所有事件并预取事件对象
+        for (size_t i = 0; i < n; i++) {
+            items[i].handle = m_events.find(records[i].event);
+            items[i].pos = i;
+            Xyh_Event* e = m_events.get(items[i].handle);
+            items[i].status = e;
+            XYH_PREFETCH(e);
+        }
+
+        //第二遍：读取事件当前所在状态并预取
+        for (size_t i = 0; i < n; i++) {
+            Xyh_Event* e = (Xyh_Event*)items[i].status;
+            if (e) {
+                items[i].status = e->m_curStatus.get();
+                XYH_PREFETCH(items[i].status);
+            }
+        }
+
+        //按状态、事件分组；同一事件的记录保持原有顺序
+        std::sort(items.begin(), items.end());
+
+        size_t ok = 0;
+        for (size_t i = 0; i < n; i++) {
+            //每次处理前重新通过句柄获取事件，之前的信号处理函数可能已删除事件
+            const _BatchItem& item = items[i];
+            Xyh_Event* e = m_events.get(item.handle);
+            Xyh_Result r = RES_NO_EVENT;
+            if (e) {
+                journal(self ? Xyh_Journal::REC_DIGEST : Xyh_Journal::REC_PROCESS,
+                    e->m_id, records[item.pos].signal, 0, records[item.pos].msg);
+                _JournalScope scope(this);
+                r = tryDispatch(*e, records[item.pos].signal, records[item.pos].msg, self);
+            }
+            else {
+                reject(RES_NO_EVENT, 0, records[item.pos].signal);
+            }
+            if (results) {
+                results[item.pos] = r;
+            }
+            if (RES_OK == r) {
+                ok++;
+            }
+        }
+
+        items.clear();
+        if (m_batch.capacity() < items.capacity()) {
+            m_batch.swap(items);
+        }
+        return ok;
+    }
+
+    size_t Xyh_Jsm::process(unsigned int sig, const void * msg) {
+        return broadcast(sig, msg, 0);
+    }
+
+    size_t Xyh_Jsm::process(unsigned int sig, const void * msg, boost::asio::thread_pool& pool) {
+        return broadcast(sig, msg, &pool);
+    }
+
+    namespace {
+        /**
+         说明：并行广播时等待所有分组执行完毕，并保存第一个异常信息
+        */
+        struct _BroadcastLatch {
+            boost::mutex mutex;
+            boost::condition_variable cond;
+            size_t pending;
+            bool failed;
+            string what;
+        };
+
+        /**
+         说明：分组结束时计数减一并记录异常；无论分组如何结束都会执行，保证广播线程不会一直等待
+        */
+        struct _BroadcastCountDown {
+            explicit _BroadcastCountDown(_BroadcastLatch* latch) : m_latch(latch), m_failed(false) { }
+
+            ~_BroadcastCountDown() {
+                boost::mutex::scoped_lock lock(m_latch->mutex);
+                if (m_failed && !m_latch->failed) {
+                    m_latch->failed = true;
+                    m_latch->what.swap(m_what);
+                }
+                if (0 == --m_latch->pending) {
+                    m_latch->cond.notify_all();
+                }
+            }
+
+            void fail(const char* what) {
+                m_failed = true;
+                m_what = what;
+            }
+
+            _BroadcastLatch* m_latch;
+            bool m_failed;
+            string m_what;
+        };
+
+        void runBroadcastGroup(shared_ptr<Xyh_Status> to, shared_ptr<Xyh_Event>* begin, shared_ptr<Xyh_Event>* end,
+            unsigned int sig, const void* msg, _BroadcastLatch* latch) {
+            _BroadcastCountDown done(latch);
+            try {
+                for (shared_ptr<Xyh_Event>* it = begin; it != end; ++it) {
+                    to->invoke(*it, sig, msg);
+                }
+            }
+            catch (std::exception& e) {
+                done.fail(e.what());
+            }
+            catch (...) {
+                done.fail("unknown exception");
+            }
+        }
+    }
+
+    size_t Xyh_Jsm::broadcast(unsigned int sig, const void* msg, boost::asio::thread_pool* pool) {
+        journal(Xyh_Journal::REC_BROADCAST, 0, sig, 0, msg);
+        _JournalScope scope(this);
+
+        vector<_BroadcastGroup> groups;
+        vector<Xyh_Handle> handles;
+        groups.swap(m_broadcastGroups);
+        handles.swap(m_broadcastHandles);
+
+        //每个状态只查找一次转移，并对成员做快照；信号处理函数可能改变状态的成员
+        size_t misses = 0;
+        typedef map<unsigned int, shared_ptr<Xyh_Status> >::iterator Iter;
+        for (Iter it = m_definition->m_mapStatus.begin(); it != m_definition->m_mapStatus.end(); ++it) {
+            Xyh_Status* s = it->second.get();
+            Xyh_Status::EventList& list = members(s);
+            if (list.empty()) { continue; }
+
+            shared_ptr<Xyh_Status> nS = s->route(sig);
+            if (!nS) {
+                misses += list.size();
+                reject(RES_NO_ROUTE, s, sig, list.size());
+                continue;
+            }
+
+            _BroadcastGroup g;
+            g.from = s;
+            g.to = nS;
+            g.begin = handles.size();
+            for (Xyh_Status::EventList::iterator e = list.begin(); e != list.end(); ++e) {
+                //只处理登记在本状态机中的事件
+                if (m_events.get(e->m_handle) == &*e) {
+                    handles.push_back(e->m_handle);
+                }
+            }
+            g.end = handles.size();
+            groups.push_back(g);
+        }
+
+        if (!pool) {
+            for (size_t i = 0; i < groups.size(); i++) {
+                const _BroadcastGroup& g = groups[i];
+                for (size_t k = g.begin; k < g.end; k++) {
+                    //之前的信号处理函数可能已删除事件或使其离开源状态
+                    Xyh_Event* e = m_events.get(handles[k]);
+                    if (!e || e->expired()) { continue; }
+
+                    if (e->m_curStatus.get() == g.from && !e->m_suspended) {
+                        e->move(g.to, sig, msg);
+                    }
+                    else if (RES_NO_ROUTE == tryDispatch(*e, sig, msg, false)) {
+                        misses++;
+                    }
+                }
+            }
+        }
+        else {
+            //先在当前线程完成所有转移，再按源状态分组并行执行信号处理函数
+            vector<shared_ptr<Xyh_Event> > entered;
+            entered.reserve(handles.size());
+            for (size_t i = 0; i < groups.size(); i++) {
+                _BroadcastGroup& g = groups[i];
+                size_t begin = entered.size();
+                for (size_t k = g.begin; k < g.end; k++) {
+                    Xyh_Event* e = m_events.get(handles[k]);
+                    if (e && e->m_suspended) {
+                        defer(*e, sig, msg, false, 0);
+                    }
+                    else if (e && e->enter(g.to, sig)) {
+                        entered.push_back(e->shared_from_this());
+                    }
+                }
+                g.begin = begin;
+                g.end = entered.size();
+            }
+
+            _BroadcastLatch latch;
+            latch.pending = 0;
+            latch.failed = false;
+            for (size_t i = 0; i < groups.size(); i++) {
+                if (groups[i].begin != groups[i].end) {
+                    latch.pending++;
+                }
+            }
+            for (size_t i = 0; i < groups.size(); i++) {
+                const _BroadcastGroup& g = groups[i];
+                if (g.begin == g.end) { continue; }
+                boost::asio::post(*pool, boost::bind(&runBroadcastGroup, g.to,
+                    &entered[0] + g.begin, &entered[0] + g.end, sig, msg, &latch));
+            }
+
+            {
+                boost::mutex::scoped_lock lock(latch.mutex);
+                while (latch.pending) {
+                    latch.cond.wait(lock);
+                }
+            }
+
+            if (latch.failed) {
+                std::stringstream ss;
+                ss << "routine failed during parallel broadcast. Signal:" << sig << " what:" << latch.what;
+                throw std::logic_error(ss.str());
+            }
+        }
+
+        m_broadcastMisses += misses;
+
+        groups.clear();
+        handles.clear();
+        if (m_broadcastGroups.capacity() < groups.capacity()) {
+            m_broadcastGroups.swap(groups);
+        }
+        if (m_broadcastHandles.capacity() < handles.capacity()) {
+            m_broadcastHandles.swap(handles);
+        }
+        return misses;
+    }
+
+    Xyh_Jsm::~Xyh_Jsm() {
+        //释放入口队列中尚未执行的操作
+        if (m_ingress) {
+            Xyh_Signal r;
+            unsigned char kind;
+            while (m_ingress->pop(r, kind)) {
+                if (Xyh_IngressQueue::REC_CALL == kind) {
+                    delete (IngressCall*)r.msg;
+                }
+            }
+        }
+
+        if (m_hub) {
+            m_hub->detach(m_hubSlot);
+        }
+        if (m_clock) {
+            m_clock->detach(m_clockSlot);
+        }
+
+        //事件可能比状态机存活得更久，解除其与本状态机的关联
+        for (size_t i = 0; i < m_members.size(); i++) {
+            Xyh_Status::EventList& list = m_members[i];
+            while (!list.empty()) {
+                Xyh_Event& e = list.front();
+                list.pop_front();
+                e.m_memberOf = 0;
+                e.m_machine = 0;
+            }
+        }
+        for (size_t i = 0; i < m_events.size(); i++) {
+            if (m_events.at(i)->m_machine == this) {
+                m_events.at(i)->m_machine = 0;
+            }
+        }
+
+        BOOST_FOREACH(const shared_ptr<Xyh_Status>& s, m_definition->m_statuses) {
+            if (s->m_machine == this) {
+                s->m_machine = 0;
+            }
+        }
+    }
+
+    void Xyh_Jsm::addStatus(shared_ptr<Xyh_Status> s) throw (std::logic_error) {
+        if (m_dispatch) {
+            throw std::logic_error("machine has been frozen");
+        }
+
+        size_t n = m_definition->size();
+        m_definition->addStatus(s);
+        if (m_definition->size() != n) {
+            s->m_machine = this;
+            m_members.emplace_back();
+        }
+    }
+
+    shared_ptr<Xyh_Status> Xyh_Jsm::findStatus(unsigned int id) {
+        return m_definition->findStatus(id);
+    }
+
+    size_t Xyh_Jsm::occupancy(unsigned int status) throw (std::logic_error) {
+        return members(statusOrThrow(status)).size();
+    }
+
+    size_t Xyh_Jsm::oldest(unsigned int status, size_t n, vector<shared_ptr<Xyh_Event> >& out) throw (std::logic_error) {
+        return collectOldest(members(statusOrThrow(status)), n, out);
+    }
+
+    size_t Xyh_Jsm::olderThan(unsigned int status, unsigned long long ms, vector<shared_ptr<Xyh_Event> >& out) throw (std::logic_error) {
+        Xyh_Status::EventList& list = members(statusOrThrow(status));
+        return collectOlderThan(list, timestampMs(), ms, out);
+    }
+
+    Xyh_Status* Xyh_Jsm::statusOrThrow(unsigned int id) const throw (std::logic_error) {
+        map<unsigned int, shared_ptr<Xyh_Status> >::const_iterator it = m_definition->m_mapStatus.find(id);
+        if (it == m_definition->m_mapStatus.end()) {
+            std::stringstream ss;
+            ss << "not found status:" << id;
+            throw std::logic_error(ss.str());
+        }
+        return it->second.get();
+    }
+
+    void Xyh_Jsm::freeze() throw (std::logic_error) {
+        if (m_dispatch) {
+            return;
+        }
+
+        //冻结前的拒绝计数保留在m_rejectMap中
+        m_definition->freeze();
+        m_dispatch = m_definition->m_dispatch;
+        allocRejects();
+    }
+
+    void Xyh_Jsm::allocRejects() {
+        m_rejectTable.assign((m_dispatch->size() + 1) * (m_dispatch->columns() + 1), Xyh_Rejects());
+    }
+
+    namespace {
+        //快照文件标识
+        const char SNAPSHOT_MAGIC[4] = { 'X', 'J', 'S', 'M' };
+
+        /**
+         说明：快照文件头；其后依次为events个_SnapshotEvent、timers个_SnapshotTimer、nickBytes字节的别名
+        */
+        struct _SnapshotHeader {
+            char magic[4];
+            unsigned int version;
+            unsigned int headerSize;
+            unsigned int reserved;
+
+            //写入快照时的状态机时刻，单位为ms
+            unsigned long long at;
+
+            unsigned long long events;
+            unsigned long long timers;
+            unsigned long long nickBytes;
+
+            //快照包含的最后一条日志序号；未启用日志时为0
+            unsigned long long journal;
+        };
+
+        /**
+         说明：快照中的事件；同一状态的成员按其在状态事件列表中的顺序存放
+        */
+        struct _SnapshotEvent {
+            unsigned int id;
+
+            //所在状态id；未放入状态时为Xyh_Jsm::NO_STATUS
+            unsigned int status;
+
+            //进入状态时间，单位为ms
+            unsigned long long enterTime;
+
+            //别名在别名区中的偏移与长度
+            unsigned int nickOffset;
+            unsigned int nickLength;
+
+            //该事件的定时数量；定时按事件顺序连续存放
+            unsigned int timers;
+
+            //事件运行状态
+            unsigned char stt;
+
+            //是否在所在状态的事件列表中
+            unsigned char member;
+
+            unsigned short reserved;
+        };
+
+        /**
+         说明：按进入时间比较事件
+        */
+        struct _EnterTimeLess {
+            bool operator()(const Xyh_Event& a, const Xyh_Event& b) const {
+                return a.enterTimeMs() < b.enterTimeMs();
+            }
+        };
+
+        /**
+         说明：快照中的定时
+        */
+        struct _SnapshotTimer {
+            //到期时刻，单位为ms
+            unsigned long long deadline;
+
+            unsigned int label;
+            unsigned int reserved;
+        };
+    }
+
+    void Xyh_Jsm::snapshot(const string& path) throw (std::logic_error) {
+        vector<_SnapshotEvent> events;
+        vector<_SnapshotTimer> timers;
+        string nicks;
+        events.reserve(m_events.size());
+
+        //先按状态写出成员以保持列表顺序，再写出不在任何列表中的事件
+        vector<Xyh_Event*> order;
+        order.reserve(m_events.size());
+        typedef map<unsigned int, shared_ptr<Xyh_Status> >::value_type VType;
+        BOOST_FOREACH(const VType& v, m_definition->m_mapStatus) {
+            Xyh_Status::EventList& list = members(v.second.get());
+            for (Xyh_Status::EventList::iterator it = list.begin(); it != list.end(); ++it) {
+                if (m_events.get(it->m_handle) == &*it) {
+                    order.push_back(&*it);
+                }
+            }
+        }
+        for (size_t i = 0; i < m_events.size(); i++) {
+            if (!m_events.at(i)->m_memberOf || m_events.at(i)->m_machine != this) {
+                order.push_back(m_events.at(i).get());
+            }
+        }
+
+        BOOST_FOREACH(Xyh_Event* e, order) {
+            if (nicks.size() + e->m_nick.size() > 0xFFFFFFFFULL) {
+                throw std::logic_error("snapshot nick area exceeds 4GB");
+            }
+
+            _SnapshotEvent r;
+            std::memset(&r, 0, sizeof(r));
+            r.id = e->m_id;
+            r.status = e->m_curStatus ? e->m_curStatus->getId() : NO_STATUS;
+            r.enterTime = e->m_enterTime;
+            r.nickOffset = (unsigned int)nicks.size();
+            r.nickLength = (unsigned int)e->m_nick.size();
+            r.stt = e->m_stt;
+            r.member = (e->m_memberOf && e->m_machine == this) ? 1 : 0;
+            nicks += e->m_nick;
+
+            typedef boost::intrusive::list<Xyh_Timer, boost::intrusive::member_hook<Xyh_Timer,
+                Xyh_Timer::Hook, &Xyh_Timer::eventHook>, boost::intrusive::constant_time_size<false> > TimerList;
+            for (TimerList::iterator t = e->m_timers.begin(); t != e->m_timers.end(); ++t) {
+                _SnapshotTimer st;
+                std::memset(&st, 0, sizeof(st));
+                st.deadline = t->deadline;
+                st.label = t->label;
+                timers.push_back(st);
+                r.timers++;
+            }
+            events.push_back(r);
+        }
+
+        _SnapshotHeader hdr;
+        std::memset(&hdr, 0, sizeof(hdr));
+        std::memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+        hdr.version = SNAPSHOT_VERSION;
+        hdr.headerSize = sizeof(hdr);
+        hdr.at = timestampMs();
+        hdr.events = events.size();
+        hdr.timers = timers.size();
+        hdr.nickBytes = nicks.size();
+        hdr.journal = m_journal ? m_journal->sequence() : 0;
+
+        string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp.c_str(), std::ios::binary | std::ios::trunc);
+            out.write((const char*)&hdr, sizeof(hdr));
+            if (!events.empty()) {
+                out.write((const char*)&events[0], events.size() * sizeof(_SnapshotEvent));
+            }
+            if (!timers.empty()) {
+                out.write((const char*)&timers[0], timers.size() * sizeof(_SnapshotTimer));
+            }
+            out.write(nicks.data(), nicks.size());
+            out.flush();
+            if (!out) {
+                std::remove(tmp.c_str());
+                std::stringstream ss;
+                ss << "failed to write snapshot(" << tmp << ")";
+                throw std::logic_error(ss.str());
+            }
+        }
+
+        if (0 != std::rename(tmp.c_str(), path.c_str())) {
+            std::remove(tmp.c_str());
+            std::stringstream ss;
+            ss << "failed to rename snapshot to(" << path << ")";
+            throw std::logic_error(ss.str());
+        }
+    }
+
+    size_t Xyh_Jsm::restore(const string& path, EventFactory factory) throw (std::logic_error) {
+        if (m_events.size() || m_wheel.size()) {
+            throw std::logic_error("snapshot can only be restored into an empty status machine");
+        }
+
+        boost::interprocess::file_mapping file;
+        boost::interprocess::mapped_region region;
+        try {
+            boost::interprocess::file_mapping(path.c_str(), boost::interprocess::read_only).swap(file);
+            boost::interprocess::mapped_region(file, boost::interprocess::read_only).swap(region);
+        }
+        catch (std::exception& e) {
+            std::stringstream ss;
+            ss << "failed to map snapshot(" << path << "): " << e.what();
+            throw std::logic_error(ss.str());
+        }
+
+        const char* base = (const char*)region.get_address();
+        size_t size = region.get_size();
+        const _SnapshotHeader* hdr = (const _SnapshotHeader*)base;
+        if (size < sizeof(_SnapshotHeader) || 0 != std::memcmp(hdr->magic, SNAPSHOT_MAGIC, sizeof(hdr->magic))) {
+            throw std::logic_error("not a status machine snapshot");
+        }
+        if (hdr->version != SNAPSHOT_VERSION || hdr->headerSize != sizeof(_SnapshotHeader)) {
+            std::stringstream ss;
+            ss << "unsupported snapshot version(" << hdr->version << ")";
+            throw std::logic_error(ss.str());
+        }
+
+        //逐段与剩余字节数比较，避免计数过大时乘法或加法回绕
+        size_t rest = size - sizeof(_SnapshotHeader);
+        if (hdr->events > rest / sizeof(_SnapshotEvent)) {
+            throw std::logic_error("snapshot is truncated or corrupt");
+        }
+        rest -= (size_t)hdr->events * sizeof(_SnapshotEvent);
+        if (hdr->timers > rest / sizeof(_SnapshotTimer)) {
+            throw std::logic_error("snapshot is truncated or corrupt");
+        }
+        rest -= (size_t)hdr->timers * sizeof(_SnapshotTimer);
+        if (hdr->nickBytes != rest) {
+            throw std::logic_error("snapshot is truncated or corrupt");
+        }
+
+        const _SnapshotEvent* events = (const _SnapshotEvent*)(base + sizeof(_SnapshotHeader));
+        const _SnapshotTimer* timers = (const _SnapshotTimer*)(events + hdr->events);
+        const char* nicks = (const char*)(timers + hdr->timers);
+
+        //先校验全部记录，保证失败时状态机未被修改
+        vector<Xyh_Status*> statuses(hdr->events);
+        unsigned long long timerCount = 0;
+        for (size_t i = 0; i < hdr->events; i++) {
+            const _SnapshotEvent& r = events[i];
+            if (r.nickLength > hdr->nickBytes || r.nickOffset > hdr->nickBytes - r.nickLength) {
+                throw std::logic_error("snapshot is truncated or corrupt");
+            }
+            timerCount += r.timers;
+
+            statuses[i] = 0;
+            if (NO_STATUS == r.status) {
+                if (r.member || r.timers) {
+                    throw std::logic_error("snapshot is truncated or corrupt");
+                }
+                continue;
+            }
+
+            map<unsigned int, shared_ptr<Xyh_Status> >::iterator it = m_definition->m_mapStatus.find(r.status);
+            if (it == m_definition->m_mapStatus.end()) {
+                std::stringstream ss;
+                ss << "snapshot references unknown status(" << r.status << ") event(" << r.id << ")";
+                throw std::logic_error(ss.str());
+            }
+            statuses[i] = it->second.get();
+        }
+        if (timerCount != hdr->timers) {
+            throw std::logic_error("snapshot is truncated or corrupt");
+        }
+
+        //时钟从快照时刻继续；当前时刻已超过快照时刻时平移所有时间
+        unsigned long long now = timestampMs();
+        unsigned long long shift = 0;
+        if (hdr->at >= now) {
+            m_epoch -= boost::asio::chrono::milliseconds(hdr->at - now);
+        }
+        else {
+            shift = now - hdr->at;
+        }
+
+        m_events.reserve(hdr->events);
+        m_wheel.reserve(hdr->timers);
+        if (!factory) {
+            eventPool(sizeof(Xyh_Event))->reserve(hdr->events);
+        }
+
+        unsigned long long stamp = m_metrics ? Xyh_Metrics::now() : 0;
+        const _SnapshotTimer* t = timers;
+        for (size_t i = 0; i < hdr->events; i++) {
+            const _SnapshotEvent& r = events[i];
+            string nick(nicks + r.nickOffset, r.nickLength);
+            shared_ptr<Xyh_Event> e = factory ? factory(r.id, nick) : createEvent(r.id, nick);
+
+            e->m_stt = r.stt;
+            e->m_enterTime = r.enterTime + shift;
+            e->m_machine = this;
+            m_events.insert(e);
+            if (e->expired()) {
+                recycle(e.get());
+            }
+
+            Xyh_Status* s = statuses[i];
+            if (!s) {
+                continue;
+            }
+
+            e->m_curStatus = s->shared_from_this();
+            m_events.refresh(e.get());
+            if (r.member) {
+                members(s).push_back(*e);
+                e->m_memberOf = s;
+                e->m_machine = this;
+                if (m_metrics) {
+                    e->m_enterNs = stamp;
+                    m_metrics->enter(s->m_index);
+                }
+            }
+
+            for (unsigned int k = 0; k < r.timers; k++, t++) {
+                e->m_timers.push_back(*m_wheel.schedule(t->deadline + shift, t->label, e.get(), s));
+            }
+        }
+
+        //快照中的事件按事件表顺序存放，恢复后按进入时间重新排列
+        for (size_t i = 0; i < m_members.size(); i++) {
+            m_members[i].sort(_EnterTimeLess());
+        }
+
+        m_snapshotSeq = hdr->journal;
+        arm();
+        return (size_t)hdr->events;
+    }
+
+    void Xyh_Jsm::enableJournal(shared_ptr<Xyh_Journal> journal, PayloadEncoder encoder) {
+        m_journal = journal;
+        m_journalEncoder = encoder;
+    }
+
+    void Xyh_Jsm::journalAppend(unsigned char type, unsigned int event, unsigned int signal, unsigned int status, const void* msg) {
+        m_journalPayload.clear();
+        if (msg && m_journalEncoder) {
+            m_journalEncoder(signal, msg, m_journalPayload);
+        }
+        if (m_timerDepth) {
+            type |= Xyh_Journal::REC_TIMER;
+        }
+        m_journal->append(type, timestampMs(), event, signal, status, m_journalPayload.data(), m_journalPayload.size());
+    }
+
+    namespace {
+        /**
+         说明：日志回放；只通过状态机的公开接口重新执行记录
+        */
+        struct _Replayer {
+            _Replayer(Xyh_Jsm& jsm, EventFactory& factory, unsigned long long from, Xyh_Clock* clock,
+                Xyh_Clock::TimePoint epoch) :
+                jsm(jsm), factory(factory), from(from), clock(clock), epoch(epoch), applied(0) { }
+
+            void operator()(const Xyh_Journal::Record& r) {
+                if (r.seq <= from) {
+                    return;
+                }
+
+                //先触发记录时刻之前到期的定时；由定时处理函数发起的记录随定时重新产生，不再执行
+                bool driven = clock && clock->advanceTo(epoch + boost::asio::chrono::milliseconds(r.tick));
+                if (driven && (r.type & Xyh_Journal::REC_TIMER)) {
+                    return;
+                }
+
+                const void* msg = r.payload.empty() ? 0 : r.payload.data();
+                switch (r.type & ~Xyh_Journal::REC_TIMER) {
+                case Xyh_Journal::REC_ADD:
+                    jsm.addEvent(factory ? factory(r.event, r.payload) : jsm.createEvent(r.event, r.payload));
+                    break;
+                case Xyh_Journal::REC_RELEASE:
+                    jsm.relEvent(r.event);
+                    break;
+                case Xyh_Journal::REC_EXPIRE:
+                    jsm.expireEvent(r.event);
+                    break;
+                case Xyh_Journal::REC_PLACE: {
+                    shared_ptr<Xyh_Event> e = jsm.findEvent(r.event);
+                    shared_ptr<Xyh_Status> s = jsm.findStatus(r.status);
+                    if (e && s) {
+                        e->place(s, r.signal, msg);
+                    }
+                    break;
+                }
+                case Xyh_Journal::REC_PROCESS:
+                    jsm.tryProcess(r.event, r.signal, msg);
+                    break;
+                case Xyh_Journal::REC_DIGEST:
+                    jsm.tryDigest(r.event, r.signal, msg);
+                    break;
+                case Xyh_Journal::REC_BROADCAST:
+                    jsm.process(r.signal, msg);
+                    break;
+                default:
+                    std::stringstream ss;
+                    ss << "unknown journal record type(" << (unsigned int)r.type << ") seq(" << r.seq << ")";
+                    throw std::logic_error(ss.str());
+                }
+                applied++;
+            }
+
+            Xyh_Jsm& jsm;
+            EventFactory& factory;
+            unsigned long long from;
+            Xyh_Clock* clock;
+            Xyh_Clock::TimePoint epoch;
+            size_t applied;
+        };
+    }
+
+    size_t Xyh_Jsm::replay(const string& path, EventFactory factory) throw (std::logic_error) {
+        //回放期间不写日志
+        shared_ptr<Xyh_Journal> journal;
+        journal.swap(m_journal);
+
+        _Replayer replayer(*this, factory, m_snapshotSeq, m_clock.get(), m_epoch);
+        try {
+            Xyh_Journal::read(path, boost::ref(replayer));
+        }
+        catch (...) {
+            m_journal.swap(journal);
+            throw;
+        }
+        m_journal.swap(journal);
+        return replayer.applied;
+    }
+
+    shared_ptr<Xyh_Metrics> Xyh_Jsm::enableMetrics() throw (std::logic_error) {
+        if (!m_dispatch) {
+            throw std::logic_error("metrics require a frozen status machine");
+        }
+
+        if (!m_metrics) {
+            m_metrics.reset(new Xyh_Metrics(m_dispatch));
+
+            //已在状态中的事件从启用时刻开始计算停留时间
+            unsigned long long now = Xyh_Metrics::now();
+            for (unsigned int s = 0; s < m_members.size(); s++) {
+                Xyh_Status::EventList& events = m_members[s];
+                for (Xyh_Status::EventList::iterator it = events.begin(); it != events.end(); ++it) {
+                    it->m_enterNs = now;
+                    m_metrics->enter(s);
+                }
+            }
+        }
+        return m_metrics;
+    }
+
+    Xyh_Handle Xyh_Jsm::addEvent(shared_ptr<Xyh_Event> e) {
+        if (m_journal && !m_journalDepth) {
+            unsigned char type = Xyh_Journal::REC_ADD | (m_timerDepth ? Xyh_Journal::REC_TIMER : 0);
+            m_journal->append(type, timestampMs(), e->m_id, 0, 0, e->m_nick.data(), e->m_nick.size());
+        }
+
+        //已在其他状态机成员列表中的事件保持原有关联
+        if (!e->m_memberOf) {
+            e->m_machine = this;
+        }
+        return m_events.insert(e);
+    }
+
+    void Xyh_Jsm::relEvent(unsigned int id) {
+        relEvent(m_events.find(id));
+    }
+
+    void Xyh_Jsm::relEvent(Xyh_Handle h) {
+        Xyh_Event* event = m_events.get(h);
+        if (event) {
+            journal(Xyh_Journal::REC_RELEASE, event->m_id, 0, 0, 0);
+            event->expire();
+            m_events.erase(h);
+        }
+    }
+
+    void Xyh_Jsm::expireEvent(unsigned int id) {
+        Xyh_Event* event = m_events.get(m_events.find(id));
+        if (event) {
+            journal(Xyh_Journal::REC_EXPIRE, id, 0, 0, 0);
+            event->expire();
+        }
+    }
+
+    shared_ptr<Xyh_Event> Xyh_Jsm::findEvent(unsigned int id) {
+        return findEvent(m_events.find(id));
+    }
+
+    shared_ptr<Xyh_Event> Xyh_Jsm::findEvent(Xyh_Handle h) {
+        Xyh_Event* event = m_events.get(h);
+        return event ? event->shared_from_this() : shared_ptr<Xyh_Event>();
+    }
+
+    void Xyh_Jsm::ticktock(const boost::system::error_code & e) {
+        if (e) {
+            return;
+        }
+
+        tick();
+    }
+
+    void Xyh_Jsm::tick() {
+        m_armed = Xyh_TimerWheel::NEVER;
+
+        //取出所有到期的定时，包括因处理延迟而错过的；
+        //事件离开状态时其定时已被取消，这里无需再校验事件所在状态
+        unsigned long long now = timestampMs();
+        while (Xyh_Timer* t = m_wheel.expire(now)) {
+            shared_ptr<Xyh_Event> event = t->event->shared_from_this();
+            Xyh_Status* status = t->status;
+            unsigned int label = t->label;
+            m_wheel.release(t);
+
+            if (event->m_suspended) {
+                defer(*event, label, 0, false, status);
+            }
+            else if (!event->expired()) {
+                if (m_metrics) {
+                    m_metrics->timer(status->m_index);
+                }
+                trace(Xyh_Recorder::ENT_TIMER, event->m_id, status->m_Id, status->m_Id, label, now);
+                _TimerScope scope(this);
+                status->timerRoutine(label, event);
+            }
+        }
+
+        arm();
+    }
+
+    void Xyh_Jsm::arm() {
+        unsigned long long next = m_wheel.nextPending();
+        if (m_stopped || next == m_armed) {
+            return;
+        }
+
+        m_armed = next;
+        if (m_clock) {
+            if (next == Xyh_TimerWheel::NEVER) {
+                m_clock->cancel(m_clockSlot);
+            }
+            else {
+                m_clock->schedule(m_clockSlot, m_epoch + boost::asio::chrono::milliseconds(next));
+            }
+            return;
+        }
+
+        if (m_hub) {
+            if (next == Xyh_TimerWheel::NEVER) {
+                m_hub->cancel(m_hubSlot);
+            }
+            else {
+                m_hub->schedule(m_hubSlot, m_epoch + boost::asio::chrono::milliseconds(next));
+            }
+            return;
+        }
+
+        if (next == Xyh_TimerWheel::NEVER) {
+            m_timer.cancel();
+            return;
+        }
+
+        //使用绝对时刻，处理延迟不会累积
+        m_timer.expires_at(m_epoch + boost::asio::chrono::milliseconds(next));
+        m_timer.async_wait(boost::bind(&Xyh_Jsm::ticktock, this, _1));
+    }
+
+    void Xyh_Jsm::armBefore(unsigned long long deadline) {
+        if (deadline < m_armed) {
+            arm();
+        }
+    }
+
+    unsigned long long Xyh_Jsm::timestampMs() {
+        return boost::asio::chrono::duration_cast<boost::asio::chrono::milliseconds>(clockNow() - m_epoch).count();
+    }
+
+    boost::asio::steady_timer::time_point Xyh_Jsm::clockNow() {
+        return m_clock ? m_clock->now() : boost::asio::steady_timer::clock_type::now();
+    }
+
+    void Xyh_Jsm::setRecorder(shared_ptr<Xyh_Recorder> recorder) {
+        m_recorderOwner = recorder;
+        m_recorder = recorder.get();
+    }
+
+    void Xyh_Jsm::enableIngress(size_t capacity, size_t highWater, size_t batch) {
+        m_ingress.reset(new Xyh_IngressQueue(capacity));
+        m_ingressHighWater = (highWater && highWater < m_ingress->capacity()) ? highWater : m_ingress->capacity();
+        m_ingressBatch = batch ? batch : 1;
+        m_drainRecords.reserve(m_ingressBatch);
+        m_drainResults.resize(m_ingressBatch);
+    }
+
+    Xyh_Result Xyh_Jsm::submit(unsigned int event, unsigned int signal, const void* msg) {
+        Xyh_Signal r = { event, signal, msg };
+        return enqueue(r, Xyh_IngressQueue::REC_PROCESS);
+    }
+
+    Xyh_Result Xyh_Jsm::submitDigestion(unsigned int event, unsigned int signal, const void* msg) {
+        Xyh_Signal r = { event, signal, msg };
+        return enqueue(r, Xyh_IngressQueue::REC_DIGEST);
+    }
+
+    void Xyh_Jsm::submitCall(IngressCall call) {
+        Xyh_Signal r = { 0, 0, new IngressCall(call) };
+
+        //操作不能丢弃，队列已满时等待状态机线程取走记录
+        while (!m_ingress->push(r, Xyh_IngressQueue::REC_CALL)) {
+            boost::this_thread::yield();
+        }
+        wakeIngress();
+    }
+
+    Xyh_Result Xyh_Jsm::enqueue(const Xyh_Signal& r, unsigned char kind) {
+        if (m_ingress->size() >= m_ingressHighWater || !m_ingress->push(r, kind)) {
+            m_ingressBusy.fetch_add(1, boost::memory_order_relaxed);
+            return RES_BUSY;
+        }
+        wakeIngress();
+        return RES_OK;
+    }
+
+    void Xyh_Jsm::wakeIngress() {
+        //只有队列从空闲变为待处理的生产者负责唤醒状态机线程
+        if (!m_drainPending.exchange(true, boost::memory_order_acq_rel)) {
+            m_ioService.post(boost::bind(&Xyh_Jsm::drain, this));
+        }
+    }
+
+    void Xyh_Jsm::drain() {
+        //先清除标记再取记录，保证之后入队的生产者一定会再次投递
+        m_drainPending.store(false, boost::memory_order_seq_cst);
+
+        Xyh_Signal r;
+        unsigned char kind = Xyh_IngressQueue::REC_PROCESS;
+        bool runSelf = false;
+        size_t n = 0;
+        for (; n < m_ingressBatch && m_ingress->pop(r, kind); n++) {
+            bool call = (Xyh_IngressQueue::REC_CALL == kind);
+            bool self = (Xyh_IngressQueue::REC_DIGEST == kind);
+            if (!m_drainRecords.empty() && (call || self != runSelf)) {
+                drainRun(&m_drainRecords[0], m_drainRecords.size(), runSelf);
+                m_drainRecords.clear();
+            }
+
+            //操作之前提交的信号已处理完，之后提交的信号在操作之后处理
+            if (call) {
+                boost::scoped_ptr<IngressCall> c((IngressCall*)r.msg);
+                (*c)(*this);
+                continue;
+            }
+            runSelf = self;
+            m_drainRecords.push_back(r);
+        }
+        if (!m_drainRecords.empty()) {
+            drainRun(&m_drainRecords[0], m_drainRecords.size(), runSelf);
+            m_drainRecords.clear();
+        }
+
+        //本批次已满，队列中可能仍有记录
+        if (n == m_ingressBatch && !m_drainPending.exchange(true, boost::memory_order_acq_rel)) {
+            m_ioService.post(boost::bind(&Xyh_Jsm::drain, this));
+        }
+    }
+
+    namespace {
+        //m_signalClass中表示信号可合并的标志位，低位为通道
+        const unsigned char SIGNAL_COALESCE = 0x80;
+
+        //deliverSlice每次处理的最大记录数量
+        const size_t DELIVER_SLICE = 256;
+    }
+
+    void Xyh_Jsm::setSignalLane(unsigned int signal, unsigned int lane) throw (std::logic_error) {
+        if (lane >= LANES) {
+            std::stringstream ss;
+            ss << "invalid lane(" << lane << ") for signal(" << signal << ")";
+            throw std::logic_error(ss.str());
+        }
+
+        map<unsigned int, unsigned char>::iterator it = m_signalClass.find(signal);
+        unsigned char flags = (it == m_signalClass.end()) ? 0 : (it->second & SIGNAL_COALESCE);
+        m_signalClass[signal] = flags | (unsigned char)lane;
+    }
+
+    void Xyh_Jsm::setCoalescing(unsigned int signal, bool coalesce) {
+        map<unsigned int, unsigned char>::iterator it = m_signalClass.find(signal);
+        unsigned char lane = (it == m_signalClass.end()) ? (unsigned char)(LANES - 1) : (it->second & ~SIGNAL_COALESCE);
+        m_signalClass[signal] = coalesce ? (lane | SIGNAL_COALESCE) : lane;
+    }
+
+    bool Xyh_Jsm::post(unsigned int event, unsigned int signal, const void* msg) {
+        unsigned char flags = LANES - 1;
+        if (!m_signalClass.empty()) {
+            map<unsigned int, unsigned char>::const_iterator it = m_signalClass.find(signal);
+            if (it != m_signalClass.end()) {
+                flags = it->second;
+            }
+        }
+
+        _Queued q = { event, signal, msg, false };
+        if (flags & SIGNAL_COALESCE) {
+            _Queued*& pending = m_coalescing[std::make_pair(event, signal)];
+            if (pending) {
+                pending->msg = msg;
+                m_coalesced++;
+                return false;
+            }
+
+            q.coalescing = true;
+            m_lanes[flags & ~SIGNAL_COALESCE].push_back(q);
+            pending = &m_lanes[flags & ~SIGNAL_COALESCE].back();
+        }
+        else {
+            m_lanes[flags].push_back(q);
+        }
+        m_queued++;
+
+        if (!m_deliverPending) {
+            m_deliverPending = true;
+            m_ioService.post(boost::bind(&Xyh_Jsm::deliverSlice, this));
+        }
+        return true;
+    }
+
+    size_t Xyh_Jsm::deliver(size_t limit) {
+        size_t n = 0;
+        while (n < limit && m_queued) {
+            //每条记录处理后都从最高优先级通道重新查找，信号处理函数可能投递了更紧急的信号
+            unsigned int lane = 0;
+            while (m_lanes[lane].empty()) { lane++; }
+
+            _Queued q = m_lanes[lane].front();
+            if (q.coalescing) {
+                m_coalescing.erase(std::make_pair(q.event, q.signal));
+            }
+            m_lanes[lane].pop_front();
+            m_queued--;
+            n++;
+
+            tryProcess(q.event, q.signal, q.msg);
+        }
+        return n;
+    }
+
+    void Xyh_Jsm::deliverSlice() {
+        m_deliverPending = false;
+        deliver(DELIVER_SLICE);
+
+        if (m_queued && !m_deliverPending) {
+            m_deliverPending = true;
+            m_ioService.post(boost::bind(&Xyh_Jsm::deliverSlice, this));
+        }
+    }
+
+    void Xyh_Jsm::drainRun(const Xyh_Signal* records, size_t n, bool self) {
+        batch(records, n, &m_drainResults[0], self);
+        for (size_t i = 0; i < n; i++) {
+            if (RES_NO_EVENT == m_drainResults[i] || RES_NO_ROUTE == m_drainResults[i]) {
+                m_ingressRejected.fetch_add(1, boost::memory_order_relaxed);
+            }
+        }
+    }
+
+    shared_ptr<Xyh_Pool> Xyh_Jsm::eventPool(size_t size) {
+        size = (size + 15) & ~(size_t)15;
+        shared_ptr<Xyh_Pool>& pool = m_eventPools[size];
+        if (!pool) {
+            pool.reset(new Xyh_Pool(size));
+        }
+        return pool;
+    }
+
+    void Xyh_Jsm::enableEventColumns() {
+        if (!m_events.columns()) {
+            m_events.enableColumns(m_definition.get());
+        }
+    }
+
+    size_t Xyh_Jsm::selectEvents(const Xyh_EventFilter& filter, vector<Xyh_Handle>& out) throw (std::logic_error) {
+        return scanEvents(filter, &out);
+    }
+
+    size_t Xyh_Jsm::countEvents(const Xyh_EventFilter& filter) throw (std::logic_error) {
+        return scanEvents(filter, 0);
+    }
+
+    namespace {
+        //列存储每次扫描的事件数量
+        const size_t SCAN_BLOCK = 1024;
+    }
+
+    size_t Xyh_Jsm::scanEvents(const Xyh_EventFilter& filter, vector<Xyh_Handle>* out) throw (std::logic_error) {
+        const Xyh_Status* status = 0;
+        if (Xyh_EventFilter::ANY_STATUS != filter.status) {
+            status = statusOrThrow(filter.status);
+        }
+
+        const Xyh_EventColumns* columns = m_events.columns();
+        if (columns) {
+            unsigned int state = status ? status->m_index : (unsigned int)Xyh_EventColumns::NO_STATE;
+            if (!out) {
+                return columns->scan(state, filter.enteredBefore, filter.live, 0, columns->size(), 0);
+            }
+
+            //按块扫描到栈上的缓冲区，直接转换为句柄追加，不按事件总数分配和清零临时数组
+            unsigned int block[SCAN_BLOCK];
+            size_t hits = 0;
+            for (size_t begin = 0; begin < columns->size(); begin += SCAN_BLOCK) {
+                size_t n = std::min(SCAN_BLOCK, columns->size() - begin);
+                size_t found = columns->scan(state, filter.enteredBefore, filter.live, begin, n, block);
+                for (size_t k = 0; k < found; k++) {
+                    out->push_back(m_events.handleAt(begin + block[k]));
+                }
+                hits += found;
+            }
+            return hits;
+        }
+
+        size_t hits = 0;
+        for (size_t i = 0; i < m_events.size(); i++) {
+            const Xyh_Event& e = *m_events.at(i);
+            if ((!status || e.m_curStatus.get() == status) &&
+                (unsigned long long)e.m_enterTime < filter.enteredBefore &&
+                !(filter.live && e.m_stt == Xyh_Event::STT_RECYCLE)) {
+                if (out) {
+                    out->push_back(m_events.handleAt(i));
+                }
+                hits++;
+            }
+        }
+        return hits;
+    }
+
+    Xyh_AllocStats Xyh_Jsm::allocStats() {
+        Xyh_AllocStats stats;
+        typedef map<size_t, shared_ptr<Xyh_Pool> >::value_type VType;
+        BOOST_FOREACH(const VType& v, m_eventPools) {
+            const Xyh_Pool::Stats& s = v.second->stats();
+            stats.events.allocs += s.allocs;
+            stats.events.frees += s.frees;
+            stats.events.chunks += s.chunks;
+            stats.events.capacity += s.capacity;
+        }
+        stats.timers = m_wheel.poolStats();
+        return stats;
+    }
+
+    void Xyh_Jsm::stop() {
+        m_stopped = true;
+        m_armed = Xyh_TimerWheel::NEVER;
+        m_timer.cancel();
+        m_reclaimTimer.cancel();
+        if (m_hub) {
+            m_hub->cancel(m_hubSlot);
+        }
+        if (m_clock) {
+            m_clock->cancel(m_clockSlot);
+        }
+    }
+
+    void Xyh_Jsm::useTimerHub(shared_ptr<Xyh_TimerHub> hub) throw (std::logic_error) {
+        if (hub == m_hub) {
+            return;
+        }
+        if (hub && m_clock) {
+            throw std::logic_error("timer hub cannot be used with a custom clock");
+        }
+
+        if (m_hub) {
+            m_hub->detach(m_hubSlot);
+        }
+        m_timer.cancel();
+        m_armed = Xyh_TimerWheel::NEVER;
+
+        m_hub = hub;
+        if (m_hub) {
+            m_hubSlot = m_hub->attach(this);
+        }
+        arm();
+    }
+
+    void Xyh_Jsm::useClock(shared_ptr<Xyh_Clock> clock) throw (std::logic_error) {
+        if (clock == m_clock) {
+            return;
+        }
+        if (clock && m_hub) {
+            throw std::logic_error("custom clock cannot be used with a timer hub");
+        }
+
+        //按新时钟重新确定起点，已经过的时间按整ms保持不变，同样的调用顺序得到同样的时刻
+        unsigned long long elapsed = timestampMs();
+        if (m_clock) {
+            m_clock->detach(m_clockSlot);
+        }
+        m_timer.cancel();
+        m_armed = Xyh_TimerWheel::NEVER;
+
+        m_clock = clock;
+        if (m_clock) {
+            m_clockSlot = m_clock->attach(this);
+        }
+        m_epoch = clockNow() - boost::asio::chrono::milliseconds(elapsed);
+        arm();
+    }
+
+    void Xyh_Jsm::recycle(Xyh_Event* e) {
+        //未加入本状态机事件表的事件由使用者自行管理
+        if (m_events.get(e->m_handle) != e) {
+            return;
+        }
+
+        m_reclaim.push_back(e->m_handle);
+        if (!m_reclaimPending && !m_stopped) {
+            m_reclaimPending = true;
+            m_reclaimTimer.expires_at(boost::asio::steady_timer::clock_type::now());
+            m_reclaimTimer.async_wait(boost::bind(&Xyh_Jsm::reclaimSlice, this, _1));
+        }
+    }
+
+    void Xyh_Jsm::reclaimSlice(const boost::system::error_code& e) {
+        if (e == boost::asio::error::operation_aborted) {
+            return;
+        }
+
+        m_reclaimPending = false;
+        reclaim(m_reclaimSlice);
+
+        //每批之间让出线程，避免回收大量事件时阻塞其他处理
+        if (!m_reclaim.empty() && !m_stopped) {
+            m_reclaimPending = true;
+            m_reclaimTimer.expires_at(boost::asio::steady_timer::clock_type::now());
+            m_reclaimTimer.async_wait(boost::bind(&Xyh_Jsm::reclaimSlice, this, _1));
+        }
+    }
+
+    size_t Xyh_Jsm::reclaim(size_t limit) {
+        size_t n = 0;
+        while (n < limit && !m_reclaim.empty()) {
+            Xyh_Handle h = m_reclaim.front();
+            m_reclaim.pop_front();
+
+            //句柄已失效，或事件在过期后又被重新使用
+            Xyh_Event* event = m_events.get(h);
+            if (!event || !event->expired()) {
+                continue;
+            }
+
+            unsigned int id = event->m_id;
+            event->detach();
+            m_events.erase(h);
+            n++;
+            notifyFinish(id);
+        }
+        return n;
+    }
+
+    void Xyh_Jsm::defer(Xyh_Event& e, unsigned int sig, const void* msg, bool self, Xyh_Status* timer) {
+        _Deferred d = { sig, msg, self, timer, e.m_entries };
+        m_deferred[&e].push_back(d);
+    }
+
+    void Xyh_Jsm::resume(shared_ptr<Xyh_Event> e) {
+        e->m_suspended = 0;
+
+        map<Xyh_Event*, std::deque<_Deferred> >::iterator it = m_deferred.find(e.get());
+        while (it != m_deferred.end() && !it->second.empty() && !e->m_suspended) {
+            //挂起期间事件已被移出事件表，丢弃其余信号
+            if (m_events.get(e->m_handle) != e.get()) {
+                break;
+            }
+
+            _Deferred d = it->second.front();
+            it->second.pop_front();
+            if (!d.timer) {
+                tryDispatch(*e, d.signal, d.msg, d.self);
+            }
+            else if (!e->expired() && e->m_curStatus.get() == d.timer && e->m_entries == d.entry) {
+                //事件在挂起期间离开状态时定时已失效，离开后再次进入同一状态也是如此
+                if (m_metrics) {
+                    m_metrics->timer(d.timer->m_index);
+                }
+                if (m_recorder) {
+                    trace(Xyh_Recorder::ENT_TIMER, e->m_id, d.timer->m_Id, d.timer->m_Id, d.signal, timestampMs());
+                }
+                _TimerScope scope(this);
+                d.timer->timerRoutine(d.signal, e);
+            }
+            it = m_deferred.find(e.get());
+        }
+
+        //再次挂起时保留剩余的信号，由下一次resume继续处理
+        if (!e->m_suspended && it != m_deferred.end()) {
+            m_deferred.erase(it);
+        }
+    }
+
+    void Xyh_Jsm::notifyFinish(const unsigned int id) {
+        if (m_finishNotify) {
+            m_finishNotify(id);
+        }
     }
 
-}; //namespace XYH_StatusMachine
\ No newline at end of file
+}; //namespace XYH_StatusMachine
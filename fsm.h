@@ -6,22 +6,34 @@
 #include <tr1/memory>
 #endif
 
+#include <new>
 #include <set>
+#include <algorithm>
 #include <map>
 #include <list>
+#include <deque>
+#include <vector>
 #include <string>
 #include <utility>
 #include <iostream>
 //boost
 #include <boost/asio.hpp>
+#include <boost/atomic.hpp>
 #include <boost/foreach.hpp>
 #include <boost/function.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/intrusive/list.hpp>
 #include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/thread_pool.hpp>
+//local
+#include "fsm_recorder.h"
 
 namespace XYH_StatusMachine {
     using std::set;
     using std::map;
     using std::list;	
+    using std::vector;
     using std::pair;
     using std::string;
     using std::multimap;
@@ -30,7 +42,122 @@ namespace XYH_StatusMachine {
     using boost::asio::deadline_timer;
 
     class Xyh_Jsm;
+    class Xyh_Event;
     class Xyh_Status;
+    class Xyh_Dispatch;
+    class Xyh_Definition;
+    class Xyh_TimerWheel;
+    class Xyh_EventTable;
+    class Xyh_Metrics;
+    class Xyh_Journal;
+    class Xyh_AsyncStatus;
+    class Xyh_TimerHub;
+    class Xyh_Clock;
+    class Xyh_EventColumns;
+    struct Xyh_EventFilter;
+
+    /**
+     说明：信号处理结果
+    */
+    enum Xyh_Result {
+        RES_OK          = 0,    //信号已处理
+        RES_NO_EVENT    = 1,    //事件不存在
+        RES_EXPIRED     = 2,    //事件已过期，信号被忽略
+        RES_NO_ROUTE    = 3,    //当前状态上没有该信号的转移路线，或事件尚未放入任何状态
+        RES_BUSY        = 4,    //入口队列已达到高水位，信号未被接收
+        RES_DEFERRED    = 5     //事件的异步处理函数尚未完成，信号已排队，完成后按顺序处理
+    };
+
+    /**
+     说明：被拒绝信号的计数
+    */
+    struct Xyh_Rejects {
+        //事件不存在
+        unsigned long long noEvent;
+
+        //事件已过期
+        unsigned long long expired;
+
+        //当前状态上没有转移路线
+        unsigned long long noRoute;
+
+        Xyh_Rejects() : noEvent(0), expired(0), noRoute(0) { }
+
+        unsigned long long total() const { return noEvent + expired + noRoute; }
+    };
+
+    /**
+     说明：事件句柄；
+          由状态机在事件加入时分配，64位，高32位为代数，低32位为事件表中的槽位下标；
+          事件被删除后槽位的代数递增，旧句柄随之失效，可安全地检测出过期句柄
+    */
+    class Xyh_Handle {
+    public:
+        Xyh_Handle() : m_value(0) { }
+
+        explicit Xyh_Handle(unsigned long long value) : m_value(value) { }
+
+        Xyh_Handle(unsigned int index, unsigned int generation) :
+            m_value(((unsigned long long)generation << 32) | index) { }
+
+        /**
+         描述：获取槽位下标
+        */
+        unsigned int index() const { return (unsigned int)m_value; }
+
+        /**
+         描述：获取代数；有效句柄的代数不为0
+        */
+        unsigned int generation() const { return (unsigned int)(m_value >> 32); }
+
+        /**
+         描述：获取句柄的64位数值
+        */
+        unsigned long long value() const { return m_value; }
+
+        /**
+         描述：判断句柄是否曾被分配；不代表事件仍然存在
+        */
+        bool valid() const { return generation() != 0; }
+
+        bool operator==(const Xyh_Handle& rhs) const { return m_value == rhs.m_value; }
+        bool operator!=(const Xyh_Handle& rhs) const { return m_value != rhs.m_value; }
+        bool operator<(const Xyh_Handle& rhs) const { return m_value < rhs.m_value; }
+
+    private:
+        unsigned long long m_value;
+    };
+
+    /**
+     说明：定时记录；
+          事件进入设置了定时规则的状态时，每条规则生成一条定时记录，同时挂入时间轮的槽位
+          和事件自身的定时列表；事件离开状态时，其所有定时记录被立即取消
+    */
+    struct Xyh_Timer {
+        typedef boost::intrusive::list_member_hook<
+            boost::intrusive::link_mode<boost::intrusive::auto_unlink> > Hook;
+
+        //挂入时间轮槽位的节点
+        Hook wheelHook;
+
+        //挂入事件定时列表的节点
+        Hook eventHook;
+
+        //到期时刻
+        unsigned long long deadline;
+
+        //超时调用timerRoutine时传递的信号参数
+        unsigned int label;
+
+        //所属事件
+        Xyh_Event* event;
+
+        //设置定时规则的状态
+        Xyh_Status* status;
+
+        //所属时间轮
+        Xyh_TimerWheel* wheel;
+    };
 
     /**
      说明：状态机事件；
@@ -50,9 +177,15 @@ namespace XYH_StatusMachine {
         Xyh_Event(unsigned int id, string nick) :
             m_id(id),
             m_nick(nick),
-            m_stt(STT_SURVIVE) { }
+            m_stt(STT_SURVIVE),
+            m_suspended(0),
+            m_enterTime(0),
+            m_entries(0),
+            m_enterNs(0),
+            m_machine(0),
+            m_memberOf(0) { }
 
-        virtual ~Xyh_Event() { }
+        virtual ~Xyh_Event() { detach(); }
 
         /**
          描述：处理信号
@@ -63,6 +196,15 @@ namespace XYH_StatusMachine {
         */
         void handle(unsigned int signal, const void* msg) throw (std::logic_error);
 
+        /**
+         描述：处理信号，不抛出异常；结果计入所属状态机的拒绝计数
+         参数：
+           signal：  驱动本次操作的信号
+           msg：     附加消息；将被作为参数传递给信号处理函数
+         返回值：RES_OK、RES_EXPIRED或RES_NO_ROUTE
+        */
+        Xyh_Result tryHandle(unsigned int signal, const void* msg);
+
         /**
          描述：事件加入状态机的指定状态；
               该函数仅允许在事件首次加入状态机时使用；若事件已处于有效状态，再调用该方法将抛出异常
@@ -70,8 +212,19 @@ namespace XYH_StatusMachine {
            s：       要加入的状态
            signal：  驱动本次操作的信号
            msg：     附加消息；将被做为参数传递给信号处理函数
+         说明：事件已过期或已处于有效状态时抛出std::logic_error；与process相同，信号处理函数抛出的异常原样传出
+        */
+        void place(shared_ptr<Xyh_Status> s, unsigned int signal, const void* msg);
+
+        /**
+         描述：完成转移到指定状态的记录工作（离开原状态、进入新状态、挂接定时），不执行信号处理函数；
+              供自行调用信号处理函数的状态机扩展使用
+         参数：
+           s：       本次转移的目的状态
+           signal：  驱动本次转移的信号，用于统计
+         返回值：事件已过期、未做任何转移时返回false
         */
-        void place(shared_ptr<Xyh_Status> s, unsigned int signal, const void* msg) throw (std::logic_error);
+        bool enter(shared_ptr<Xyh_Status>& s, unsigned int signal);
 
         /**
          描述：标记事件即将过期；当进入允许回收事件的状态时，事件将被标记为过期；
@@ -79,7 +232,7 @@ namespace XYH_StatusMachine {
          参数：无
          返回值：无
         */
-        void expire() { m_stt = STT_BEMARKED; }
+        void expire() { m_stt = STT_BEMARKED; touch(); }
 
         /**
          描述：标记事件为正常；若事件在此之前被标记为即将过期或已过期，
@@ -87,7 +240,7 @@ namespace XYH_StatusMachine {
          参数：无
          返回值：无
         */
-        void survive() { m_stt = STT_SURVIVE; }
+        void survive() { m_stt = STT_SURVIVE; touch(); }
 
         /**
          描述：判断事件是否已过期
@@ -103,6 +256,13 @@ namespace XYH_StatusMachine {
         */
         bool marked() { return m_stt == STT_BEMARKED; }
 
+        /**
+         描述：判断事件是否有尚未完成的异步处理函数；此时事件的信号排队等待
+         参数：无
+         返回值：有返回true，否则返回false
+        */
+        bool suspended() const { return m_suspended != 0; }
+
         /**
          描述：重载小于符号，根据id比较两个事件的大小
          参数：另一个事件
@@ -133,6 +293,27 @@ namespace XYH_StatusMachine {
         */
         shared_ptr<Xyh_Status> getCurrentStatus();
 
+        /**
+         描述：获取事件当前状态，不增加引用计数
+         参数：无
+         返回值：返回当前状态；事件未加入任何状态时返回0
+        */
+        Xyh_Status* currentStatus() { return m_curStatus.get(); }
+
+        /**
+         描述：获取事件在状态机中的句柄
+         参数：无
+         返回值：事件句柄；事件未加入状态机时返回无效句柄
+        */
+        Xyh_Handle getHandle() { return m_handle; }
+
+        /**
+         描述：获取事件所属的状态机；共享定义中的状态应通过该方法获取状态机相关的信息
+         参数：无
+         返回值：事件加入的状态机，或事件当前所在状态成员列表所属的状态机；都没有时返回0
+        */
+        Xyh_Jsm* getMachine() { return m_machine; }
+
         /**
          描述：设置事件当前状态
          参数：
@@ -146,7 +327,14 @@ namespace XYH_StatusMachine {
          参数：无
          返回值：返回事件进入当前状态的时间
         */
-        unsigned long long enterTime() { return m_enterTime; }
+        unsigned long long enterTime() { return m_enterTime / 1000; }
+
+        /**
+         描述：获取进入当前状态的时间，单位为ms
+         参数：无
+         返回值：返回事件进入当前状态的时间
+        */
+        unsigned long long enterTimeMs() const { return m_enterTime; }
 
         /**
          描述：事件运行状态枚举
@@ -159,6 +347,18 @@ namespace XYH_StatusMachine {
 
     private:
         friend class Xyh_Jsm;
+        friend class Xyh_Status;
+        friend class Xyh_EventTable;
+        friend class Xyh_EventColumns;
+        friend class Xyh_AsyncStatus;
+
+        /**
+         描述：将事件从所在状态的事件列表中摘除，并取消该状态为事件设置的所有定时；
+              不在任何状态的事件列表中时不做任何操作
+         参数：无
+         返回值：无
+        */
+        void detach();
 
         /**
          描述：将时间从当前状态转移到指定状态；转移路线必须符合状态机设定
@@ -173,10 +373,34 @@ namespace XYH_StatusMachine {
         /**
          描述：设置进入当前状态的时间
          参数：
-           t：当前时间戳
+           t：当前时间戳，单位为s
+         返回值：
+        */
+        void enterTime(unsigned long long t) { m_enterTime = t * 1000; }
+
+        /**
+         描述：设置进入当前状态的时间
+         参数：
+           t：当前时间戳，单位为ms
          返回值：
         */
-        void enterTime(unsigned long long t) { m_enterTime = t; }
+        void enterTimeMs(unsigned long long t) { m_enterTime = t; }
+
+        /**
+         描述：确定记录事件在指定状态中的成员与定时的状态机；
+              只属于一个状态机的状态使用其所属状态机，共享定义中的状态使用事件所属的状态机
+         参数：
+           s：       状态；可以为空
+         返回值：状态机；状态不在事件所属状态机的定义中时返回0
+        */
+        Xyh_Jsm* hostOf(const Xyh_Status* s) const;
+
+        /**
+         描述：所在状态、运行状态或进入时间改变后，同步所属状态机的事件列存储
+         参数：无
+         返回值：无
+        */
+        void touch();
 
     private:
         //事件Id
@@ -188,17 +412,46 @@ namespace XYH_StatusMachine {
         //event的当前状态，STT_BEMARKED或STT_RECYCLE
         unsigned char m_stt;
 
-        //进入当前状态的时间
+        //是否有尚未完成的异步处理函数
+        unsigned char m_suspended;
+
+        //进入当前状态的时间，单位为ms
         volatile long long m_enterTime;
 
+        //进入状态的次数；排队的定时只在事件仍处于同一次进入时处理
+        unsigned int m_entries;
+
+        //加入当前状态事件列表的单调时钟时刻，单位为ns；仅在启用统计时记录
+        unsigned long long m_enterNs;
+
         //当前status
         shared_ptr<Xyh_Status> m_curStatus;
+
+        //事件在状态机事件表中的句柄
+        Xyh_Handle m_handle;
+
+        //事件所属的状态机；由addEvent或事件加入状态成员列表时设置，状态机析构时清空
+        Xyh_Jsm* m_machine;
+
+        //挂入状态成员列表的侵入式节点；加入和移除均为O(1)且无需分配内存
+        boost::intrusive::list_member_hook<> m_statusHook;
+
+        //事件当前所在成员列表对应的状态，列表属于m_machine；不在任何列表中时为空
+        Xyh_Status* m_memberOf;
+
+        //当前状态为事件设置的未到期定时
+        boost::intrusive::list<Xyh_Timer,
+            boost::intrusive::member_hook<Xyh_Timer, Xyh_Timer::Hook, &Xyh_Timer::eventHook>,
+            boost::intrusive::constant_time_size<false> > m_timers;
     };
 
 
     /**
      说明：状态机状态；
-          状态机由若干个状态构成，事件可以在状态和状态之间根据预设好的路线转移
+          状态机由若干个状态构成，事件可以在状态和状态之间根据预设好的路线转移；
+          状态只保存转移路线与定时规则，状态中的事件成员由状态机记录。
+          经Xyh_Jsm::addStatus加入的状态只属于该状态机；加入Xyh_Definition的状态可由多个状态机共享，
+          此时处理函数可能被多个状态机调用，成员查询与时间须通过状态机或事件获取
     */
     class Xyh_Status : public enable_shared_from_this<Xyh_Status> {
     public:
@@ -237,7 +490,18 @@ namespace XYH_StatusMachine {
         virtual void timerRoutine(unsigned int label, shared_ptr<Xyh_Event>& e) { }
 
         /**
-         描述：根据参数以及预定的转移路线，查找下一个状态
+         描述：调用信号处理函数；状态机启用统计时记录执行耗时
+         参数：
+           e：       进入状态的事件
+           label：   驱动事件进入该状态的信号
+           msg：     附加信息
+         返回值：无
+        */
+        void invoke(shared_ptr<Xyh_Event>& e, unsigned int label, const void* msg);
+
+        /**
+         描述：根据参数以及预定的转移路线，查找下一个状态；
+              状态所属的状态机执行freeze后，将直接查询编译好的转移表
          参数：
            signal：信号
          返回值：若有符合条件的转移路线，则返回正确的状态；否则返回空指针
@@ -248,6 +512,7 @@ namespace XYH_StatusMachine {
          描述：设定以当前状态为起始点的转移路线；
               同一个状态上，一个信号只能设置一条转移路线；若使用同一个信号重复设置，
               则只有最后一次设置生效
+              状态机执行freeze后不允许再修改转移路线，否则将抛出异常
          参数：
            signal：触发信号
            status：目的状态
@@ -257,7 +522,8 @@ namespace XYH_StatusMachine {
 
         /**
          描述：设定当前状态上的自环转移路线；同一个状态上，一个信号只能设置一次转移路线，
-              若同时设置了自环和非自环转移，则只有自环转移生效
+              若同时设置了自环和非自环转移，则只有自环转移生效；
+              状态机执行freeze后不允许再修改转移路线，否则将抛出异常
          参数：
            signal：触发信号
          返回值：无
@@ -270,11 +536,20 @@ namespace XYH_StatusMachine {
               timerRoutine方法，并将label的值作为参数传递进去
          参数：
            label：   超时调用timerRoutine时传递的信号参数
-           period：  超时时长
+           period：  超时时长，单位为s
          返回值：无
         */
         void regular(unsigned int label, unsigned int period);
 
+        /**
+         描述：添加一个毫秒精度的定时事件；除超时时长的单位外与regular相同
+         参数：
+           label：   超时调用timerRoutine时传递的信号参数
+           period：  超时时长，单位为ms
+         返回值：无
+        */
+        void regularMs(unsigned int label, unsigned long long period);
+
         /**
          描述：从当前状态移除指定事件
          参数：
@@ -284,14 +559,49 @@ namespace XYH_StatusMachine {
         void removeEvent(shared_ptr<Xyh_Event>& e);
 
         /**
-         描述：向当前状态添加一个事件
+         描述：向当前状态添加一个事件；成员列表按进入时间排序，进入时间早于列表末尾的事件时向前插入；
+              状态不属于任何状态机、且事件所属状态机的定义中没有该状态时，不记录成员也不设置定时
          参数：
            e：要添加的时间
          返回值：无
         */
         void addEvent(shared_ptr<Xyh_Event>& e);
 
+        /**
+         描述：获取当前状态下的事件数量；共享定义中的状态返回0，应使用Xyh_Jsm::occupancy
+         参数：无
+         返回值：事件数量
+        */
+        size_t eventCount() const;
+
+        /**
+         描述：按进入时间从早到晚获取当前状态下最早进入的n个事件，耗时与结果数量成正比；
+              共享定义中的状态不返回事件，应使用Xyh_Jsm::oldest
+         参数：
+           n：       最多获取的事件数量
+           out：     事件追加到末尾
+         返回值：获取的事件数量
+        */
+        size_t oldest(size_t n, vector<shared_ptr<Xyh_Event> >& out);
+
+        /**
+         描述：按进入时间从早到晚获取在当前状态停留不少于ms的事件，耗时与结果数量成正比；
+              共享定义中的状态不返回事件，应使用Xyh_Jsm::olderThan
+         参数：
+           ms：      停留时长，单位为ms
+           out：     事件追加到末尾
+         返回值：获取的事件数量
+        */
+        size_t olderThan(unsigned long long ms, vector<shared_ptr<Xyh_Event> >& out);
+
     public:
+        /**
+         描述：状态成员列表类型；侵入式链表，节点位于事件对象内，列表不持有事件的引用
+        */
+        typedef boost::intrusive::list<Xyh_Event,
+            boost::intrusive::member_hook<Xyh_Event, boost::intrusive::list_member_hook<>, &Xyh_Event::m_statusHook>,
+            boost::intrusive::constant_time_size<true> > EventList;
+
         /**
          描述：事件比较类
         */
@@ -331,9 +641,16 @@ namespace XYH_StatusMachine {
         /**
          描述：获取自状态机创建起经过的时间，单位为秒
          参数：无
-         返回值：自状态机创建起经过的时间，单位为秒
+         返回值：自状态机创建起经过的时间，单位为秒；状态不属于某一个状态机时返回0
+        */
+        unsigned long long timestamp();
+
+        /**
+         描述：获取自状态机创建起经过的时间，单位为ms
+         参数：无
+         返回值：自状态机创建起经过的时间，单位为ms；状态不属于某一个状态机时返回0
         */
-        unsigned long long timestamp() { return m_ticktock; }
+        unsigned long long timestampMs();
 
         /**
          描述：判断当前状态是否允许回收事件
@@ -342,29 +659,20 @@ namespace XYH_StatusMachine {
         */
         bool fade() { return m_fade; }
 
-    private:
-
-        struct _InStore {
-            _InStore(unsigned int tabel, shared_ptr<Xyh_Event>& e) : _tabel(tabel), _event(e) { }
-
-            unsigned int _tabel;
-            shared_ptr<Xyh_Event> _event;
-        };
-
-        friend class Xyh_Jsm;
-
         /**
-         描述：时钟嘀嗒处理方法
-         参数：
-           ticktock：状态机创建开始经过的时间,单位为s
-           e：       状态机定时器错误码
-         返回值：无
+         描述：获取状态在所属定义中的下标，即加入定义的顺序，也是转移表中的行
+         参数：无
+         返回值：状态下标
         */
-        void ticktock(const unsigned long long ticktock, const boost::system::error_code& e);
+        unsigned int getIndex() { return m_index; }
 
-    protected:
-        //当前状态下的事件列表
-        list<shared_ptr<Xyh_Event> > m_listEvent;
+    private:
+        friend class Xyh_Jsm;
+        friend class Xyh_Event;
+        friend class Xyh_Dispatch;
+        friend class Xyh_Definition;
+        friend class Xyh_EventColumns;
+        friend class Xyh_AsyncStatus;
 
     private:
         //状态ID，在一个状态机中唯一
@@ -379,163 +687,2161 @@ namespace XYH_StatusMachine {
         //是否允许event在该状态被回收
         bool m_fade;
 
-        //暂存当前滴答数
-        volatile unsigned long long m_ticktock;
+        //经addStatus加入时所属的状态机；共享定义中的状态为空
+        Xyh_Jsm* m_machine;
 
-        //定时规则 <table, period>
-        list<std::pair<unsigned int, unsigned int> > m_regularEvt;
+        //所属的状态机定义；定义析构时清空
+        Xyh_Definition* m_definition;
 
-        //定时事件
-        multimap<unsigned int, shared_ptr<_InStore> > m_mapTEvent;
+        //定时规则 <table, period>，period单位为ms
+        list<std::pair<unsigned int, unsigned long long> > m_regularEvt;
 
         //转移规则 <signal, status>
         map<unsigned int, shared_ptr<Xyh_Status> > m_mapLink;
 
         //自环信号集合
         set<unsigned int> m_setSelfLink;
-    };
 
+        //编译后的转移表，由状态机freeze时设置；为空时使用m_mapLink/m_setSelfLink查找
+        Xyh_Dispatch* m_dispatch;
+
+        //状态在所属定义中的下标
+        unsigned int m_index;
+    };
 
-    typedef boost::function<void(const unsigned int)> FinishNotify;
 
     /**
-     描述：状态机
-          状态机由若干个状态以及若干状态与状态之间的转移关于则组成；
-          事件在状态与状态之间独立转移，互不影响
+     说明：状态转移表；
+          由Xyh_Jsm::freeze将所有状态的转移路线和自环路线编译成一个以(状态下标, 信号下标)
+          为索引的连续数组，查找路线只需一次数组访问；
+          状态id和信号在编译时被重新映射为连续的下标；信号取值连续时信号下标即为信号与最小
+          信号的差值，取值稀疏时使用完美哈希将信号映射到紧凑的行内位置，
+          找不到完美哈希时按有序信号表二分查找，行宽始终不超过信号数量的若干倍
     */
-    class Xyh_Jsm {
+    class Xyh_Dispatch {
     public:
         /**
-         描述：构造函数
+         描述：编译转移表
          参数：
-           id:          全局唯一的状态机id，用于区分不同的状态机
-           io_service:  boost库的io_service对象
-           fr:          结束通知
-        */
-        Xyh_Jsm(unsigned int id, boost::asio::io_service &io_servivce/*, FinishNotify fr = 0*/);
-
-        /**
-         描述：析构函数
-         参数：无
+           statuses：状态机内的所有状态，其在数组中的位置即为状态下标
          返回值：无
         */
-        virtual ~Xyh_Jsm() {};
+        explicit Xyh_Dispatch(const vector<shared_ptr<Xyh_Status> >& statuses) throw (std::logic_error);
 
-        /**
-         描述：驱动指定事件处理信号；若信号是自环信号，该方法将不触发定时事件
-         参数：
-           event:   事件id
-           signal:  信号
-           msg:     附加信息；作为参数传递给状态的信号处理方法
-         返回值：无
-        */
-        void digestion(unsigned int event, unsigned int signal, const void* msg);
+        ~Xyh_Dispatch();
 
         /**
-         描述：驱动指定事件处理信号；若信号是自环信号，该方法将在触发定时事件
+         描述：将信号映射为行内位置
          参数：
-           event:   事件id
-           signal:  信号
-           msg:     附加信息；作为参数传递给状态的信号处理方法
-         返回值：无
+           signal：信号
+         返回值：若信号出现在任何转移路线中则返回其行内位置，否则返回-1
         */
-        void process(unsigned int event, unsigned int signal, const void* msg);
+        int column(unsigned int signal) const {
+            if (m_dense) {
+                unsigned int c = signal - m_base;
+                return c < m_cols ? (int)c : -1;
+            }
+            if (m_sorted) {
+                vector<unsigned int>::const_iterator it = std::lower_bound(m_keys.begin(), m_keys.end(), signal);
+                return (it != m_keys.end() && *it == signal) ? (int)(it - m_keys.begin()) : -1;
+            }
+            unsigned int c = (unsigned int)(((unsigned long long)signal * m_mul) >> m_shift) & (m_cols - 1);
+            return m_keys[c] == signal ? (int)c : -1;
+        }
 
         /**
-         描述：处理信号；状态机内除已过期事件之外的所有事件都将收到该信号
+         描述：查找转移路线
          参数：
+           index：   当前状态下标
            signal：  信号
-           msg：     附加信息
-         返回值：无
+         返回值：若存在转移路线则返回目的状态的下标，否则返回-1
         */
-        void process(unsigned int signal, const void* msg);
+        int route(unsigned int index, unsigned int signal) const {
+            int c = column(signal);
+            return c < 0 ? -1 : m_table[index * m_cols + c];
+        }
 
         /**
-         描述：向状态机添加状态
+         描述：根据下标获取状态
          参数：
-           s：状态
-         返回值：无
+           index：状态下标
+         返回值：状态
         */
-        void addStatus(shared_ptr<Xyh_Status> s);
-        
+        const shared_ptr<Xyh_Status>& status(unsigned int index) const { return m_statuses[index]; }
+
         /**
-         描述：查找状态
-         参数：
-           id：状态id
-         返回值：若存在返回状态，否则返回空指针
+         描述：获取状态数量
+         参数：无
+         返回值：状态数量
         */
-        shared_ptr<Xyh_Status> findStatus(unsigned int id);
+        unsigned int size() const { return (unsigned int)m_statuses.size(); }
 
         /**
-         描述：添加事件
-         参数：
-           e：事件
-         返回值：无
+         描述：获取每行的信号位置数量
+         参数：无
+         返回值：信号位置数量
         */
-        void addEvent(shared_ptr<Xyh_Event> e);
-        
+        unsigned int columns() const { return m_cols; }
+
         /**
-         描述：删除事件
+         描述：获取信号位置对应的信号
          参数：
-           id：事件id
-         返回值：无
+           column：信号位置
+         返回值：信号；稀疏模式下未使用的位置返回值无意义
         */
-        void relEvent(unsigned int id);
+        unsigned int signal(unsigned int column) const { return m_dense ? m_base + column : m_keys[column]; }
+
+    private:
+        Xyh_Dispatch(const Xyh_Dispatch&);
+        Xyh_Dispatch& operator=(const Xyh_Dispatch&);
 
         /**
-         描述：标记事件即将过期
+         描述：为稀疏信号集合寻找无冲突的乘法哈希参数
          参数：
-           id：事件id
-         返回值：无
+           signals：所有出现过的信号，已去重
+         返回值：找到返回true，否则返回false
         */
-        void expireEvent(unsigned int id);
+        bool perfectHash(const vector<unsigned int>& signals);
+
+    private:
+        //所有状态，按下标排列
+        vector<shared_ptr<Xyh_Status> > m_statuses;
+
+        //转移表 [状态下标 * m_cols + 信号位置] = 目的状态下标，-1表示无转移路线
+        vector<int> m_table;
+
+        //信号是否连续；连续时信号位置为 signal - m_base
+        bool m_dense;
+
+        //连续信号的最小值
+        unsigned int m_base;
+
+        //是否按有序信号表查找；稀疏信号找不到完美哈希时使用
+        bool m_sorted;
+
+        //每行的信号位置数量；完美哈希时为2的幂
+        unsigned int m_cols;
+
+        //完美哈希乘数与移位
+        unsigned long long m_mul;
+        unsigned int m_shift;
+
+        //完美哈希下每个位置对应的信号，用于校验；有序查找时为升序排列的所有信号
+        vector<unsigned int> m_keys;
+    };
+
+
+    /**
+     说明：状态机定义；
+          保存状态、转移路线与定时规则，冻结后编译出转移表且不可再修改；
+          冻结后的定义可由任意数量的Xyh_Jsm共享，各状态机只分配自己的事件表、状态成员列表与定时，
+          不再复制状态与转移路线。共享定义中的状态不属于任何一个状态机，其处理函数可能被多个
+          状态机调用，状态机相关的信息应通过事件的getMachine获取；
+          在不同线程上运行的状态机共享同一个定义时，处理函数之间必须线程安全
+    */
+    class Xyh_Definition {
+    public:
+        Xyh_Definition();
+
+        ~Xyh_Definition();
 
         /**
-         描述：查找事件
+         描述：添加状态；状态只能加入一个定义，重复的状态id被忽略；冻结后不允许再添加状态
          参数：
-           id：事件id
-         返回值：若存在返回事件，否则返回空指针
+           s：状态
+         返回值：无
         */
-        shared_ptr<Xyh_Event> findEvent(unsigned int id);
-        
+        void addStatus(shared_ptr<Xyh_Status> s) throw (std::logic_error);
+
         /**
-         描述：结束通知
+         描述：查找状态
          参数：
-           id：
-         返回值：
+           id：状态id
+         返回值：若存在返回状态，否则返回空指针
         */
-	    //void notifyFinish(const unsigned int);
+        shared_ptr<Xyh_Status> findStatus(unsigned int id) const;
 
         /**
-         描述：停止状态机
+         描述：冻结定义，将所有状态的转移路线编译为转移表；重复调用不做任何操作
          参数：无
          返回值：无
         */
-        void stop();
+        void freeze() throw (std::logic_error);
 
-    private:
         /**
-         描述：时钟嘀嗒处理方法
-         参数：
-           e：定时器错误码
-         返回值：无
+         描述：判断定义是否已冻结
         */
-        void ticktock(const boost::system::error_code& e);
-       
+        bool frozen() const { return m_dispatch.get() != 0; }
+
+        /**
+         描述：获取状态数量
+        */
+        size_t size() const { return m_statuses.size(); }
+
     private:
-	    boost::asio::io_service& m_ioService;
+        friend class Xyh_Jsm;
+
+        Xyh_Definition(const Xyh_Definition&);
+        Xyh_Definition& operator=(const Xyh_Definition&);
+
+    private:
+        //所有状态，按下标排列
+        vector<shared_ptr<Xyh_Status> > m_statuses;
 
-        //状态机内所有状态列表 <statusId, Status>
+        //所有状态 <statusId, Status>
         map<unsigned int, shared_ptr<Xyh_Status> > m_mapStatus;
 
-        //状态机内所有事件列表 <eventId, Event>
-        map<unsigned int, shared_ptr<Xyh_Event> >  m_mapEvent;
+        //编译后的转移表，freeze之后有效
+        shared_ptr<Xyh_Dispatch> m_dispatch;
+    };
+
+
+    /**
+     说明：定长内存池；
+          按块(chunk)向系统申请内存，切分为等长的槽位并通过空闲链表复用；
+          稳态下分配和释放均不访问系统分配器；非线程安全，只能在状态机线程上使用
+    */
+    class Xyh_Pool {
+    public:
+        /**
+         描述：内存池统计信息
+        */
+        struct Stats {
+            Stats() : allocs(0), frees(0), chunks(0), capacity(0) { }
+
+            //累计分配次数
+            unsigned long long allocs;
+
+            //累计释放次数
+            unsigned long long frees;
+
+            //累计向系统申请的内存块数量；稳态下不再增长
+            unsigned long long chunks;
+
+            //槽位总数
+            unsigned long long capacity;
+
+            //正在使用的槽位数量
+            unsigned long long inUse() const { return allocs - frees; }
+        };
+
+        /**
+         描述：构造函数
+         参数：
+           size：    槽位大小，按16字节对齐
+           perChunk：每次向系统申请的槽位数量
+         返回值：无
+        */
+        explicit Xyh_Pool(size_t size, size_t perChunk = 256);
+
+        /**
+         描述：析构函数；释放所有内存块，调用者需保证此时所有槽位均已归还
+        */
+        ~Xyh_Pool();
+
+        /**
+         描述：分配一个槽位
+         参数：无
+         返回值：槽位地址
+        */
+        void* allocate() {
+            if (!m_free) {
+                grow(m_perChunk);
+            }
+            Node* n = m_free;
+            m_free = n->next;
+            m_stats.allocs++;
+            return n;
+        }
+
+        /**
+         描述：归还一个槽位
+         参数：
+           p：由allocate分配的槽位
+         返回值：无
+        */
+        void deallocate(void* p) {
+            Node* n = static_cast<Node*>(p);
+            n->next = m_free;
+            m_free = n;
+            m_stats.frees++;
+        }
+
+        /**
+         描述：预先申请内存，保证空闲槽位不少于n个
+         参数：
+           n：空闲槽位数量
+         返回值：无
+        */
+        void reserve(size_t n);
+
+        /**
+         描述：获取槽位大小
+         参数：无
+         返回值：槽位大小
+        */
+        size_t size() const { return m_size; }
+
+        /**
+         描述：获取统计信息
+         参数：无
+         返回值：统计信息
+        */
+        const Stats& stats() const { return m_stats; }
+
+    private:
+        Xyh_Pool(const Xyh_Pool&);
+        Xyh_Pool& operator=(const Xyh_Pool&);
+
+        struct Node {
+            Node* next;
+        };
+
+        /**
+         描述：向系统申请一个内存块并切分为空闲槽位
+         参数：
+           n：槽位数量
+         返回值：无
+        */
+        void grow(size_t n);
+
+    private:
+        //槽位大小
+        size_t m_size;
+
+        //每次申请的槽位数量
+        size_t m_perChunk;
+
+        //空闲链表
+        Node* m_free;
+
+        //已申请的内存块
+        vector<char*> m_chunks;
+
+        //统计信息
+        Stats m_stats;
+    };
+
+    /**
+     说明：内存池对象的删除器；析构对象并将内存归还给内存池，持有内存池的引用以保证
+          对象的生命周期可以超过创建它的状态机
+    */
+    template<class T>
+    struct Xyh_PoolDeleter {
+        explicit Xyh_PoolDeleter(const shared_ptr<Xyh_Pool>& pool) : _pool(pool) { }
+
+        void operator()(T* p) {
+            p->~T();
+            _pool->deallocate(p);
+        }
+
+        shared_ptr<Xyh_Pool> _pool;
+    };
+
+
+    /**
+     说明：分层时间轮；
+          4层，每层256个槽位，第0层每个槽位对应一个滴答(1ms)，上层槽位到期时将其中的定时记录
+          逐级下放；插入和取消均为O(1)，定时记录占用的内存只与未到期的定时数量成正比；
+          推进时跳过没有定时的区间，长时间休眠后可一次追上
+    */
+    class Xyh_TimerWheel {
+    public:
+        Xyh_TimerWheel();
+
+        /**
+         描述：析构函数；释放所有未到期的定时记录
+        */
+        ~Xyh_TimerWheel();
+
+        /**
+         描述：添加一条定时记录
+         参数：
+           deadline：到期时刻；早于当前时刻时将在下一次检查时立即到期
+           label：   超时信号参数
+           e：       所属事件
+           s：       设置定时规则的状态
+         返回值：定时记录
+        */
+        Xyh_Timer* schedule(unsigned long long deadline, unsigned int label, Xyh_Event* e, Xyh_Status* s);
+
+        /**
+         描述：取消并释放一条定时记录
+         参数：
+           t：定时记录
+         返回值：无
+        */
+        void cancel(Xyh_Timer* t);
+
+        /**
+         描述：推进时间轮到指定时刻，并取出一条已到期的定时记录；
+              取出的记录已从时间轮和事件上摘除，调用者使用完毕后应调用release释放
+         参数：
+           now：当前时刻
+         返回值：已到期的定时记录；没有到期记录时返回空指针
+        */
+        Xyh_Timer* expire(unsigned long long now);
+
+        /**
+         描述：获取时间轮下一次需要处理的时刻；不早于最早的到期时刻，
+              时间轮在此之前没有任何定时到期或需要下放
+         参数：无
+         返回值：下一次需要处理的时刻；时间轮为空时返回NEVER
+        */
+        unsigned long long nextPending() const;
+
+        /**
+         描述：释放由expire取出的定时记录
+         参数：
+           t：定时记录
+         返回值：无
+        */
+        void release(Xyh_Timer* t);
+
+        /**
+         描述：获取未到期的定时记录数量
+         参数：无
+         返回值：定时记录数量
+        */
+        size_t size() const { return m_size; }
+
+        /**
+         描述：预先为定时记录申请内存
+         参数：
+           n：定时记录数量
+         返回值：无
+        */
+        void reserve(size_t n) { m_pool.reserve(n); }
+
+        /**
+         描述：获取定时记录内存池的统计信息
+         参数：无
+         返回值：统计信息
+        */
+        const Xyh_Pool::Stats& poolStats() const { return m_pool.stats(); }
+
+        //时间轮为空时nextPending的返回值
+        static const unsigned long long NEVER = ~0ULL;
+
+    private:
+        Xyh_TimerWheel(const Xyh_TimerWheel&);
+        Xyh_TimerWheel& operator=(const Xyh_TimerWheel&);
+
+        typedef boost::intrusive::list<Xyh_Timer,
+            boost::intrusive::member_hook<Xyh_Timer, Xyh_Timer::Hook, &Xyh_Timer::wheelHook>,
+            boost::intrusive::constant_time_size<false> > Slot;
+
+        enum {
+            WHEEL_BITS   = 8,
+            WHEEL_SLOTS  = 1 << WHEEL_BITS,
+            WHEEL_MASK   = WHEEL_SLOTS - 1,
+            WHEEL_LEVELS = 4
+        };
+
+        /**
+         描述：根据到期时刻将定时记录放入对应层的槽位
+         参数：
+           t：定时记录
+         返回值：无
+        */
+        void place(Xyh_Timer* t);
+
+        /**
+         描述：将上层槽位中的定时记录重新放入时间轮
+         参数：
+           level：层号
+           index：槽位号
+         返回值：当前层槽位号为0时返回true，表示需要继续下放更上一层
+        */
+        bool cascade(unsigned int level, unsigned int index);
+
+    private:
+        //各层槽位
+        Slot m_slots[WHEEL_LEVELS][WHEEL_SLOTS];
+
+        //已到期、尚未取出的定时记录
+        Slot m_due;
+
+        //下一个尚未处理的滴答
+        unsigned long long m_next;
+
+        //未到期的定时记录数量
+        size_t m_size;
+
+        //定时记录内存池
+        Xyh_Pool m_pool;
+    };
+
+
+    /**
+     说明：状态机事件表；
+          以槽位数组(slot map)存放事件，事件通过Xyh_Handle定位，只需一次带边界检查的数组访问；
+          存活的事件另存放在连续数组中便于遍历，删除时用末尾元素填补空位；
+          外部id通过开放寻址哈希表映射到槽位
+    */
+    class Xyh_EventTable {
+    public:
+        Xyh_EventTable();
+
+        /**
+         描述：加入事件；已存在相同id的事件时，旧事件被移出事件表，其句柄失效；
+              事件已在表中时返回其原有句柄
+         参数：
+           e：事件
+         返回值：事件句柄
+        */
+        Xyh_Handle insert(const shared_ptr<Xyh_Event>& e);
+
+        /**
+         描述：移除事件，句柄随之失效
+         参数：
+           h：事件句柄
+         返回值：事件存在返回true，否则返回false
+        */
+        bool erase(Xyh_Handle h);
+
+        /**
+         描述：根据句柄查找事件
+         参数：
+           h：事件句柄
+         返回值：事件存在返回事件指针，否则返回空指针
+        */
+        Xyh_Event* get(Xyh_Handle h) const {
+            if (h.index() < m_slots.size() && m_slots[h.index()].generation == h.generation()) {
+                return m_slots[h.index()].event;
+            }
+            return 0;
+        }
+
+        /**
+         描述：根据外部id查找事件句柄
+         参数：
+           id：事件id
+         返回值：事件存在返回其句柄，否则返回无效句柄
+        */
+        Xyh_Handle find(unsigned int id) const;
+
+        /**
+         描述：预先为n个事件申请槽位与哈希表空间
+         参数：
+           n：事件数量
+         返回值：无
+        */
+        void reserve(size_t n);
+
+        /**
+         描述：获取事件数量
+        */
+        size_t size() const { return m_dense.size(); }
+
+        /**
+         描述：按连续下标访问事件，下标范围为[0, size())；删除事件会改变其余事件的下标
+        */
+        const shared_ptr<Xyh_Event>& at(size_t i) const { return m_dense[i]; }
+
+        /**
+         描述：获取连续下标处事件的句柄
+        */
+        Xyh_Handle handleAt(size_t i) const { return Xyh_Handle(m_denseSlot[i], m_slots[m_denseSlot[i]].generation); }
+
+        /**
+         描述：启用列存储；以现有事件建立，之后随事件表的增删同步
+         参数：
+           definition：  状态机定义
+         返回值：无
+        */
+        void enableColumns(const Xyh_Definition* definition);
+
+        /**
+         描述：获取列存储；未启用时为0
+        */
+        const Xyh_EventColumns* columns() const { return m_columns.get(); }
+
+        /**
+         描述：事件的状态、运行状态或进入时间改变后更新列存储；事件不在表中或未启用列存储时不做任何操作
+        */
+        void refresh(const Xyh_Event* e) {
+            if (m_columns) {
+                update(e);
+            }
+        }
+
+    private:
+        struct Slot {
+            //事件；槽位空闲时为空
+            Xyh_Event* event;
+
+            //代数；槽位被释放时递增
+            unsigned int generation;
+
+            //存活时为事件在m_dense中的下标，空闲时为下一个空闲槽位
+            unsigned int next;
+        };
+
+        struct Bucket {
+            //事件id
+            unsigned int id;
+
+            //槽位下标；EMPTY表示空桶
+            unsigned int slot;
+        };
+
+        enum { EMPTY = 0xFFFFFFFF };
+
+        /**
+         描述：计算id在哈希表中的起始桶
+        */
+        size_t bucket(unsigned int id) const {
+            return (size_t)((id * 0x9E3779B1U) >> m_shift) & (m_buckets.size() - 1);
+        }
+
+        /**
+         描述：哈希表扩容并重新插入所有id
+        */
+        void rehash(size_t capacity);
+
+        /**
+         描述：从哈希表中删除id；使用后移删除，不留墓碑
+        */
+        void unhash(unsigned int id);
+
+        /**
+         描述：以事件的当前值更新列存储
+        */
+        void update(const Xyh_Event* e);
+
+    private:
+        //槽位数组
+        vector<Slot> m_slots;
+
+        //空闲槽位链表头
+        unsigned int m_free;
+
+        //存活事件的连续数组
+        vector<shared_ptr<Xyh_Event> > m_dense;
+
+        //m_dense中每个事件对应的槽位
+        vector<unsigned int> m_denseSlot;
+
+        //开放寻址哈希表 id -> 槽位，容量为2的幂，负载不超过1/2
+        vector<Bucket> m_buckets;
+
+        //哈希移位
+        unsigned int m_shift;
+
+        //列存储，与m_dense按相同下标排列；enableColumns之后有效
+        shared_ptr<Xyh_EventColumns> m_columns;
+    };
+
+
+    /**
+     说明：状态机内存分配统计
+    */
+    struct Xyh_AllocStats {
+        //所有经由createEvent创建的事件
+        Xyh_Pool::Stats events;
+
+        //定时记录
+        Xyh_Pool::Stats timers;
+    };
+
+
+    /**
+     说明：状态机运行统计；
+          由Xyh_Jsm::enableMetrics创建，记录每个(起始状态, 信号)的转移次数、每个状态的
+          当前事件数量、进入次数、定时触发次数，以及事件在状态中的停留时间和信号处理函数
+          执行耗时的对数分桶直方图(单位ns)。计数均为原子变量，由状态机线程以relaxed方式写入，
+          任意线程可随时调用snapshot读取，无需暂停状态机
+    */
+    class Xyh_Metrics {
+    public:
+        //直方图分桶数量；第0桶为0ns，第i桶为[2^(i-1), 2^i)ns
+        static const unsigned int BUCKETS = 64;
+
+        /**
+         说明：单个状态的统计
+        */
+        struct StateStats {
+            //状态id
+            unsigned int id;
+
+            //当前事件数量
+            unsigned long long occupancy;
+
+            //加入事件列表的次数
+            unsigned long long entries;
+
+            //定时触发次数
+            unsigned long long timers;
+
+            //停留时间直方图
+            unsigned long long dwell[BUCKETS];
+
+            //信号处理函数执行耗时直方图
+            unsigned long long routine[BUCKETS];
+        };
+
+        /**
+         说明：单条转移路线的统计
+        */
+        struct TransitionStats {
+            //起始状态id
+            unsigned int from;
+
+            //目的状态id
+            unsigned int to;
+
+            //信号
+            unsigned int signal;
+
+            //转移次数
+            unsigned long long count;
+        };
+
+        /**
+         说明：某一时刻的统计快照；各计数分别读取，彼此之间不保证是同一时刻的值
+        */
+        struct Snapshot {
+            //快照时刻，单调时钟，单位为ns
+            unsigned long long at;
+
+            //所有状态，按转移表下标排列
+            vector<StateStats> states;
+
+            //发生过的转移路线
+            vector<TransitionStats> transitions;
+        };
+
+    public:
+        /**
+         描述：构造函数
+         参数：
+           dispatch：状态机冻结后的转移表
+         返回值：无
+        */
+        explicit Xyh_Metrics(shared_ptr<Xyh_Dispatch> dispatch);
+
+        /**
+         描述：获取单调时钟的当前时刻
+         参数：无
+         返回值：时刻，单位为ns
+        */
+        static unsigned long long now();
+
+        /**
+         描述：计算耗时所在的直方图分桶
+         参数：
+           ns：耗时，单位为ns
+         返回值：分桶下标
+        */
+        static unsigned int bucket(unsigned long long ns) {
+            unsigned int b = 0;
+            while (ns) {
+                ns >>= 1;
+                b++;
+            }
+            return b < BUCKETS ? b : BUCKETS - 1;
+        }
+
+        /**
+         描述：记录一次转移
+         参数：
+           from：    起始状态下标
+           signal：  信号
+         返回值：无
+        */
+        void transition(unsigned int from, unsigned int signal) {
+            int col = m_dispatch->column(signal);
+            if (col >= 0) {
+                bump(m_transitions[from * m_dispatch->columns() + col], 1);
+            }
+        }
+
+        /**
+         描述：记录事件加入状态
+         参数：
+           s：状态下标
+         返回值：无
+        */
+        void enter(unsigned int s) {
+            bump(m_states[s * STRIDE + OCCUPANCY], 1);
+            bump(m_states[s * STRIDE + ENTRIES], 1);
+        }
+
+        /**
+         描述：记录事件离开状态
+         参数：
+           s：       状态下标
+           dwell：   停留时间，单位为ns
+         返回值：无
+        */
+        void leave(unsigned int s, unsigned long long dwell) {
+            bump(m_states[s * STRIDE + OCCUPANCY], (unsigned long long)-1);
+            bump(m_states[s * STRIDE + DWELL + bucket(dwell)], 1);
+        }
+
+        /**
+         描述：记录一次定时触发
+         参数：
+           s：状态下标
+         返回值：无
+        */
+        void timer(unsigned int s) {
+            bump(m_states[s * STRIDE + TIMERS], 1);
+        }
+
+        /**
+         描述：记录一次信号处理函数执行耗时；并行广播时可能由多个线程同时调用
+         参数：
+           s：   状态下标
+           ns：  耗时，单位为ns
+         返回值：无
+        */
+        void routine(unsigned int s, unsigned long long ns) {
+            m_states[s * STRIDE + ROUTINE + bucket(ns)].fetch_add(1, boost::memory_order_relaxed);
+        }
+
+        /**
+         描述：读取统计快照；可在任意线程调用
+         参数：无
+         返回值：快照
+        */
+        Snapshot snapshot() const;
+
+    private:
+        Xyh_Metrics(const Xyh_Metrics&);
+        Xyh_Metrics& operator=(const Xyh_Metrics&);
+
+        typedef boost::atomic<unsigned long long> Counter;
+
+        //单写者计数，避免加锁的读改写指令
+        static void bump(Counter& c, unsigned long long n) {
+            c.store(c.load(boost::memory_order_relaxed) + n, boost::memory_order_relaxed);
+        }
+
+        //每个状态的计数布局
+        enum {
+            OCCUPANCY   = 0,
+            ENTRIES     = 1,
+            TIMERS      = 2,
+            DWELL       = 3,
+            ROUTINE     = DWELL + BUCKETS,
+            STRIDE      = ROUTINE + BUCKETS
+        };
+
+    private:
+        //转移表，用于确定目的状态和信号
+        shared_ptr<Xyh_Dispatch> m_dispatch;
+
+        //状态计数 [状态下标 * STRIDE + 计数位置]
+        boost::scoped_array<Counter> m_states;
+
+        //转移计数 [状态下标 * 信号位置数量 + 信号位置]
+        boost::scoped_array<Counter> m_transitions;
+    };
+
+
+    /**
+     说明：批量处理的信号记录
+    */
+    struct Xyh_Signal {
+        //事件id
+        unsigned int event;
+
+        //信号
+        unsigned int signal;
+
+        //附加信息
+        const void* msg;
+    };
+
+
+    /**
+     说明：有界无锁多生产者单消费者队列；
+          存放跨线程提交的信号记录与操作，任意线程均可入队，只有状态机线程出队；
+          每个槽位带有序号，生产者通过CAS竞争写入位置，入队和出队都不加锁也不分配内存
+    */
+    class Xyh_IngressQueue {
+    public:
+        /**
+         说明：记录类型
+        */
+        enum Kind {
+            REC_PROCESS = 0,    //按process处理的信号
+            REC_DIGEST  = 1,    //按digestion处理的信号
+            REC_CALL    = 2     //Xyh_Jsm::submitCall提交的操作；msg指向IngressCall
+        };
+
+        /**
+         描述：构造函数
+         参数：
+           capacity：队列容量，向上取整为2的幂
+         返回值：无
+        */
+        explicit Xyh_IngressQueue(size_t capacity);
+
+        ~Xyh_IngressQueue();
+
+        /**
+         描述：入队；可在任意线程调用
+         参数：
+           r：   信号记录
+           kind：记录类型，Kind
+         返回值：成功返回true，队列已满返回false
+        */
+        bool push(const Xyh_Signal& r, unsigned char kind);
+
+        /**
+         描述：出队；只能在消费者线程调用
+         参数：
+           r：   出队的信号记录
+           kind：记录类型
+         返回值：成功返回true，队列为空返回false
+        */
+        bool pop(Xyh_Signal& r, unsigned char& kind);
+
+        /**
+         描述：获取队列中的记录数量；并发入队时为近似值
+         参数：无
+         返回值：记录数量
+        */
+        size_t size() const {
+            return m_tail.load(boost::memory_order_relaxed) - m_head.load(boost::memory_order_relaxed);
+        }
+
+        /**
+         描述：获取队列容量
+         参数：无
+         返回值：队列容量
+        */
+        size_t capacity() const { return m_mask + 1; }
+
+    private:
+        Xyh_IngressQueue(const Xyh_IngressQueue&);
+        Xyh_IngressQueue& operator=(const Xyh_IngressQueue&);
+
+        struct Cell {
+            //槽位序号；等于写入位置时可写，等于写入位置+1时可读
+            boost::atomic<size_t> seq;
+
+            Xyh_Signal data;
+
+            unsigned char kind;
+        };
+
+    private:
+        //槽位数组
+        Cell* m_cells;
+
+        //容量-1
+        size_t m_mask;
+
+        //避免生产者与消费者的位置共享缓存行
+        char m_pad0[64];
+
+        //下一个写入位置，生产者共享
+        boost::atomic<size_t> m_tail;
+
+        char m_pad1[64];
+
+        //下一个读取位置，只由消费者修改
+        boost::atomic<size_t> m_head;
+    };
+
+
+    typedef boost::function<void(const unsigned int)> FinishNotify;
+
+    //从快照恢复事件时使用的事件工厂 (id, nick)
+    typedef boost::function<shared_ptr<Xyh_Event>(unsigned int, const string&)> EventFactory;
+
+    //写日志时将附加信息编码为字节 (signal, msg, bytes)；回放时以编码后字节的首地址作为附加信息
+    typedef boost::function<void(unsigned int, const void*, string&)> PayloadEncoder;
+
+    //经入口队列提交、在状态机线程上执行的操作
+    typedef boost::function<void(Xyh_Jsm&)> IngressCall;
+
+    /**
+     描述：状态机
+          状态机由若干个状态以及若干状态与状态之间的转移关于则组成；
+          事件在状态与状态之间独立转移，互不影响
+    */
+    class Xyh_Jsm {
+    public:
+        /**
+         描述：构造函数
+         参数：
+           id:          全局唯一的状态机id，用于区分不同的状态机
+           io_service:  boost库的io_service对象
+           fr:          结束通知；事件过期并被状态机回收后以事件id调用，可为空
+        */
+        Xyh_Jsm(unsigned int id, boost::asio::io_service &io_servivce, FinishNotify fr = FinishNotify());
+
+        /**
+         描述：构造使用共享定义的状态机；定义未冻结时将被冻结，之后不能再调用addStatus。
+              状态与转移表不被复制，状态机只分配自己的事件表、状态成员列表与定时
+         参数：
+           id:          全局唯一的状态机id，用于区分不同的状态机
+           io_service:  boost库的io_service对象
+           definition:  状态机定义
+           fr:          结束通知；事件过期并被状态机回收后以事件id调用，可为空
+        */
+        Xyh_Jsm(unsigned int id, boost::asio::io_service &io_servivce, shared_ptr<Xyh_Definition> definition,
+            FinishNotify fr = FinishNotify()) throw (std::logic_error);
+
+        /**
+         描述：析构函数
+         参数：无
+         返回值：无
+        */
+        virtual ~Xyh_Jsm();
+
+        /**
+         描述：驱动指定事件处理信号；若信号是自环信号，该方法将不触发定时事件
+         参数：
+           event:   事件id
+           signal:  信号
+           msg:     附加信息；作为参数传递给状态的信号处理方法
+         返回值：无
+        */
+        void digestion(unsigned int event, unsigned int signal, const void* msg);
+
+        /**
+         描述：驱动句柄指定的事件处理信号；除事件通过句柄定位外与digestion相同
+         参数：
+           event:   事件句柄
+           signal:  信号
+           msg:     附加信息；作为参数传递给状态的信号处理方法
+         返回值：无
+        */
+        void digestion(Xyh_Handle event, unsigned int signal, const void* msg);
+
+        /**
+         描述：驱动指定事件处理信号；若信号是自环信号，该方法将在触发定时事件
+         参数：
+           event:   事件id
+           signal:  信号
+           msg:     附加信息；作为参数传递给状态的信号处理方法
+         返回值：无
+        */
+        void process(unsigned int event, unsigned int signal, const void* msg);
+
+        /**
+         描述：驱动句柄指定的事件处理信号；除事件通过句柄定位外与process相同
+         参数：
+           event:   事件句柄
+           signal:  信号
+           msg:     附加信息；作为参数传递给状态的信号处理方法
+         返回值：无
+        */
+        void process(Xyh_Handle event, unsigned int signal, const void* msg);
+
+        /**
+         描述：处理信号；状态机内除已过期事件之外的所有事件都将收到该信号。
+           事件按所在状态分组，每个状态只查找一次转移；各状态的成员在处理前做快照，
+           本次处理中转移进入某状态的事件不会再次收到该信号
+         参数：
+           signal：  信号
+           msg：     附加信息
+         返回值：所在状态不能处理该信号的事件数量
+        */
+        size_t process(unsigned int signal, const void* msg);
+
+        /**
+         描述：处理信号，语义同process(signal, msg)；所有事件的状态转移先在当前线程完成，
+           之后各源状态分组的信号处理函数在线程池中并行执行，同一分组内按顺序执行，
+           全部执行完毕后返回。信号处理函数之间必须线程安全，且不能再调用本状态机
+         参数：
+           signal：  信号
+           msg：     附加信息
+           pool：    执行信号处理函数的线程池
+         返回值：所在状态不能处理该信号的事件数量
+        */
+        size_t process(unsigned int signal, const void* msg, boost::asio::thread_pool& pool);
+
+        /**
+         描述：驱动指定事件处理信号，语义同process，但不抛出异常、不分配内存；
+           未被处理的信号计入拒绝计数
+         参数：
+           event:   事件id
+           signal:  信号
+           msg:     附加信息；作为参数传递给状态的信号处理方法
+         返回值：RES_OK、RES_NO_EVENT、RES_EXPIRED或RES_NO_ROUTE
+        */
+        Xyh_Result tryProcess(unsigned int event, unsigned int signal, const void* msg);
+
+        /**
+         描述：驱动句柄指定的事件处理信号；除事件通过句柄定位外与tryProcess相同
+         参数：
+           event:   事件句柄
+           signal:  信号
+           msg:     附加信息
+         返回值：同tryProcess
+        */
+        Xyh_Result tryProcess(Xyh_Handle event, unsigned int signal, const void* msg);
+
+        /**
+         描述：驱动指定事件处理信号，语义同digestion，但不抛出异常、不分配内存；
+           未被处理的信号计入拒绝计数
+         参数：
+           event:   事件id
+           signal:  信号
+           msg:     附加信息
+         返回值：RES_OK、RES_NO_EVENT、RES_EXPIRED或RES_NO_ROUTE
+        */
+        Xyh_Result tryDigest(unsigned int event, unsigned int signal, const void* msg);
+
+        /**
+         描述：驱动句柄指定的事件处理信号；除事件通过句柄定位外与tryDigest相同
+         参数：
+           event:   事件句柄
+           signal:  信号
+           msg:     附加信息
+         返回值：同tryDigest
+        */
+        Xyh_Result tryDigest(Xyh_Handle event, unsigned int signal, const void* msg);
+
+        /**
+         描述：获取指定状态上指定信号被拒绝的次数；事件不存在时没有所在状态，
+           其计数记录在状态NO_STATUS上；冻结后不在转移表中的信号在每个状态上共用一个计数
+         参数：
+           status：  状态id或NO_STATUS
+           signal：  信号
+         返回值：拒绝计数
+        */
+        Xyh_Rejects rejects(unsigned int status, unsigned int signal) const;
+
+        /**
+         描述：获取所有被拒绝信号的累计次数
+         参数：无
+         返回值：拒绝计数
+        */
+        const Xyh_Rejects& rejects() const { return m_rejectTotal; }
+
+        //事件不存在时拒绝计数使用的状态id
+        static const unsigned int NO_STATUS = 0xFFFFFFFF;
+
+        /**
+         描述：启用运行统计；须在freeze之后、状态机开始处理信号的线程上调用，
+              重复调用返回同一个统计对象
+         参数：无
+         返回值：统计对象；可交给其他线程定期调用snapshot
+        */
+        shared_ptr<Xyh_Metrics> enableMetrics() throw (std::logic_error);
+
+        /**
+         描述：获取运行统计
+         参数：无
+         返回值：统计对象；未启用时为空
+        */
+        shared_ptr<Xyh_Metrics> metrics() const { return m_metrics; }
+
+        /**
+         描述：设置转移飞行记录器；默认记录到Xyh_Recorder::global()
+         参数：
+           recorder：    记录器；为空时停止记录
+         返回值：无
+        */
+        void setRecorder(shared_ptr<Xyh_Recorder> recorder);
+
+        /**
+         描述：获取转移飞行记录器
+         参数：无
+         返回值：记录器；停止记录时为0
+        */
+        Xyh_Recorder* recorder() const { return m_recorder; }
+
+        /**
+         描述：获取广播处理中因所在状态不能处理信号而被跳过的事件累计数量
+         参数：无
+         返回值：累计数量
+        */
+        unsigned long long broadcastMisses() const { return m_broadcastMisses; }
+
+        /**
+         描述：批量驱动事件处理信号，每条记录等同于一次process调用；
+              处理前先预取所有事件，并按事件当前所在状态分组处理以提高缓存命中；
+              同一事件的信号按其在数组中的顺序处理，不同事件之间的处理顺序不作保证；
+              无法处理的信号不抛出异常，其结果记录在results中；信号处理函数抛出的异常不被捕获
+         参数：
+           records： 信号记录数组
+           n：       记录数量
+           results： 每条记录的处理结果，与records一一对应；可以为空
+         返回值：处理成功(RES_OK)的记录数量
+        */
+        size_t processBatch(const Xyh_Signal* records, size_t n, Xyh_Result* results);
+
+        /**
+         描述：批量驱动事件处理信号，每条记录等同于一次digestion调用；其余与processBatch相同
+         参数：
+           records： 信号记录数组
+           n：       记录数量
+           results： 每条记录的处理结果，与records一一对应；可以为空
+         返回值：处理成功(RES_OK)的记录数量
+        */
+        size_t digestBatch(const Xyh_Signal* records, size_t n, Xyh_Result* results);
+
+        /**
+         描述：启用入口队列；必须在任何线程调用submit之前，于状态机线程上调用一次
+         参数：
+           capacity：    队列容量
+           highWater：   高水位；队列中的记录数量达到该值时submit返回RES_BUSY，为0时等于容量
+           batch：       状态机线程每次从队列中取出并处理的最大记录数量
+         返回值：无
+        */
+        void enableIngress(size_t capacity, size_t highWater = 0, size_t batch = 256);
+
+        /**
+         描述：从任意线程提交信号，由状态机线程按process语义批量处理；
+              同一生产者提交的同一事件的信号按提交顺序处理；msg须在信号被处理前保持有效
+         参数：
+           event:   事件id
+           signal:  信号
+           msg:     附加信息
+         返回值：入队成功返回RES_OK；队列达到高水位返回RES_BUSY，调用者应稍后重试或丢弃
+        */
+        Xyh_Result submit(unsigned int event, unsigned int signal, const void* msg);
+
+        /**
+         描述：从任意线程提交信号，由状态机线程按digestion语义批量处理；其余与submit相同
+         参数：
+           event:   事件id
+           signal:  信号
+           msg:     附加信息
+         返回值：入队成功返回RES_OK；队列达到高水位返回RES_BUSY
+        */
+        Xyh_Result submitDigestion(unsigned int event, unsigned int signal, const void* msg);
+
+        /**
+         描述：从任意线程提交一个在状态机线程上执行的操作，与submit、submitDigestion提交的信号
+              按提交顺序执行，可用于添加、删除事件等需要与信号保持先后关系的操作；
+              不受高水位限制，队列已满时等待状态机线程取走记录，因此不能在状态机线程上调用
+         参数：
+           call：    操作
+         返回值：无
+        */
+        void submitCall(IngressCall call);
+
+        /**
+         描述：获取因高水位被拒绝的提交次数
+         参数：无
+         返回值：提交次数
+        */
+        unsigned long long ingressBusy() const { return m_ingressBusy.load(boost::memory_order_relaxed); }
+
+        /**
+         描述：获取经入口队列提交、但因事件不存在或没有转移路线而未被处理的信号数量
+         参数：无
+         返回值：信号数量
+        */
+        unsigned long long ingressRejected() const { return m_ingressRejected.load(boost::memory_order_relaxed); }
+
+        //排队投递的优先级通道数量；通道0优先级最高
+        static const unsigned int LANES = 4;
+
+        /**
+         描述：设置信号排队投递时使用的优先级通道；未设置的信号使用最低优先级通道
+         参数：
+           signal：  信号
+           lane：    通道，取值范围为[0, LANES)，0的优先级最高
+         返回值：无
+        */
+        void setSignalLane(unsigned int signal, unsigned int lane) throw (std::logic_error);
+
+        /**
+         描述：设置信号是否可合并；可合并的信号对同一事件只保留一条待投递记录，
+              再次投递时在原位置以最新的附加信息替换
+         参数：
+           signal：  信号
+           coalesce：是否可合并
+         返回值：无
+        */
+        void setCoalescing(unsigned int signal, bool coalesce = true);
+
+        /**
+         描述：在状态机线程上排队投递信号，稍后由状态机线程按process语义处理；
+              高优先级通道的信号先于低优先级通道的信号处理，同一通道内按投递顺序处理；
+              msg须在信号被处理前保持有效
+         参数：
+           event:   事件id
+           signal:  信号
+           msg:     附加信息
+         返回值：新增一条记录返回true；与已排队的记录合并返回false
+        */
+        bool post(unsigned int event, unsigned int signal, const void* msg);
+
+        /**
+         描述：立即处理排队的信号，每次取优先级最高的非空通道的第一条记录
+         参数：
+           limit：   最多处理的记录数量
+         返回值：处理的记录数量
+        */
+        size_t deliver(size_t limit);
+
+        /**
+         描述：获取排队等待处理的信号数量
+         参数：无
+         返回值：信号数量
+        */
+        size_t queued() const { return m_queued; }
+
+        /**
+         描述：获取因合并而未单独处理的信号数量
+         参数：无
+         返回值：信号数量
+        */
+        unsigned long long coalesced() const { return m_coalesced; }
+
+        /**
+         描述：向状态机添加状态；状态只属于本状态机，不能再加入其他状态机或定义
+         参数：
+           s：状态
+         返回值：无
+        */
+        void addStatus(shared_ptr<Xyh_Status> s) throw (std::logic_error);
+        
+        /**
+         描述：查找状态
+         参数：
+           id：状态id
+         返回值：若存在返回状态，否则返回空指针
+        */
+        shared_ptr<Xyh_Status> findStatus(unsigned int id);
+
+        /**
+         描述：获取指定状态下的事件数量，耗时为O(1)
+         参数：
+           status：  状态id
+         返回值：事件数量
+        */
+        size_t occupancy(unsigned int status) throw (std::logic_error);
+
+        /**
+         描述：获取指定状态下最早进入的n个事件，按进入时间从早到晚排列
+         参数：
+           status：  状态id
+           n：       最多获取的事件数量
+           out：     事件追加到末尾
+         返回值：获取的事件数量
+        */
+        size_t oldest(unsigned int status, size_t n, vector<shared_ptr<Xyh_Event> >& out) throw (std::logic_error);
+
+        /**
+         描述：获取在指定状态停留不少于ms的事件，按进入时间从早到晚排列
+         参数：
+           status：  状态id
+           ms：      停留时长，单位为ms
+           out：     事件追加到末尾
+         返回值：获取的事件数量
+        */
+        size_t olderThan(unsigned int status, unsigned long long ms, vector<shared_ptr<Xyh_Event> >& out) throw (std::logic_error);
+
+        /**
+         描述：冻结状态机拓扑；将所有状态的转移路线编译为连续的转移表，此后的信号路由
+              均通过查表完成；冻结后不允许再添加状态或转移路线
+         参数：无
+         返回值：无
+        */
+        void freeze() throw (std::logic_error);
+
+        /**
+         描述：判断状态机是否已冻结
+         参数：无
+         返回值：已冻结返回true，否则返回false
+        */
+        bool frozen() { return m_dispatch.get() != 0; }
+
+        /**
+         描述：获取自状态机创建起经过的时间，单位为秒
+         参数：无
+         返回值：自状态机创建起经过的时间
+        */
+        unsigned long long timestamp() { return timestampMs() / 1000; }
+
+        /**
+         描述：获取自状态机创建起经过的时间，单位为ms；基于单调时钟，不受系统时间调整影响
+         参数：无
+         返回值：自状态机创建起经过的时间
+        */
+        unsigned long long timestampMs();
+
+        /**
+         描述：添加事件；已存在相同id的事件时将被替换，被替换事件的句柄失效
+         参数：
+           e：事件
+         返回值：事件句柄
+        */
+        Xyh_Handle addEvent(shared_ptr<Xyh_Event> e);
+        
+        /**
+         描述：删除事件
+         参数：
+           id：事件id
+         返回值：无
+        */
+        void relEvent(unsigned int id);
+
+        /**
+         描述：删除句柄指定的事件；句柄已失效时不做任何操作
+         参数：
+           h：事件句柄
+         返回值：无
+        */
+        void relEvent(Xyh_Handle h);
+
+        /**
+         描述：标记事件即将过期
+         参数：
+           id：事件id
+         返回值：无
+        */
+        void expireEvent(unsigned int id);
+
+        /**
+         描述：查找事件
+         参数：
+           id：事件id
+         返回值：若存在返回事件，否则返回空指针
+        */
+        shared_ptr<Xyh_Event> findEvent(unsigned int id);
+
+        /**
+         描述：根据句柄查找事件
+         参数：
+           h：事件句柄
+         返回值：若句柄有效返回事件，否则返回空指针
+        */
+        shared_ptr<Xyh_Event> findEvent(Xyh_Handle h);
+
+        /**
+         描述：根据事件id查找事件句柄
+         参数：
+           id：事件id
+         返回值：若存在返回事件句柄，否则返回无效句柄
+        */
+        Xyh_Handle findHandle(unsigned int id) { return m_events.find(id); }
+
+        /**
+         描述：从状态机的内存池中创建事件；事件与其它事件共用内存块，释放后内存归还内存池复用；
+              创建的事件仍需调用addEvent加入状态机；事件只能在状态机线程上释放
+         参数：
+           id：  事件id
+           nick：事件别名
+         返回值：新创建的事件
+        */
+        shared_ptr<Xyh_Event> createEvent(unsigned int id, string nick) {
+            return createEvent<Xyh_Event>(id, nick);
+        }
+
+        /**
+         描述：从状态机的内存池中创建派生事件；T须可由(id, nick)构造
+         参数：
+           id：  事件id
+           nick：事件别名
+         返回值：新创建的事件
+        */
+        template<class T>
+        shared_ptr<T> createEvent(unsigned int id, string nick) {
+            shared_ptr<Xyh_Pool> pool = eventPool(sizeof(T));
+            void* p = pool->allocate();
+            try {
+                return shared_ptr<T>(new (p) T(id, nick), Xyh_PoolDeleter<T>(pool));
+            }
+            catch (...) {
+                pool->deallocate(p);
+                throw;
+            }
+        }
+
+        /**
+         描述：从状态机的内存池中创建派生事件；T须可由(id, nick, arg)构造
+         参数：
+           id：  事件id
+           nick：事件别名
+           arg： 派生事件的附加构造参数
+         返回值：新创建的事件
+        */
+        template<class T, class A>
+        shared_ptr<T> createEvent(unsigned int id, string nick, const A& arg) {
+            shared_ptr<Xyh_Pool> pool = eventPool(sizeof(T));
+            void* p = pool->allocate();
+            try {
+                return shared_ptr<T>(new (p) T(id, nick, arg), Xyh_PoolDeleter<T>(pool));
+            }
+            catch (...) {
+                pool->deallocate(p);
+                throw;
+            }
+        }
+
+        /**
+         描述：预先为定时记录申请内存，避免流量上升时向系统分配
+         参数：
+           timers：定时记录数量
+         返回值：无
+        */
+        void reserveTimers(size_t timers) { m_wheel.reserve(timers); }
+
+        /**
+         描述：预先为事件表申请空间，避免大量加入事件时反复扩容
+         参数：
+           events：事件数量
+         返回值：无
+        */
+        void reserveEvents(size_t events) { m_events.reserve(events); }
+
+        /**
+         描述：将所有事件的id、别名、所在状态id、过期标记、进入状态时间以及未到期定时的
+              标签和到期时刻写入二进制快照文件；先写入临时文件再改名，写入失败不破坏已有快照。
+              文件按本机字节序存放，只能在相同架构上恢复
+         参数：
+           path：快照文件路径
+         返回值：无
+        */
+        void snapshot(const string& path) throw (std::logic_error);
+
+        /**
+         描述：以内存映射方式读取快照并批量重建事件表、状态成员与定时；
+              须在状态机添加完所有状态之后、加入任何事件之前调用，快照中的状态id必须都存在。
+              时钟从快照时刻继续计时，停机期间不计入进入状态时间与定时，定时剩余时长保持不变；
+              信号处理函数不会被调用
+         参数：
+           path：    快照文件路径
+           factory： 事件工厂；为空时使用createEvent创建Xyh_Event
+         返回值：恢复的事件数量
+        */
+        size_t restore(const string& path, EventFactory factory = EventFactory()) throw (std::logic_error);
+
+        //快照文件格式版本
+        static const unsigned int SNAPSHOT_VERSION = 2;
+
+        /**
+         描述：启用预写日志；之后每个顶层的addEvent、relEvent、expireEvent、place以及信号处理调用
+              在执行前追加一条记录，由信号处理函数内部发起的调用不再单独记录。
+              启用日志后写入的快照记录当时的日志序号
+         参数：
+           journal： 日志；为空时停止记录
+           encoder： 附加信息编码函数；为空时不记录附加信息
+         返回值：无
+        */
+        void enableJournal(shared_ptr<Xyh_Journal> journal, PayloadEncoder encoder = PayloadEncoder());
+
+        /**
+         描述：获取预写日志
+         参数：无
+         返回值：日志；未启用时为空
+        */
+        shared_ptr<Xyh_Journal> journal() const { return m_journal; }
+
+        /**
+         描述：按顺序重新执行日志中的记录，跳过restore所用快照已包含的记录；回放期间不写日志。
+              使用系统时钟时定时不会因日志中的时刻而触发；使用可推进的时钟(如Xyh_VirtualClock)时，
+              执行每条记录前先将时钟推进到记录时刻，期间到期的定时按原来的时刻依次触发
+         参数：
+           path：    日志文件路径
+           factory： 事件工厂；为空时使用createEvent创建Xyh_Event
+         返回值：执行的记录数量
+        */
+        size_t replay(const string& path, EventFactory factory = EventFactory()) throw (std::logic_error);
+
+        /**
+         描述：启用事件列存储；以现有事件建立，之后随事件的加入、删除与转移同步更新，
+              selectEvents与countEvents改为向量化扫描列存储。重复调用不做任何操作
+         参数：无
+         返回值：无
+        */
+        void enableEventColumns();
+
+        /**
+         描述：查找满足条件的事件；启用列存储时顺序扫描列数组，否则逐个检查事件
+         参数：
+           filter：  查询条件
+           out：     事件句柄追加到末尾，按事件表顺序排列；反复查询时可复用并预先reserve，
+                    扫描本身不分配临时内存
+         返回值：满足条件的事件数量
+        */
+        size_t selectEvents(const Xyh_EventFilter& filter, vector<Xyh_Handle>& out) throw (std::logic_error);
+
+        /**
+         描述：统计满足条件的事件数量；其余与selectEvents相同
+         参数：
+           filter：  查询条件
+         返回值：满足条件的事件数量
+        */
+        size_t countEvents(const Xyh_EventFilter& filter) throw (std::logic_error);
+
+        /**
+         描述：获取内存分配统计；稳态下各内存池的chunks不再增长
+         参数：无
+         返回值：统计信息
+        */
+        Xyh_AllocStats allocStats();
+
+        /**
+         描述：回收已过期(STT_RECYCLE)的事件，将其移出事件表并发出结束通知；
+              事件过期时状态机会在自身线程上按setReclaimSlice分批自动回收，通常无需直接调用
+         参数：
+           limit：   本次最多回收的事件数量
+         返回值：本次回收的事件数量
+        */
+        size_t reclaim(size_t limit);
+
+        /**
+         描述：设置自动回收时每批最多回收的事件数量，默认为256
+         参数：
+           n：       每批回收的事件数量，至少为1
+         返回值：无
+        */
+        void setReclaimSlice(size_t n) { m_reclaimSlice = n ? n : 1; }
+
+        /**
+         描述：获取等待回收的事件数量
+         参数：无
+         返回值：数量
+        */
+        size_t pendingReclaims() const { return m_reclaim.size(); }
+
+        /**
+         描述：改为由共享定时中心唤醒；状态机不再使用自己的定时器，只在有定时到期时被定时中心唤醒。
+              定时中心必须与状态机使用同一个io_service
+         参数：
+           hub：     定时中心；为空时恢复使用自己的定时器
+         返回值：无
+        */
+        void useTimerHub(shared_ptr<Xyh_TimerHub> hub) throw (std::logic_error);
+
+        /**
+         描述：改用指定的时钟取得当前时刻并由其唤醒；已经过的时间保持不变，之后按新时钟计时。
+              与共享定时中心不能同时使用
+         参数：
+           clock：   时钟，如Xyh_VirtualClock；为空时恢复使用系统时钟与自己的定时器
+         返回值：无
+        */
+        void useClock(shared_ptr<Xyh_Clock> clock) throw (std::logic_error);
+
+        /**
+         描述：获取时钟
+         参数：无
+         返回值：时钟；使用系统时钟时为空
+        */
+        shared_ptr<Xyh_Clock> clock() const { return m_clock; }
+
+        /**
+         描述：停止状态机
+         参数：无
+         返回值：无
+        */
+        void stop();
+
+    protected:
+        /**
+         描述：通过句柄获取事件，不增加引用计数
+         参数：
+           h：事件句柄
+         返回值：事件；句柄失效时返回0
+        */
+        Xyh_Event* eventOf(Xyh_Handle h) const { return m_events.get(h); }
+
+        /**
+         描述：获取状态的成员列表；状态必须在本状态机的定义中
+         参数：
+           s：       状态
+         返回值：成员列表，按进入时间从早到晚排列
+        */
+        Xyh_Status::EventList& members(const Xyh_Status* s) { return m_members[s->m_index]; }
+
+        /**
+         描述：获取运行统计，不增加引用计数
+         参数：无
+         返回值：统计对象；未启用时为0
+        */
+        Xyh_Metrics* liveMetrics() const { return m_metrics.get(); }
+
+        /**
+         描述：启用日志且不在其他记录的执行过程中时追加一条日志记录
+         参数：
+           type：    记录类型，Xyh_Journal::Type
+           event：   事件id
+           signal：  信号
+           status：  状态id
+           msg：     附加信息
+         返回值：无
+        */
+        void journal(unsigned char type, unsigned int event, unsigned int signal, unsigned int status, const void* msg) {
+            if (m_journal && !m_journalDepth) {
+                journalAppend(type, event, signal, status, msg);
+            }
+        }
+
+        /**
+         描述：启用飞行记录器时追加一条转移记录
+         参数：
+           kind：    记录类型，Xyh_Recorder::Kind
+           event：   事件id
+           from：    起始状态id
+           to：      目标状态id
+           signal：  信号或定时标签
+           tick：    状态机时刻，单位为ms
+         返回值：无
+        */
+        void trace(unsigned char kind, unsigned int event, unsigned int from, unsigned int to, unsigned int signal,
+            unsigned long long tick) {
+            if (m_recorder) {
+                m_recorder->record(kind, tick, m_id, event, from, to, signal);
+            }
+        }
+
+        /**
+         说明：标记正在执行一条顶层记录，期间发起的调用不再写日志
+        */
+        struct _JournalScope {
+            explicit _JournalScope(Xyh_Jsm* jsm) : m_jsm(jsm) { if (m_jsm) { m_jsm->m_journalDepth++; } }
+            ~_JournalScope() { if (m_jsm) { m_jsm->m_journalDepth--; } }
+
+            Xyh_Jsm* m_jsm;
+        };
+
+        /**
+         说明：标记正在执行定时处理函数，期间写入的日志记录带有Xyh_Journal::REC_TIMER标志
+        */
+        struct _TimerScope {
+            explicit _TimerScope(Xyh_Jsm* jsm) : m_jsm(jsm) { m_jsm->m_timerDepth++; }
+            ~_TimerScope() { m_jsm->m_timerDepth--; }
+
+            Xyh_Jsm* m_jsm;
+        };
+
+        /**
+         描述：记录一次被拒绝的信号
+         参数：
+           r：       处理结果
+           status：  事件所在状态；事件不存在时为0
+           signal：  信号
+           n：       次数
+         返回值：无
+        */
+        void reject(Xyh_Result r, const Xyh_Status* status, unsigned int signal, unsigned long long n = 1);
+
+        /**
+         描述：将信号或到期定时加入事件的等待队列
+         参数：
+           e：       异步处理函数挂起中的事件
+           sig：     信号或定时标签
+           msg：     附加信息
+           self：    是否按digestion处理
+           timer：   到期定时所属的状态；信号时为空
+         返回值：无
+        */
+        void defer(Xyh_Event& e, unsigned int sig, const void* msg, bool self, Xyh_Status* timer);
+
+        /**
+         描述：结束通知；事件被回收后调用，默认调用构造时传入的通知函数
+         参数：
+           id：      被回收的事件id
+         返回值：无
+        */
+        virtual void notifyFinish(const unsigned int id);
+
+    private:
+        /**
+         描述：冻结时按转移表分配拒绝计数表
+         参数：无
+         返回值：无
+        */
+        void allocRejects();
+
+        /**
+         描述：查找状态
+         参数：
+           id：      状态id
+         返回值：状态；不存在时抛出异常
+        */
+        Xyh_Status* statusOrThrow(unsigned int id) const throw (std::logic_error);
+
+        /**
+         描述：事件过期后加入待回收队列，并在需要时安排一次分批回收
+         参数：
+           e：       过期的事件
+         返回值：无
+        */
+        void recycle(Xyh_Event* e);
+
+        /**
+         描述：分批回收定时器的回调；仍有待回收事件时再次安排
+         参数：
+           e：       错误码
+         返回值：无
+        */
+        void reclaimSlice(const boost::system::error_code& e);
+
+        /**
+         描述：编码附加信息并追加日志记录
+         参数：同journal
+         返回值：无
+        */
+        void journalAppend(unsigned char type, unsigned int event, unsigned int signal, unsigned int status, const void* msg);
+
+        friend class Xyh_Event;
+        friend class Xyh_Status;
+        friend class Xyh_AsyncStatus;
+        friend class Xyh_TimerHub;
+        friend class Xyh_Clock;
+
+        /**
+         说明：异步处理函数挂起期间排队的信号或定时
+        */
+        struct _Deferred {
+            //信号；定时为定时标签
+            unsigned int signal;
+
+            //附加信息
+            const void* msg;
+
+            //是否按digestion处理
+            bool self;
+
+            //到期定时所属的状态；信号时为空
+            Xyh_Status* timer;
+
+            //定时到期时事件进入状态的次数
+            unsigned int entry;
+        };
+
+        /**
+         描述：事件的异步处理函数完成后，按顺序处理其等待队列，直到队列为空或事件再次挂起
+         参数：
+           e：       事件
+         返回值：无
+        */
+        void resume(shared_ptr<Xyh_Event> e);
+
+        /**
+         描述：时钟嘀嗒处理方法；处理所有已到期的定时，并将定时器设置到下一个到期时刻
+         参数：
+           e：定时器错误码
+         返回值：无
+        */
+        void ticktock(const boost::system::error_code& e);
+
+        /**
+         描述：处理所有已到期的定时，并设置下一次唤醒
+         参数：无
+         返回值：无
+        */
+        void tick();
+
+        /**
+         描述：根据时间轮的下一个到期时刻设置定时器；时间轮为空时不设置定时器
+         参数：无
+         返回值：无
+        */
+        void arm();
+
+        /**
+         描述：获取时钟的当前时刻
+         参数：无
+         返回值：当前时刻
+        */
+        boost::asio::steady_timer::time_point clockNow();
+
+        /**
+         描述：新增定时记录后调用；到期时刻早于定时器当前的到期时刻时重新设置定时器
+         参数：
+           deadline：新增定时的到期时刻，单位为ms
+         返回值：无
+        */
+        void armBefore(unsigned long long deadline);
+
+        /**
+         描述：获取指定大小事件使用的内存池，不存在时创建
+         参数：
+           size：事件对象大小
+         返回值：内存池
+        */
+        shared_ptr<Xyh_Pool> eventPool(size_t size);
+
+        /**
+         描述：将tryProcess、tryDigest的失败结果转换为异常；RES_OK与RES_EXPIRED不抛出
+         参数：
+           r：       处理结果
+           event：   事件句柄
+           signal：  信号
+         返回值：无
+        */
+        void raise(Xyh_Result r, Xyh_Handle event, unsigned int signal) const;
+
+        /**
+         描述：驱动事件处理信号，不抛出异常
+         参数：
+           event：   事件
+           signal：  信号
+           msg：     附加信息
+           self：    自环信号是否只执行信号处理函数而不重新进入状态
+         返回值：处理结果
+        */
+        Xyh_Result tryDispatch(Xyh_Event& event, unsigned int signal, const void* msg, bool self);
+
+        /**
+         描述：查询事件的公共实现
+         参数：
+           filter：  查询条件
+           out：     事件句柄追加到末尾；为0时只计数
+         返回值：满足条件的事件数量
+        */
+        size_t scanEvents(const Xyh_EventFilter& filter, vector<Xyh_Handle>* out) throw (std::logic_error);
+
+        /**
+         描述：批量处理的公共实现
+         参数：
+           records： 信号记录数组
+           n：       记录数量
+           results： 每条记录的处理结果
+           self：    自环信号是否只执行信号处理函数而不重新进入状态
+         返回值：处理成功的记录数量
+        */
+        size_t batch(const Xyh_Signal* records, size_t n, Xyh_Result* results, bool self);
+
+        /**
+         描述：广播处理的公共实现
+         参数：
+           signal：  信号
+           msg：     附加信息
+           pool：    执行信号处理函数的线程池；为0时在当前线程逐个执行
+         返回值：所在状态不能处理该信号的事件数量
+        */
+        size_t broadcast(unsigned int signal, const void* msg, boost::asio::thread_pool* pool);
+
+        /**
+         描述：提交信号到入口队列的公共实现
+         参数：
+           r：   信号记录
+           kind：Xyh_IngressQueue::REC_PROCESS或REC_DIGEST
+         返回值：RES_OK或RES_BUSY
+        */
+        Xyh_Result enqueue(const Xyh_Signal& r, unsigned char kind);
+
+        /**
+         描述：记录入队后调用；队列从空闲变为待处理时投递drain
+         参数：无
+         返回值：无
+        */
+        void wakeIngress();
+
+        /**
+         说明：排队投递的信号记录
+        */
+        struct _Queued {
+            unsigned int event;
+            unsigned int signal;
+            const void* msg;
+
+            //是否登记在合并表中
+            bool coalescing;
+        };
+
+        /**
+         描述：在状态机线程上处理一批排队的信号；仍有记录时再次投递自身
+         参数：无
+         返回值：无
+        */
+        void deliverSlice();
+
+        /**
+         描述：在状态机线程上从入口队列取出一批记录，按入队顺序处理信号与执行操作；
+              队列中仍有记录时再次投递自身
+         参数：无
+         返回值：无
+        */
+        void drain();
+
+        /**
+         描述：批量处理一段连续的、处理方式相同的入口记录并统计被拒绝的数量
+         参数：
+           records： 信号记录数组
+           n：       记录数量
+           self：    是否按digestion处理
+         返回值：无
+        */
+        void drainRun(const Xyh_Signal* records, size_t n, bool self);
+
+        /**
+         描述：批量处理时每条记录的排序项
+        */
+        struct _BatchItem {
+            //事件所在状态，用于分组
+            const void* status;
+
+            //事件句柄
+            Xyh_Handle handle;
+
+            //记录在数组中的位置
+            size_t pos;
+
+            bool operator<(const _BatchItem& rhs) const {
+                if (status != rhs.status) { return status < rhs.status; }
+                if (handle != rhs.handle) { return handle < rhs.handle; }
+                return pos < rhs.pos;
+            }
+        };
+
+        /**
+         描述：广播处理时一个源状态的成员快照
+        */
+        struct _BroadcastGroup {
+            //源状态
+            Xyh_Status* from;
+
+            //目的状态
+            shared_ptr<Xyh_Status> to;
+
+            //成员在快照数组中的范围[begin, end)
+            size_t begin;
+            size_t end;
+        };
+       
+    private:
+	    boost::asio::io_service& m_ioService;
+
+        //状态机定义；addStatus构造的状态机独占，否则由多个状态机共享
+        shared_ptr<Xyh_Definition> m_definition;
+
+        //各状态的成员列表，按状态下标排列；deque扩展时不移动已有的列表
+        std::deque<Xyh_Status::EventList> m_members;
+
+        //状态机内所有事件
+        Xyh_EventTable m_events;
+
+        //定时器；按绝对时刻设置，只在有定时到期时唤醒
+        boost::asio::steady_timer m_timer;
+
+        //状态机创建时刻，所有时间均为相对于该时刻经过的ms数
+        boost::asio::steady_timer::time_point m_epoch;
+
+        //定时器当前的到期时刻；未设置时为Xyh_TimerWheel::NEVER
+        unsigned long long m_armed;
+
+        //状态机是否已停止；停止后不再设置定时器
+        bool m_stopped;
+
+        //共享定时中心及在其中的登记位置；为空时使用m_timer
+        shared_ptr<Xyh_TimerHub> m_hub;
+        unsigned int m_hubSlot;
+
+        //时钟及在其中的登记位置；为空时使用系统时钟与m_timer
+        shared_ptr<Xyh_Clock> m_clock;
+        unsigned int m_clockSlot;
+
+        //结束通知
+        FinishNotify m_finishNotify;
+
+        //待回收事件的句柄；事件被重新加入或已释放时句柄失效，回收时跳过
+        std::deque<Xyh_Handle> m_reclaim;
+
+        //每批最多回收的事件数量
+        size_t m_reclaimSlice;
+
+        //分批回收使用的定时器，到期时刻为安排时的当前时刻，使回收排在已就绪的处理之后
+        boost::asio::steady_timer m_reclaimTimer;
+
+        //是否已安排回收
+        bool m_reclaimPending;
+
+        //异步处理函数挂起中的事件的等待队列；附加信息必须保持有效直到被处理
+        map<Xyh_Event*, std::deque<_Deferred> > m_deferred;
+
+        //所有状态共享的定时时间轮
+        Xyh_TimerWheel m_wheel;
+
+        //事件内存池 <槽位大小, 内存池>
+        map<size_t, shared_ptr<Xyh_Pool> > m_eventPools;
+
+        //批量处理的排序缓冲区；处理期间被取走，嵌套调用时使用各自的缓冲区
+        vector<_BatchItem> m_batch;
+
+        //广播处理的分组与成员快照缓冲区；处理期间被取走
+        vector<_BroadcastGroup> m_broadcastGroups;
+        vector<Xyh_Handle> m_broadcastHandles;
+
+        //广播处理中被跳过的事件累计数量
+        unsigned long long m_broadcastMisses;
+
+        //拒绝计数；freeze时分配，按[状态下标][信号列]存放，最后一行为NO_STATUS，
+        //每行最后一列为不在转移表中的信号共用的计数
+        vector<Xyh_Rejects> m_rejectTable;
+
+        //未冻结时的拒绝计数 <<状态id, 信号>, 计数>
+        map<pair<unsigned int, unsigned int>, Xyh_Rejects> m_rejectMap;
+
+        //拒绝计数合计
+        Xyh_Rejects m_rejectTotal;
+
+        //运行统计，enableMetrics之后有效
+        shared_ptr<Xyh_Metrics> m_metrics;
+
+        //状态机id
+        unsigned int m_id;
+
+        //飞行记录器；m_recorderOwner持有通过setRecorder设置的记录器
+        Xyh_Recorder* m_recorder;
+        shared_ptr<Xyh_Recorder> m_recorderOwner;
+
+        //预写日志与附加信息编码函数
+        shared_ptr<Xyh_Journal> m_journal;
+        PayloadEncoder m_journalEncoder;
+
+        //正在执行的顶层记录嵌套深度
+        unsigned int m_journalDepth;
+
+        //正在执行的定时处理函数嵌套深度
+        unsigned int m_timerDepth;
+
+        //附加信息编码缓冲区
+        string m_journalPayload;
+
+        //restore所用快照包含的最后一条日志序号
+        unsigned long long m_snapshotSeq;
+
+        //跨线程入口队列，enableIngress之后有效
+        shared_ptr<Xyh_IngressQueue> m_ingress;
+
+        //入口队列高水位
+        size_t m_ingressHighWater;
+
+        //每次处理的最大记录数量
+        size_t m_ingressBatch;
+
+        //是否已投递drain且尚未开始执行
+        boost::atomic<bool> m_drainPending;
+
+        //因高水位被拒绝的提交次数
+        boost::atomic<unsigned long long> m_ingressBusy;
+
+        //未被处理的入口记录数量
+        boost::atomic<unsigned long long> m_ingressRejected;
+
+        //drain使用的记录与结果缓冲区
+        vector<Xyh_Signal> m_drainRecords;
+        vector<Xyh_Result> m_drainResults;
+
+        //信号的投递属性 <信号, 通道 | SIGNAL_COALESCE>
+        map<unsigned int, unsigned char> m_signalClass;
+
+        //各优先级通道中排队的信号；deque在两端增删时不移动其余元素，合并表可直接指向记录
+        std::deque<_Queued> m_lanes[LANES];
+
+        //可合并信号的待投递记录 <<事件id, 信号>, 记录>
+        map<pair<unsigned int, unsigned int>, _Queued*> m_coalescing;
+
+        //排队的信号数量
+        size_t m_queued;
+
+        //因合并而未单独处理的信号数量
+        unsigned long long m_coalesced;
 
-        //定时器
-        deadline_timer m_timer;
+        //是否已投递deliverSlice且尚未执行
+        bool m_deliverPending;
 
-        //时钟滴答数
-        volatile unsigned long long m_ticktock;
+        //编译后的转移表，freeze之后有效
+        shared_ptr<Xyh_Dispatch> m_dispatch;
     };
 
 } //namespace XYH_StatusMachine
@@ -0,0 +1,73 @@
+﻿//local
+#include "fsm_async.h"
+//boost
+#include "boost/bind.hpp"
+
+namespace XYH_StatusMachine {
+
+    namespace {
+        /**
+         描述：协程的完成处理器；协程结束时不需要额外处理
+        */
+        void detached() { }
+    }
+
+    Xyh_AsyncStatus::Xyh_AsyncStatus(unsigned int id, string name, bool fade, size_t stack) :
+        Xyh_Status(id, name, fade),
+        m_stack(stack) {
+    }
+
+    void Xyh_AsyncStatus::routine(shared_ptr<Xyh_Event>& e, unsigned int label, const void* msg) {
+        spawn(e, label, msg, false);
+    }
+
+    void Xyh_AsyncStatus::timerRoutine(unsigned int label, shared_ptr<Xyh_Event>& e) {
+        spawn(e, label, 0, true);
+    }
+
+    void Xyh_AsyncStatus::spawn(shared_ptr<Xyh_Event>& e, unsigned int label, const void* msg, bool timer) {
+        Xyh_Jsm* machine = e->hostOf(this);
+        if (!machine) {
+            throw std::logic_error("async status has not been added to a status machine");
+        }
+
+        //在状态机线程中调用时协程立即开始执行，否则投递到状态机线程
+        e->m_suspended = 1;
+        boost::asio::spawn(boost::asio::bind_executor(machine->m_ioService.get_executor(), &detached),
+            boost::bind(&Xyh_AsyncStatus::run, this, e, label, msg, timer, _1),
+            boost::coroutines::attributes(m_stack));
+    }
+
+    void Xyh_AsyncStatus::run(shared_ptr<Xyh_Event> e, unsigned int label, const void* msg, bool timer,
+        boost::asio::yield_context yield) {
+        //协程挂起期间保持状态的引用
+        shared_ptr<Xyh_Status> self = shared_from_this();
+        try {
+            if (timer) {
+                asyncTimerRoutine(label, e, yield);
+            }
+            else {
+                asyncRoutine(e, label, msg, yield);
+            }
+        }
+        catch (...) {
+            finish(e);
+            throw;
+        }
+        finish(e);
+    }
+
+    void Xyh_AsyncStatus::finish(shared_ptr<Xyh_Event>& e) {
+        //状态机已析构
+        Xyh_Jsm* machine = e->hostOf(this);
+        if (!machine) {
+            e->m_suspended = 0;
+            return;
+        }
+
+        //恢复操作投递到状态机线程执行，避免在协程栈上处理排队的信号；
+        //在此之前事件保持挂起，新到达的信号继续排队以保证顺序
+        machine->m_ioService.post(boost::bind(&Xyh_Jsm::resume, machine, e));
+    }
+
+} //namespace XYH_StatusMachine
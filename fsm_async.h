@@ -0,0 +1,98 @@
+﻿#pragma once
+//local
+#include "fsm.h"
+//boost
+#include <boost/asio/spawn.hpp>
+
+namespace XYH_StatusMachine {
+
+    /**
+     说明：异步状态；
+          信号处理函数和超时处理函数在协程(boost::asio::spawn)中执行，可以通过yield等待
+          asio的异步操作而不阻塞状态机线程；在状态机线程中驱动时协程立即开始执行直到第一次挂起，
+          在其他线程中驱动时协程被投递到状态机线程执行；
+          从事件进入状态到处理函数完成，状态机继续处理其他事件，同一事件的信号和到期定时
+          按到达顺序排队，处理函数完成后在状态机线程上依次处理；
+          附加信息只在第一次挂起之前有效，需要在挂起后使用时应先复制，
+          在状态机线程之外驱动时附加信息必须保持有效直到处理函数开始执行；
+          协程必须由运行状态机的io_service驱动，不适用于使用线程池的并行广播
+    */
+    class Xyh_AsyncStatus : public Xyh_Status {
+    public:
+        /**
+         描述：构造函数
+         参数：
+           id：      状态id
+           name：    状态别名
+           fade：    是否允许事件在该状态被回收
+           stack：   协程栈大小，单位为字节
+         返回值：无
+        */
+        Xyh_AsyncStatus(unsigned int id, string name, bool fade = false, size_t stack = 64 * 1024);
+
+        /**
+         描述：在协程中执行asyncRoutine
+        */
+        virtual void routine(shared_ptr<Xyh_Event>& e, unsigned int label, const void* msg);
+
+        /**
+         描述：在协程中执行asyncTimerRoutine
+        */
+        virtual void timerRoutine(unsigned int label, shared_ptr<Xyh_Event>& e);
+
+    protected:
+        /**
+         描述：异步信号处理函数；派生类应该重写该方法
+         参数：
+           e：       进入状态的事件
+           label：   驱动事件进入该状态的信号
+           msg：     附加信息；只在第一次挂起之前有效
+           yield：   协程上下文，作为asio异步操作的完成处理器
+         返回值：无
+        */
+        virtual void asyncRoutine(shared_ptr<Xyh_Event>& e, unsigned int label, const void* msg,
+            boost::asio::yield_context yield) { }
+
+        /**
+         描述：异步超时处理函数；派生类应该重写该方法
+         参数：
+           label：   触发超时的信号
+           e：       事件
+           yield：   协程上下文
+         返回值：无
+        */
+        virtual void asyncTimerRoutine(unsigned int label, shared_ptr<Xyh_Event>& e,
+            boost::asio::yield_context yield) { }
+
+    private:
+        /**
+         描述：标记事件挂起并启动协程
+         参数：
+           e：       事件
+           label：   信号或定时标签
+           msg：     附加信息
+           timer：   是否执行超时处理函数
+         返回值：无
+        */
+        void spawn(shared_ptr<Xyh_Event>& e, unsigned int label, const void* msg, bool timer);
+
+        /**
+         描述：协程入口；处理函数结束后在状态机线程上恢复事件的信号处理
+        */
+        void run(shared_ptr<Xyh_Event> e, unsigned int label, const void* msg, bool timer,
+            boost::asio::yield_context yield);
+
+        /**
+         描述：事件的处理函数已结束，投递恢复操作
+         参数：
+           e：       事件
+         返回值：无
+        */
+        void finish(shared_ptr<Xyh_Event>& e);
+
+    private:
+        //协程栈大小
+        size_t m_stack;
+    };
+
+} //namespace XYH_StatusMachine
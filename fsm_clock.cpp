@@ -0,0 +1,81 @@
+﻿//local
+#include "fsm_clock.h"
+
+namespace XYH_StatusMachine {
+
+    Xyh_VirtualClock::Xyh_VirtualClock(TimePoint start) :
+        m_now(start),
+        m_free(EMPTY),
+        m_live(0),
+        m_wakeups(0) {
+    }
+
+    bool Xyh_VirtualClock::advanceTo(TimePoint when) {
+        //状态机处理定时时可能设置更早的唤醒，每次只取出最早的一个
+        while (!m_due.empty() && !(when < m_due.begin()->first)) {
+            pair<TimePoint, unsigned int> top = *m_due.begin();
+            m_due.erase(m_due.begin());
+            m_slots[top.second].scheduled = false;
+
+            if (m_now < top.first) {
+                m_now = top.first;
+            }
+            m_wakeups++;
+            wake(m_slots[top.second].machine);
+        }
+
+        if (m_now < when) {
+            m_now = when;
+        }
+        return true;
+    }
+
+    bool Xyh_VirtualClock::next(TimePoint& when) const {
+        if (m_due.empty()) {
+            return false;
+        }
+        when = m_due.begin()->first;
+        return true;
+    }
+
+    unsigned int Xyh_VirtualClock::attach(Xyh_Jsm* machine) {
+        if (m_free == EMPTY) {
+            Slot s = { 0, false, TimePoint(), EMPTY };
+            m_free = (unsigned int)m_slots.size();
+            m_slots.push_back(s);
+        }
+
+        unsigned int slot = m_free;
+        m_free = m_slots[slot].next;
+        m_slots[slot].machine = machine;
+        m_slots[slot].next = EMPTY;
+        m_live++;
+        return slot;
+    }
+
+    void Xyh_VirtualClock::detach(unsigned int slot) {
+        cancel(slot);
+        m_slots[slot].machine = 0;
+        m_slots[slot].next = m_free;
+        m_free = slot;
+        m_live--;
+    }
+
+    void Xyh_VirtualClock::schedule(unsigned int slot, TimePoint when) {
+        cancel(slot);
+
+        Slot& s = m_slots[slot];
+        s.scheduled = true;
+        s.when = when;
+        m_due.insert(std::make_pair(when, slot));
+    }
+
+    void Xyh_VirtualClock::cancel(unsigned int slot) {
+        Slot& s = m_slots[slot];
+        if (s.scheduled) {
+            s.scheduled = false;
+            m_due.erase(std::make_pair(s.when, slot));
+        }
+    }
+
+} //namespace XYH_StatusMachine
@@ -0,0 +1,154 @@
+﻿#pragma once
+//local
+#include "fsm.h"
+
+namespace XYH_StatusMachine {
+
+    /**
+     说明：状态机时钟；
+          提供状态机的当前时刻并负责在定时到期时唤醒状态机。状态机默认使用系统steady_clock
+          和自己的定时器，通过Xyh_Jsm::useClock改用其他时钟
+    */
+    class Xyh_Clock {
+    public:
+        typedef boost::asio::steady_timer::time_point TimePoint;
+
+        virtual ~Xyh_Clock() { }
+
+        /**
+         描述：获取当前时刻
+        */
+        virtual TimePoint now() = 0;
+
+        /**
+         描述：将时钟推进到指定时刻，依次唤醒期间到期的状态机；只有由调用者驱动的时钟支持
+         参数：
+           when：    目标时刻；早于当前时刻时不做任何处理
+         返回值：是否支持推进
+        */
+        virtual bool advanceTo(TimePoint when) { return false; }
+
+    protected:
+        friend class Xyh_Jsm;
+
+        /**
+         描述：登记状态机
+         参数：
+           machine： 状态机
+         返回值：登记位置，用于之后的schedule、cancel和detach
+        */
+        virtual unsigned int attach(Xyh_Jsm* machine) = 0;
+
+        /**
+         描述：注销状态机，其未到期的唤醒随之失效
+        */
+        virtual void detach(unsigned int slot) = 0;
+
+        /**
+         描述：设置状态机的下一次唤醒时刻，替换之前设置的唤醒
+        */
+        virtual void schedule(unsigned int slot, TimePoint when) = 0;
+
+        /**
+         描述：取消状态机的唤醒
+        */
+        virtual void cancel(unsigned int slot) = 0;
+
+        /**
+         描述：唤醒状态机，处理所有已到期的定时
+        */
+        static void wake(Xyh_Jsm* machine) { machine->tick(); }
+    };
+
+    /**
+     说明：虚拟时钟；
+          时刻只在调用advance/advanceTo时前进，推进时按到期先后唤醒登记的状态机，
+          唤醒前时钟停在该唤醒时刻，因此定时处理函数看到的时刻与实时运行时一致。
+          配合Xyh_Jsm::replay可以不等待真实时间地回放日志；
+          登记的状态机必须在调用推进的线程上运行
+    */
+    class Xyh_VirtualClock : public Xyh_Clock {
+    public:
+        /**
+         描述：构造函数
+         参数：
+           start：   起始时刻
+         返回值：无
+        */
+        explicit Xyh_VirtualClock(TimePoint start = TimePoint());
+
+        virtual TimePoint now() { return m_now; }
+
+        virtual bool advanceTo(TimePoint when);
+
+        /**
+         描述：将时钟推进ms毫秒
+        */
+        void advance(unsigned long long ms) { advanceTo(m_now + boost::asio::chrono::milliseconds(ms)); }
+
+        /**
+         描述：获取最早的唤醒时刻
+         参数：
+           when：    返回唤醒时刻
+         返回值：没有待唤醒的状态机时返回false
+        */
+        bool next(TimePoint& when) const;
+
+        /**
+         描述：获取已登记的状态机数量
+        */
+        size_t machines() const { return m_live; }
+
+        /**
+         描述：获取唤醒状态机的累计次数
+        */
+        unsigned long long wakeups() const { return m_wakeups; }
+
+    protected:
+        virtual unsigned int attach(Xyh_Jsm* machine);
+        virtual void detach(unsigned int slot);
+        virtual void schedule(unsigned int slot, TimePoint when);
+        virtual void cancel(unsigned int slot);
+
+    private:
+        Xyh_VirtualClock(const Xyh_VirtualClock&);
+        Xyh_VirtualClock& operator=(const Xyh_VirtualClock&);
+
+        /**
+         说明：登记位置
+        */
+        struct Slot {
+            //状态机；空闲时为空
+            Xyh_Jsm* machine;
+
+            //是否有未到期的唤醒，以及唤醒时刻
+            bool scheduled;
+            TimePoint when;
+
+            //空闲时为下一个空闲位置
+            unsigned int next;
+        };
+
+        enum { EMPTY = 0xFFFFFFFF };
+
+    private:
+        //当前时刻
+        TimePoint m_now;
+
+        //待唤醒的状态机 <唤醒时刻, 登记位置>
+        set<pair<TimePoint, unsigned int> > m_due;
+
+        //登记位置
+        vector<Slot> m_slots;
+
+        //第一个空闲位置
+        unsigned int m_free;
+
+        //已登记的状态机数量
+        size_t m_live;
+
+        //唤醒次数
+        unsigned long long m_wakeups;
+    };
+
+} //namespace XYH_StatusMachine
@@ -0,0 +1,251 @@
+﻿//local
+#include "fsm_columns.h"
+//std
+#include <limits>
+#include <cstring>
+//system
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define XYH_COLUMNS_SIMD 1
+#endif
+
+namespace XYH_StatusMachine {
+
+    namespace {
+        /**
+         说明：扫描条件；不限定状态时anyState不为0
+        */
+        struct _Predicate {
+            unsigned int state;
+            unsigned int anyState;
+            long long before;
+
+            //live时为STT_RECYCLE，否则为运行状态不可能取到的值
+            unsigned int dead;
+        };
+
+        /**
+         说明：列数组的起始地址
+        */
+        struct _Columns {
+            const unsigned int* states;
+            const unsigned char* flags;
+            const long long* times;
+        };
+
+        typedef size_t (*Kernel)(const _Columns& c, size_t n, const _Predicate& p, unsigned int* out);
+
+        /**
+         描述：将位掩码中置位的下标追加到out；out为0时只计数
+        */
+        inline size_t emit(unsigned int mask, unsigned int base, unsigned int* out) {
+            size_t n = 0;
+            while (mask) {
+#if defined(__GNUC__) || defined(__clang__)
+                unsigned int bit = (unsigned int)__builtin_ctz(mask);
+#else
+                unsigned int bit = 0;
+                while (!(mask & (1U << bit))) { bit++; }
+#endif
+                if (out) { out[n] = base + bit; }
+                n++;
+                mask &= mask - 1;
+            }
+            return n;
+        }
+
+        /**
+         描述：逐个比较[begin, n)
+        */
+        size_t scanScalar(const _Columns& c, size_t begin, size_t n, const _Predicate& p, unsigned int* out) {
+            size_t hits = 0;
+            for (size_t i = begin; i < n; i++) {
+                if ((p.anyState || c.states[i] == p.state) && c.times[i] < p.before && c.flags[i] != p.dead) {
+                    if (out) { out[hits] = (unsigned int)i; }
+                    hits++;
+                }
+            }
+            return hits;
+        }
+
+        size_t scanPlain(const _Columns& c, size_t n, const _Predicate& p, unsigned int* out) {
+            return scanScalar(c, 0, n, p, out);
+        }
+
+#ifdef XYH_COLUMNS_SIMD
+        /**
+         描述：每次比较8个事件；状态与运行状态按32位比较，时间按64位比较
+        */
+        __attribute__((target("avx2")))
+        size_t scanAvx2(const _Columns& c, size_t n, const _Predicate& p, unsigned int* out) {
+            const __m256i state = _mm256_set1_epi32((int)p.state);
+            const __m256i dead = _mm256_set1_epi32((int)p.dead);
+            const __m256i before = _mm256_set1_epi64x(p.before);
+            const int any = p.anyState ? 0xFF : 0;
+
+            size_t hits = 0;
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m256i st = _mm256_loadu_si256((const __m256i*)(c.states + i));
+                __m256i fl = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(c.flags + i)));
+                __m256i t0 = _mm256_loadu_si256((const __m256i*)(c.times + i));
+                __m256i t1 = _mm256_loadu_si256((const __m256i*)(c.times + i + 4));
+
+                int ms = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(st, state))) | any;
+                int mf = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(fl, dead)));
+                int mt = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(before, t0))) |
+                    (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(before, t1))) << 4);
+
+                hits += emit((unsigned int)(ms & mf & mt) & 0xFF, (unsigned int)i, out ? out + hits : 0);
+            }
+            return hits + scanScalar(c, i, n, p, out ? out + hits : 0);
+        }
+
+        /**
+         描述：每次比较4个事件；64位比较需要SSE4.2
+        */
+        __attribute__((target("sse4.2")))
+        size_t scanSse42(const _Columns& c, size_t n, const _Predicate& p, unsigned int* out) {
+            const __m128i state = _mm_set1_epi32((int)p.state);
+            const __m128i dead = _mm_set1_epi32((int)p.dead);
+            const __m128i before = _mm_set1_epi64x(p.before);
+            const int any = p.anyState ? 0xF : 0;
+
+            size_t hits = 0;
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                int flags;
+                std::memcpy(&flags, c.flags + i, sizeof(flags));
+
+                __m128i st = _mm_loadu_si128((const __m128i*)(c.states + i));
+                __m128i fl = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(flags));
+                __m128i t0 = _mm_loadu_si128((const __m128i*)(c.times + i));
+                __m128i t1 = _mm_loadu_si128((const __m128i*)(c.times + i + 2));
+
+                int ms = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(st, state))) | any;
+                int mf = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(fl, dead)));
+                int mt = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(before, t0))) |
+                    (_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(before, t1))) << 2);
+
+                hits += emit((unsigned int)(ms & mf & mt) & 0xF, (unsigned int)i, out ? out + hits : 0);
+            }
+            return hits + scanScalar(c, i, n, p, out ? out + hits : 0);
+        }
+#endif
+
+        /**
+         描述：获取指定名称的扫描实现
+         参数：
+           name：    实现名称；为0时选择CPU支持的最快实现
+         返回值：实现；本机不支持时返回0
+        */
+        Kernel find(const char** name) {
+#ifdef XYH_COLUMNS_SIMD
+            __builtin_cpu_init();
+            if ((!*name || 0 == std::strcmp(*name, "avx2")) && __builtin_cpu_supports("avx2")) {
+                *name = "avx2";
+                return &scanAvx2;
+            }
+            if ((!*name || 0 == std::strcmp(*name, "sse4.2")) && __builtin_cpu_supports("sse4.2")) {
+                *name = "sse4.2";
+                return &scanSse42;
+            }
+#endif
+            if (!*name || 0 == std::strcmp(*name, "scalar")) {
+                *name = "scalar";
+                return &scanPlain;
+            }
+            return 0;
+        }
+
+        /**
+         说明：首次使用时选定的扫描实现
+        */
+        struct _Selected {
+            Kernel kernel;
+            const char* name;
+
+            _Selected() : name(0) { kernel = find(&name); }
+        };
+
+        _Selected& selected() {
+            static _Selected s;
+            return s;
+        }
+    }
+
+    unsigned int Xyh_EventColumns::stateOf(const Xyh_Event& e) const {
+        const Xyh_Status* s = e.m_curStatus.get();
+        return (s && s->m_definition == m_definition) ? s->m_index : NO_STATE;
+    }
+
+    void Xyh_EventColumns::push(const Xyh_Event& e) {
+        m_ids.push_back(e.m_id);
+        m_states.push_back(stateOf(e));
+        m_flags.push_back(e.m_stt);
+        m_times.push_back((long long)e.m_enterTime);
+    }
+
+    void Xyh_EventColumns::set(size_t pos, const Xyh_Event& e) {
+        m_ids[pos] = e.m_id;
+        m_states[pos] = stateOf(e);
+        m_flags[pos] = e.m_stt;
+        m_times[pos] = (long long)e.m_enterTime;
+    }
+
+    void Xyh_EventColumns::remove(size_t pos) {
+        size_t last = m_ids.size() - 1;
+        if (pos != last) {
+            m_ids[pos] = m_ids[last];
+            m_states[pos] = m_states[last];
+            m_flags[pos] = m_flags[last];
+            m_times[pos] = m_times[last];
+        }
+        m_ids.pop_back();
+        m_states.pop_back();
+        m_flags.pop_back();
+        m_times.pop_back();
+    }
+
+    void Xyh_EventColumns::reserve(size_t n) {
+        m_ids.reserve(n);
+        m_states.reserve(n);
+        m_flags.reserve(n);
+        m_times.reserve(n);
+    }
+
+    size_t Xyh_EventColumns::scan(unsigned int state, unsigned long long before, bool live, size_t begin, size_t n,
+        unsigned int* out) const {
+        if (!n) {
+            return 0;
+        }
+
+        _Predicate p;
+        p.state = state;
+        p.anyState = (NO_STATE == state) ? 1 : 0;
+        p.before = before > (unsigned long long)std::numeric_limits<long long>::max() ?
+            std::numeric_limits<long long>::max() : (long long)before;
+        p.dead = live ? (unsigned int)Xyh_Event::STT_RECYCLE : 0x100;
+
+        _Columns c;
+        c.states = &m_states[begin];
+        c.flags = &m_flags[begin];
+        c.times = &m_times[begin];
+        return selected().kernel(c, n, p, out);
+    }
+
+    const char* Xyh_EventColumns::kernel() {
+        return selected().name;
+    }
+
+    bool Xyh_EventColumns::useKernel(const char* name) {
+        Kernel k = name ? find(&name) : 0;
+        if (!k) {
+            return false;
+        }
+        selected().kernel = k;
+        selected().name = name;
+        return true;
+    }
+
+} //namespace XYH_StatusMachine
@@ -0,0 +1,124 @@
+﻿#pragma once
+//local
+#include "fsm.h"
+
+namespace XYH_StatusMachine {
+
+    /**
+     说明：事件批量查询条件；同时满足所有条件的事件被选中
+    */
+    struct Xyh_EventFilter {
+        //不限定状态时status的取值
+        static const unsigned int ANY_STATUS = 0xFFFFFFFF;
+
+        //所在状态id；为ANY_STATUS时不限定
+        unsigned int status;
+
+        //进入当前状态的时间早于该时刻，单位为ms；默认不限定
+        unsigned long long enteredBefore;
+
+        //是否跳过已过期(STT_RECYCLE)的事件
+        bool live;
+
+        Xyh_EventFilter() : status(ANY_STATUS), enteredBefore(~0ULL), live(true) { }
+    };
+
+    /**
+     说明：事件列存储；
+          按事件表的连续下标以并行数组保存每个事件的id、所在状态下标、运行状态与进入状态时间，
+          事件表增删事件和事件转移时同步更新；批量查询只顺序扫描这几个数组，不访问事件对象。
+          x86下按CPU支持选用AVX2或SSE4.2向量化扫描，其他平台使用逐个比较
+    */
+    class Xyh_EventColumns {
+    public:
+        //事件不在本状态机定义的任何状态中时的状态下标
+        static const unsigned int NO_STATE = 0xFFFFFFFF;
+
+        /**
+         描述：构造函数
+         参数：
+           definition：  状态机定义，用于确定事件所在状态的下标
+         返回值：无
+        */
+        explicit Xyh_EventColumns(const Xyh_Definition* definition) : m_definition(definition) { }
+
+        /**
+         描述：在末尾追加一个事件
+        */
+        void push(const Xyh_Event& e);
+
+        /**
+         描述：以事件的当前值更新指定位置
+        */
+        void set(size_t pos, const Xyh_Event& e);
+
+        /**
+         描述：移除指定位置，与事件表一样用末尾的事件填补空位
+        */
+        void remove(size_t pos);
+
+        /**
+         描述：预先申请n个事件的空间
+        */
+        void reserve(size_t n);
+
+        /**
+         描述：获取事件数量
+        */
+        size_t size() const { return m_ids.size(); }
+
+        /**
+         描述：扫描[begin, begin + n)范围内的事件；调用者按块扫描并使用自己的定长缓冲区，
+              查询不分配内存
+         参数：
+           state：   状态下标；为NO_STATE时不限定
+           before：  进入状态时间早于该时刻，单位为ms
+           live：    是否跳过已过期的事件
+           begin：   起始下标
+           n：       事件数量，不超过size() - begin
+           out：     至少n个元素的数组，依次写入满足条件的事件相对begin的下标；为0时只计数
+         返回值：满足条件的事件数量
+        */
+        size_t scan(unsigned int state, unsigned long long before, bool live, size_t begin, size_t n,
+            unsigned int* out) const;
+
+        /**
+         描述：获取本机使用的扫描实现："avx2"、"sse4.2"或"scalar"
+        */
+        static const char* kernel();
+
+        /**
+         描述：改用指定的扫描实现，用于比较各实现的结果；不能与扫描并发调用
+         参数：
+           name：    "avx2"、"sse4.2"或"scalar"
+         返回值：本机支持该实现时返回true，否则保持原实现并返回false
+        */
+        static bool useKernel(const char* name);
+
+    private:
+        Xyh_EventColumns(const Xyh_EventColumns&);
+        Xyh_EventColumns& operator=(const Xyh_EventColumns&);
+
+        /**
+         描述：获取事件所在状态在本状态机定义中的下标
+        */
+        unsigned int stateOf(const Xyh_Event& e) const;
+
+    private:
+        //状态机定义
+        const Xyh_Definition* m_definition;
+
+        //事件id
+        vector<unsigned int> m_ids;
+
+        //所在状态下标
+        vector<unsigned int> m_states;
+
+        //运行状态，Xyh_Event::STT_*
+        vector<unsigned char> m_flags;
+
+        //进入当前状态的时间，单位为ms
+        vector<long long> m_times;
+    };
+
+} //namespace XYH_StatusMachine
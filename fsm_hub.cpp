@@ -0,0 +1,144 @@
+﻿//local
+#include "fsm_hub.h"
+//std
+#include <algorithm>
+//boost
+#include "boost/bind.hpp"
+
+namespace XYH_StatusMachine {
+
+    Xyh_TimerHub::Xyh_TimerHub(boost::asio::io_service& io_service) :
+        m_timer(io_service),
+        m_armed(false),
+        m_free(EMPTY),
+        m_live(0),
+        m_scheduled(0),
+        m_wakeups(0),
+        m_fires(0) {
+    }
+
+    unsigned int Xyh_TimerHub::attach(Xyh_Jsm* machine) {
+        if (m_free == EMPTY) {
+            Slot s = { 0, 0, false, EMPTY };
+            m_free = (unsigned int)m_slots.size();
+            m_slots.push_back(s);
+        }
+
+        unsigned int slot = m_free;
+        m_free = m_slots[slot].next;
+        m_slots[slot].machine = machine;
+        m_slots[slot].next = EMPTY;
+        m_live++;
+        return slot;
+    }
+
+    void Xyh_TimerHub::detach(unsigned int slot) {
+        cancel(slot);
+        m_slots[slot].ticket++;
+        m_slots[slot].machine = 0;
+        m_slots[slot].next = m_free;
+        m_free = slot;
+        m_live--;
+    }
+
+    void Xyh_TimerHub::schedule(unsigned int slot, TimePoint when) {
+        cancel(slot);
+
+        //票号变化使该位置已入堆的记录全部失效
+        Slot& s = m_slots[slot];
+        s.ticket++;
+        s.scheduled = true;
+        m_scheduled++;
+
+        Entry e = { when, slot, s.ticket };
+        m_heap.push_back(e);
+        std::push_heap(m_heap.begin(), m_heap.end());
+
+        if (!m_armed || when < m_armedAt) {
+            rearm();
+        }
+    }
+
+    void Xyh_TimerHub::cancel(unsigned int slot) {
+        Slot& s = m_slots[slot];
+        if (s.scheduled) {
+            s.scheduled = false;
+            m_scheduled--;
+        }
+    }
+
+    void Xyh_TimerHub::fire(const boost::system::error_code& e) {
+        if (e == boost::asio::error::operation_aborted) {
+            return;
+        }
+
+        m_armed = false;
+        m_fires++;
+
+        //先取出所有到期的状态机，状态机处理定时时会重新设置唤醒
+        TimePoint now = boost::asio::steady_timer::clock_type::now();
+        while (!m_heap.empty() && !(now < m_heap.front().when)) {
+            Entry top = m_heap.front();
+            std::pop_heap(m_heap.begin(), m_heap.end());
+            m_heap.pop_back();
+
+            if (valid(top)) {
+                cancel(top.slot);
+                m_due.push_back(std::make_pair(top.slot, m_slots[top.slot].ticket));
+            }
+        }
+
+        for (size_t i = 0; i < m_due.size(); i++) {
+            //之前唤醒的状态机可能注销了其他状态机
+            Slot& s = m_slots[m_due[i].first];
+            if (s.machine && s.ticket == m_due[i].second) {
+                m_wakeups++;
+                s.machine->tick();
+            }
+        }
+        m_due.clear();
+
+        compact();
+        rearm();
+    }
+
+    void Xyh_TimerHub::rearm() {
+        while (!m_heap.empty() && !valid(m_heap.front())) {
+            std::pop_heap(m_heap.begin(), m_heap.end());
+            m_heap.pop_back();
+        }
+
+        if (m_heap.empty()) {
+            if (m_armed) {
+                m_armed = false;
+                m_timer.cancel();
+            }
+            return;
+        }
+
+        if (m_armed && m_armedAt == m_heap.front().when) {
+            return;
+        }
+
+        m_armed = true;
+        m_armedAt = m_heap.front().when;
+        m_timer.expires_at(m_armedAt);
+        m_timer.async_wait(boost::bind(&Xyh_TimerHub::fire, this, _1));
+    }
+
+    void Xyh_TimerHub::compact() {
+        if (m_heap.size() <= 2 * m_scheduled + 64) {
+            return;
+        }
+
+        size_t n = 0;
+        for (size_t i = 0; i < m_heap.size(); i++) {
+            if (valid(m_heap[i])) {
+                m_heap[n++] = m_heap[i];
+            }
+        }
+        m_heap.resize(n);
+        std::make_heap(m_heap.begin(), m_heap.end());
+    }
+
+} //namespace XYH_StatusMachine
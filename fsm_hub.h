@@ -0,0 +1,170 @@
+﻿#pragma once
+//local
+#include "fsm.h"
+
+namespace XYH_StatusMachine {
+
+    /**
+     说明：共享定时中心；
+          多个状态机登记到同一个定时中心后不再各自设置定时器，定时中心只使用一个定时器，
+          按各状态机下一个定时的到期时刻排序，到期时只唤醒有定时到期的状态机；
+          空闲的状态机不占用任何唤醒；
+          登记的状态机必须与定时中心使用同一个io_service，并在同一个线程上运行
+    */
+    class Xyh_TimerHub {
+    public:
+        typedef boost::asio::steady_timer::time_point TimePoint;
+
+        /**
+         描述：构造函数
+         参数：
+           io_service：  定时器使用的io_service
+         返回值：无
+        */
+        explicit Xyh_TimerHub(boost::asio::io_service& io_service);
+
+        /**
+         描述：获取已登记的状态机数量
+        */
+        size_t machines() const { return m_live; }
+
+        /**
+         描述：获取唤醒状态机的累计次数
+        */
+        unsigned long long wakeups() const { return m_wakeups; }
+
+        /**
+         描述：获取定时器到期的累计次数；每次到期唤醒所有已到期的状态机
+        */
+        unsigned long long fires() const { return m_fires; }
+
+    private:
+        friend class Xyh_Jsm;
+
+        Xyh_TimerHub(const Xyh_TimerHub&);
+        Xyh_TimerHub& operator=(const Xyh_TimerHub&);
+
+        /**
+         描述：登记状态机
+         参数：
+           machine： 状态机
+         返回值：登记位置，用于之后的schedule、cancel和detach
+        */
+        unsigned int attach(Xyh_Jsm* machine);
+
+        /**
+         描述：注销状态机，其未到期的唤醒随之失效
+         参数：
+           slot：    登记位置
+         返回值：无
+        */
+        void detach(unsigned int slot);
+
+        /**
+         描述：设置状态机的下一次唤醒时刻，替换之前设置的唤醒
+         参数：
+           slot：    登记位置
+           when：    唤醒时刻
+         返回值：无
+        */
+        void schedule(unsigned int slot, TimePoint when);
+
+        /**
+         描述：取消状态机的唤醒
+         参数：
+           slot：    登记位置
+         返回值：无
+        */
+        void cancel(unsigned int slot);
+
+        /**
+         描述：定时器回调；唤醒所有已到期的状态机
+         参数：
+           e：       错误码
+         返回值：无
+        */
+        void fire(const boost::system::error_code& e);
+
+        /**
+         描述：丢弃堆顶已失效的唤醒，并将定时器设置到最早的有效唤醒时刻
+         参数：无
+         返回值：无
+        */
+        void rearm();
+
+    private:
+        /**
+         说明：唤醒记录；状态机重新设置或取消唤醒后旧记录失效，出堆时丢弃
+        */
+        struct Entry {
+            TimePoint when;
+            unsigned int slot;
+            unsigned int ticket;
+
+            //用于构造最小堆
+            bool operator<(const Entry& rhs) const { return rhs.when < when; }
+        };
+
+        /**
+         说明：登记位置
+        */
+        struct Slot {
+            //状态机；空闲时为空
+            Xyh_Jsm* machine;
+
+            //最近一次设置唤醒的票号
+            unsigned int ticket;
+
+            //是否有未到期的唤醒
+            bool scheduled;
+
+            //空闲时为下一个空闲位置
+            unsigned int next;
+        };
+
+        enum { EMPTY = 0xFFFFFFFF };
+
+        /**
+         描述：判断唤醒记录是否仍然有效
+        */
+        bool valid(const Entry& e) const {
+            return m_slots[e.slot].scheduled && m_slots[e.slot].ticket == e.ticket;
+        }
+
+        /**
+         描述：失效记录过多时重建堆，堆的大小与有效唤醒数量保持在同一量级
+        */
+        void compact();
+
+    private:
+        //定时器
+        boost::asio::steady_timer m_timer;
+
+        //定时器是否已设置，以及设置的到期时刻
+        bool m_armed;
+        TimePoint m_armedAt;
+
+        //唤醒记录最小堆
+        vector<Entry> m_heap;
+
+        //登记位置
+        vector<Slot> m_slots;
+
+        //第一个空闲位置
+        unsigned int m_free;
+
+        //已登记的状态机数量
+        size_t m_live;
+
+        //有效唤醒数量
+        size_t m_scheduled;
+
+        //本次到期需要唤醒的状态机 <登记位置, 票号>
+        vector<pair<unsigned int, unsigned int> > m_due;
+
+        //统计
+        unsigned long long m_wakeups;
+        unsigned long long m_fires;
+    };
+
+} //namespace XYH_StatusMachine
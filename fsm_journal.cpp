@@ -0,0 +1,293 @@
+﻿//local
+#include "fsm_journal.h"
+//std
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+//boost
+#include "boost/bind.hpp"
+#include "boost/crc.hpp"
+#include "boost/chrono.hpp"
+#include "boost/interprocess/file_mapping.hpp"
+#include "boost/interprocess/mapped_region.hpp"
+//system
+#ifdef WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#define XYH_OPEN(p)         _open((p), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE)
+#define XYH_WRITE           _write
+#define XYH_CLOSE           _close
+#define XYH_SYNC            _commit
+#define XYH_TRUNCATE        _chsize_s
+#define XYH_SEEK_END(fd)    _lseeki64((fd), 0, SEEK_END)
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#define XYH_OPEN(p)         ::open((p), O_RDWR | O_CREAT, 0644)
+#define XYH_WRITE           ::write
+#define XYH_CLOSE           ::close
+#define XYH_SYNC            ::fdatasync
+#define XYH_TRUNCATE        ::ftruncate
+#define XYH_SEEK_END(fd)    ::lseek((fd), 0, SEEK_END)
+#endif
+
+namespace XYH_StatusMachine {
+
+    namespace {
+        /**
+         说明：记录头；其后为负载。size为包括记录头在内的总字节数，crc覆盖crc之后的所有字节
+        */
+        struct _RecordHeader {
+            unsigned int size;
+            unsigned int crc;
+            unsigned long long seq;
+            unsigned long long tick;
+            unsigned int event;
+            unsigned int signal;
+            unsigned int status;
+            unsigned char type;
+            unsigned char reserved[3];
+        };
+
+        unsigned int checksum(const char* data, size_t size) {
+            boost::crc_32_type crc;
+            crc.process_bytes(data, size);
+            return crc.checksum();
+        }
+
+        /**
+         描述：依次解析内存中的记录，遇到校验失败或不完整的记录时停止
+         参数：
+           data：    日志内容
+           size：    字节数
+           visitor： 每条记录的回调，可为空
+           last：    返回最后一条有效记录的序号
+         返回值：有效记录占用的字节数
+        */
+        size_t parse(const char* data, size_t size, const Xyh_Journal::Visitor& visitor, unsigned long long& last) {
+            size_t pos = 0;
+            last = 0;
+            Xyh_Journal::Record r;
+            while (size - pos >= sizeof(_RecordHeader)) {
+                _RecordHeader hdr;
+                std::memcpy(&hdr, data + pos, sizeof(hdr));
+                if (hdr.size < sizeof(_RecordHeader) || hdr.size > size - pos || hdr.seq != last + 1 ||
+                    hdr.crc != checksum(data + pos + 2 * sizeof(unsigned int), hdr.size - 2 * sizeof(unsigned int))) {
+                    break;
+                }
+
+                if (visitor) {
+                    r.seq = hdr.seq;
+                    r.tick = hdr.tick;
+                    r.type = hdr.type;
+                    r.event = hdr.event;
+                    r.signal = hdr.signal;
+                    r.status = hdr.status;
+                    r.payload.assign(data + pos + sizeof(_RecordHeader), hdr.size - sizeof(_RecordHeader));
+                    visitor(r);
+                }
+                last = hdr.seq;
+                pos += hdr.size;
+            }
+            return pos;
+        }
+
+        /**
+         描述：映射日志文件并解析其中的记录
+         参数：
+           path：    日志文件路径
+           visitor： 每条记录的回调，可为空
+           last：    返回最后一条有效记录的序号
+         返回值：有效记录占用的字节数
+        */
+        size_t scan(const string& path, const Xyh_Journal::Visitor& visitor, unsigned long long& last) {
+            last = 0;
+            std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+            if (!in || in.tellg() <= 0) {
+                return 0;
+            }
+            in.close();
+
+            try {
+                boost::interprocess::file_mapping file(path.c_str(), boost::interprocess::read_only);
+                boost::interprocess::mapped_region region(file, boost::interprocess::read_only);
+                return parse((const char*)region.get_address(), region.get_size(), visitor, last);
+            }
+            catch (boost::interprocess::interprocess_exception& e) {
+                std::stringstream ss;
+                ss << "failed to map journal(" << path << "): " << e.what();
+                throw std::logic_error(ss.str());
+            }
+        }
+    }
+
+    Xyh_Journal::Xyh_Journal(const string& path, Policy policy) throw (std::logic_error) :
+        m_policy(policy),
+        m_fd(-1),
+        m_urgent(false),
+        m_stop(false),
+        m_failed(false),
+        m_appended(0),
+        m_durable(0) {
+
+        unsigned long long last = 0;
+        size_t valid = scan(path, Visitor(), last);
+
+        m_fd = XYH_OPEN(path.c_str());
+        if (m_fd < 0) {
+            std::stringstream ss;
+            ss << "failed to open journal(" << path << "): " << std::strerror(errno);
+            throw std::logic_error(ss.str());
+        }
+
+        //截掉崩溃时未写完整的尾部
+        if (0 != XYH_TRUNCATE(m_fd, valid) || XYH_SEEK_END(m_fd) < 0) {
+            XYH_CLOSE(m_fd);
+            std::stringstream ss;
+            ss << "failed to truncate journal(" << path << "): " << std::strerror(errno);
+            throw std::logic_error(ss.str());
+        }
+
+        m_appended.store(last, boost::memory_order_relaxed);
+        m_durable.store(last, boost::memory_order_relaxed);
+        m_active.reserve(m_policy.groupBytes * 2);
+        m_writing.reserve(m_policy.groupBytes * 2);
+        m_thread.reset(new boost::thread(boost::bind(&Xyh_Journal::writer, this)));
+    }
+
+    Xyh_Journal::~Xyh_Journal() {
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        m_thread->join();
+        XYH_CLOSE(m_fd);
+    }
+
+    unsigned long long Xyh_Journal::append(unsigned char type, unsigned long long tick, unsigned int event,
+        unsigned int signal, unsigned int status, const char* payload, size_t size) throw (std::logic_error) {
+        _RecordHeader hdr;
+        //记录长度字段为32位，超长的负载会使长度回绕，读取时错位
+        if ((unsigned long long)size > 0xFFFFFFFFULL - sizeof(hdr)) {
+            std::stringstream ss;
+            ss << "journal payload too large(" << size << " bytes)";
+            throw std::logic_error(ss.str());
+        }
+        std::memset(&hdr, 0, sizeof(hdr));
+        hdr.size = (unsigned int)(sizeof(hdr) + size);
+        hdr.tick = tick;
+        hdr.event = event;
+        hdr.signal = signal;
+        hdr.status = status;
+        hdr.type = type;
+
+        bool wake = false;
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            if (!m_error.empty()) {
+                return 0;
+            }
+            hdr.seq = m_appended.load(boost::memory_order_relaxed) + 1;
+
+            boost::crc_32_type crc;
+            crc.process_bytes((const char*)&hdr + 2 * sizeof(unsigned int), sizeof(hdr) - 2 * sizeof(unsigned int));
+            crc.process_bytes(payload, size);
+            hdr.crc = crc.checksum();
+
+            size_t pos = m_active.size();
+            m_active.resize(pos + hdr.size);
+            std::memcpy(&m_active[pos], &hdr, sizeof(hdr));
+            if (size) {
+                std::memcpy(&m_active[pos + sizeof(hdr)], payload, size);
+            }
+            m_appended.store(hdr.seq, boost::memory_order_relaxed);
+            wake = (0 == pos || m_active.size() >= m_policy.groupBytes);
+        }
+        if (wake) {
+            m_wake.notify_one();
+        }
+        return hdr.seq;
+    }
+
+    void Xyh_Journal::flush() throw (std::logic_error) {
+        boost::mutex::scoped_lock lock(m_mutex);
+        unsigned long long target = m_appended.load(boost::memory_order_relaxed);
+        while (m_durable.load(boost::memory_order_acquire) < target && m_error.empty()) {
+            m_urgent = true;
+            m_wake.notify_one();
+            m_done.wait(lock);
+        }
+        if (!m_error.empty()) {
+            throw std::logic_error(m_error);
+        }
+    }
+
+    string Xyh_Journal::error() const {
+        boost::mutex::scoped_lock lock(m_mutex);
+        return m_error;
+    }
+
+    void Xyh_Journal::writer() {
+        boost::mutex::scoped_lock lock(m_mutex);
+        while (true) {
+            while (m_active.empty() && !m_stop) {
+                m_wake.wait(lock);
+            }
+            if (m_active.empty() && m_stop) {
+                break;
+            }
+
+            //等待更多记录合并为一批，缓冲区已满、有flush等待或停止时立即写入
+            if (m_active.size() < m_policy.groupBytes && !m_urgent && !m_stop && m_policy.intervalMs) {
+                m_wake.wait_for(lock, boost::chrono::milliseconds(m_policy.intervalMs));
+            }
+
+            m_writing.swap(m_active);
+            m_urgent = false;
+            unsigned long long seq = m_appended.load(boost::memory_order_relaxed);
+            lock.unlock();
+
+            string error;
+            const char* p = m_writing.data();
+            size_t left = m_writing.size();
+            while (left && error.empty()) {
+                long n = (long)XYH_WRITE(m_fd, p, (unsigned int)left);
+                if (n < 0) {
+                    if (EINTR == errno) { continue; }
+                    error = std::string("failed to write journal: ") + std::strerror(errno);
+                    break;
+                }
+                p += n;
+                left -= (size_t)n;
+            }
+            if (error.empty() && m_policy.sync && 0 != XYH_SYNC(m_fd)) {
+                error = std::string("failed to sync journal: ") + std::strerror(errno);
+            }
+            m_writing.clear();
+
+            lock.lock();
+            if (error.empty()) {
+                m_durable.store(seq, boost::memory_order_release);
+                m_done.notify_all();
+                continue;
+            }
+
+            //失败后丢弃未写入的记录并停止写入；写了一半的记录在读取时被忽略
+            m_error = error;
+            m_active.clear();
+            m_failed.store(true, boost::memory_order_release);
+            m_done.notify_all();
+            break;
+        }
+    }
+
+    size_t Xyh_Journal::read(const string& path, Visitor visitor) throw (std::logic_error) {
+        unsigned long long last = 0;
+        return scan(path, visitor, last);
+    }
+
+} //namespace XYH_StatusMachine
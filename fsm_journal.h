@@ -0,0 +1,205 @@
+﻿#pragma once
+//std
+#include <string>
+#include <vector>
+#include <stdexcept>
+//boost
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace XYH_StatusMachine {
+    using std::string;
+    using std::vector;
+
+    /**
+     说明：预写信号日志；
+          状态机在处理每个顶层调用之前追加一条记录，记录先进入内存缓冲区，
+          由后台线程成批写入文件并同步到磁盘(group commit)；
+          每条记录带有递增的序号和CRC校验，崩溃时写了一半的尾部记录在重新打开时被截掉；
+          写入或同步失败后日志不再接受新记录，避免序号出现空洞使回放时静默丢失记录
+    */
+    class Xyh_Journal {
+    public:
+        /**
+         说明：记录类型
+        */
+        enum Type {
+            REC_ADD         = 1,    //addEvent；负载为事件别名
+            REC_RELEASE     = 2,    //relEvent
+            REC_EXPIRE      = 3,    //expireEvent
+            REC_PLACE       = 4,    //Xyh_Event::place；status为状态id
+            REC_PROCESS     = 5,    //process/tryProcess/processBatch
+            REC_DIGEST      = 6,    //digestion/tryDigest/digestBatch
+            REC_BROADCAST   = 7,    //process(signal, msg)
+
+            //标志位，与以上类型组合：记录由定时处理函数发起
+            REC_TIMER       = 0x80
+        };
+
+        /**
+         说明：日志记录
+        */
+        struct Record {
+            //序号，从1开始递增
+            unsigned long long seq;
+
+            //记录时的状态机时刻，单位为ms
+            unsigned long long tick;
+
+            //记录类型
+            unsigned char type;
+
+            //事件id
+            unsigned int event;
+
+            //信号
+            unsigned int signal;
+
+            //状态id，仅REC_PLACE有效
+            unsigned int status;
+
+            //负载
+            string payload;
+        };
+
+        /**
+         说明：持久化策略；缓冲区达到groupBytes或距上次写入超过intervalMs时写入一批，
+              sync为false时只写入不调用fdatasync，由操作系统决定落盘时机
+        */
+        struct Policy {
+            size_t groupBytes;
+            unsigned int intervalMs;
+            bool sync;
+
+            Policy() : groupBytes(256 * 1024), intervalMs(2), sync(true) { }
+        };
+
+        //记录读取回调
+        typedef boost::function<void(const Record&)> Visitor;
+
+    public:
+        /**
+         描述：打开或创建日志文件；已有文件中校验失败的尾部记录被截掉，新记录接在最后一条有效记录之后
+         参数：
+           path：    日志文件路径
+           policy：  持久化策略
+         返回值：无
+        */
+        Xyh_Journal(const string& path, Policy policy = Policy()) throw (std::logic_error);
+
+        /**
+         描述：析构函数；写入并同步所有已追加的记录后停止后台线程
+        */
+        ~Xyh_Journal();
+
+        /**
+         描述：追加一条记录；只复制到内存缓冲区，不等待写入
+         参数：
+           type：    记录类型
+           tick：    状态机时刻，单位为ms
+           event：   事件id
+           signal：  信号
+           status：  状态id
+           payload： 负载
+           size：    负载字节数；记录总长超出32位长度字段时抛出异常
+         返回值：记录序号；日志已写入失败时不追加并返回0
+        */
+        unsigned long long append(unsigned char type, unsigned long long tick, unsigned int event,
+            unsigned int signal, unsigned int status, const char* payload, size_t size) throw (std::logic_error);
+
+        /**
+         描述：等待所有已追加的记录写入并同步到磁盘
+         参数：无
+         返回值：无；写入失败时抛出异常
+        */
+        void flush() throw (std::logic_error);
+
+        /**
+         描述：获取最后追加的记录序号
+         参数：无
+         返回值：序号；没有记录时为0
+        */
+        unsigned long long sequence() const { return m_appended.load(boost::memory_order_relaxed); }
+
+        /**
+         描述：获取已持久化的最后一条记录的序号
+         参数：无
+         返回值：序号
+        */
+        unsigned long long durable() const { return m_durable.load(boost::memory_order_acquire); }
+
+        /**
+         描述：判断日志是否已写入失败；失败后durable之后的记录均未持久化
+         参数：无
+         返回值：失败返回true
+        */
+        bool failed() const { return m_failed.load(boost::memory_order_acquire); }
+
+        /**
+         描述：获取写入失败的错误信息
+         参数：无
+         返回值：错误信息；未失败时为空
+        */
+        string error() const;
+
+        /**
+         描述：按顺序读取日志文件中的有效记录，遇到校验失败或不完整的记录时停止
+         参数：
+           path：    日志文件路径
+           visitor： 每条记录的回调
+         返回值：有效记录占用的字节数
+        */
+        static size_t read(const string& path, Visitor visitor) throw (std::logic_error);
+
+    private:
+        Xyh_Journal(const Xyh_Journal&);
+        Xyh_Journal& operator=(const Xyh_Journal&);
+
+        /**
+         描述：后台写入线程
+        */
+        void writer();
+
+    private:
+        //持久化策略
+        Policy m_policy;
+
+        //文件描述符
+        int m_fd;
+
+        //保护以下缓冲区与状态
+        mutable boost::mutex m_mutex;
+        boost::condition_variable m_wake;
+        boost::condition_variable m_done;
+
+        //正在追加的缓冲区
+        string m_active;
+
+        //后台线程正在写入的缓冲区
+        string m_writing;
+
+        //是否有flush在等待
+        bool m_urgent;
+
+        //是否停止后台线程
+        bool m_stop;
+
+        //写入失败时的错误信息
+        string m_error;
+
+        //是否已写入失败
+        boost::atomic<bool> m_failed;
+
+        //最后追加与最后持久化的记录序号
+        boost::atomic<unsigned long long> m_appended;
+        boost::atomic<unsigned long long> m_durable;
+
+        //后台写入线程
+        boost::scoped_ptr<boost::thread> m_thread;
+    };
+
+} //namespace XYH_StatusMachine
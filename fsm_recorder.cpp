@@ -0,0 +1,330 @@
+﻿//local
+#include "fsm_recorder.h"
+//std
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+//boost
+#include "boost/ref.hpp"
+//system
+#ifdef WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#define XYH_CREATE(p)       _open((p), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE)
+#define XYH_WRITE           _write
+#define XYH_CLOSE           _close
+#define XYH_THREAD_LOCAL    __declspec(thread)
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#define XYH_CREATE(p)       ::open((p), O_WRONLY | O_CREAT | O_TRUNC, 0644)
+#define XYH_WRITE           ::write
+#define XYH_CLOSE           ::close
+#define XYH_THREAD_LOCAL    __thread
+#endif
+
+namespace XYH_StatusMachine {
+
+    namespace {
+        /**
+         说明：导出文件头；其后每个线程一段，段头之后为按时间先后排列的记录
+        */
+        struct _FileHeader {
+            char magic[8];
+            unsigned int entrySize;
+            unsigned int rings;
+        };
+
+        struct _RingHeader {
+            unsigned int thread;
+            unsigned int count;
+        };
+
+        const char MAGIC[8] = { 'J', 'S', 'M', 'F', 'L', 'T', '0', '1' };
+
+        /**
+         说明：线程本地缓存，记录最近使用的记录器及其缓冲区
+        */
+        struct _Local {
+            unsigned long long serial;
+            void* ring;
+        };
+
+        XYH_THREAD_LOCAL _Local g_local = { 0, 0 };
+
+        boost::atomic<unsigned long long> g_serial(0);
+
+        //致命错误时导出的记录器与文件路径
+        boost::atomic<const Xyh_Recorder*> g_fatal(0);
+        char g_fatalPath[1024];
+
+        bool writeAll(int fd, const void* data, size_t size) {
+            const char* p = (const char*)data;
+            while (size) {
+                int n = (int)XYH_WRITE(fd, p, (unsigned int)size);
+                if (n <= 0) {
+                    if (n < 0 && EINTR == errno) { continue; }
+                    return false;
+                }
+                p += n;
+                size -= (size_t)n;
+            }
+            return true;
+        }
+    }
+
+    Xyh_Recorder::Xyh_Recorder(size_t capacity) :
+        m_capacity(1),
+        m_mask(0),
+        m_serial(++g_serial),
+        m_rings((_Ring*)0),
+        m_ringCount(0) {
+        while (m_capacity < capacity) {
+            m_capacity <<= 1;
+        }
+        m_mask = m_capacity - 1;
+    }
+
+    Xyh_Recorder::~Xyh_Recorder() {
+        const Xyh_Recorder* self = this;
+        g_fatal.compare_exchange_strong(self, (const Xyh_Recorder*)0);
+
+        _Ring* r = m_rings.load(boost::memory_order_acquire);
+        while (r) {
+            _Ring* next = r->next;
+            delete r;
+            r = next;
+        }
+    }
+
+    void Xyh_Recorder::record(unsigned char kind, unsigned long long tick, unsigned int machine, unsigned int event,
+        unsigned int from, unsigned int to, unsigned int signal) {
+        _Ring* r = (g_local.serial == m_serial) ? (_Ring*)g_local.ring : attach();
+
+        unsigned long long h = r->head.load(boost::memory_order_relaxed);
+        Entry& e = r->entries[h & m_mask];
+        e.tick = tick;
+        e.machine = machine;
+        e.event = event;
+        e.from = from;
+        e.to = to;
+        e.signal = signal;
+        e.kind = kind;
+        r->head.store(h + 1, boost::memory_order_release);
+    }
+
+    Xyh_Recorder::_Ring* Xyh_Recorder::attach() {
+        //线程本地变量的地址在线程存活期间唯一；线程退出后新线程可能沿用其缓冲区
+        const void* thread = &g_local;
+        _Ring* r = m_rings.load(boost::memory_order_acquire);
+        while (r && r->thread != thread) {
+            r = r->next;
+        }
+
+        if (!r) {
+            r = new _Ring;
+            r->thread = thread;
+            r->index = m_ringCount.fetch_add(1, boost::memory_order_relaxed);
+            r->head.store(0, boost::memory_order_relaxed);
+            r->entries.reset(new Entry[m_capacity]);
+            std::memset(r->entries.get(), 0, sizeof(Entry) * m_capacity);
+
+            _Ring* head = m_rings.load(boost::memory_order_relaxed);
+            do {
+                r->next = head;
+            } while (!m_rings.compare_exchange_weak(head, r, boost::memory_order_release, boost::memory_order_relaxed));
+        }
+
+        g_local.serial = m_serial;
+        g_local.ring = r;
+        return r;
+    }
+
+    size_t Xyh_Recorder::collect(Visitor visitor) const {
+        size_t total = 0;
+        vector<Entry> copy;
+        for (_Ring* r = m_rings.load(boost::memory_order_acquire); r; r = r->next) {
+            unsigned long long end = r->head.load(boost::memory_order_acquire);
+            unsigned long long begin = end > m_capacity ? end - m_capacity : 0;
+            copy.resize((size_t)(end - begin));
+            for (unsigned long long i = begin; i < end; i++) {
+                copy[(size_t)(i - begin)] = r->entries[i & m_mask];
+            }
+
+            //复制期间写入的记录覆盖了最早的部分，正在写入的一条也不完整
+            unsigned long long now = r->head.load(boost::memory_order_acquire);
+            unsigned long long valid = now >= m_capacity ? now - m_capacity + 1 : 0;
+            for (unsigned long long i = begin < valid ? valid : begin; i < end; i++) {
+                visitor(r->index, copy[(size_t)(i - begin)]);
+                total++;
+            }
+        }
+        return total;
+    }
+
+    namespace {
+        /**
+         说明：按线程收集记录，用于写入文件
+        */
+        struct _Collector {
+            vector<unsigned int> threads;
+            vector<vector<Xyh_Recorder::Entry> > entries;
+
+            void operator()(unsigned int thread, const Xyh_Recorder::Entry& e) {
+                if (threads.empty() || threads.back() != thread) {
+                    threads.push_back(thread);
+                    entries.push_back(vector<Xyh_Recorder::Entry>());
+                }
+                entries.back().push_back(e);
+            }
+        };
+    }
+
+    size_t Xyh_Recorder::dump(const string& path) const throw (std::logic_error) {
+        _Collector c;
+        size_t total = collect(boost::ref(c));
+
+        std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+        _FileHeader fh;
+        std::memcpy(fh.magic, MAGIC, sizeof(MAGIC));
+        fh.entrySize = sizeof(Entry);
+        fh.rings = (unsigned int)c.threads.size();
+        out.write((const char*)&fh, sizeof(fh));
+        for (size_t i = 0; i < c.threads.size(); i++) {
+            _RingHeader rh = { c.threads[i], (unsigned int)c.entries[i].size() };
+            out.write((const char*)&rh, sizeof(rh));
+            out.write((const char*)&c.entries[i][0], sizeof(Entry) * c.entries[i].size());
+        }
+        out.close();
+
+        if (!out) {
+            std::stringstream ss;
+            ss << "failed to write flight record(" << path << ")";
+            throw std::logic_error(ss.str());
+        }
+        return total;
+    }
+
+    void Xyh_Recorder::dumpRaw(int fd) const {
+        //只使用write，不加锁、不分配内存；其他线程仍在写入时个别记录可能不完整
+        unsigned int rings = m_ringCount.load(boost::memory_order_acquire);
+        _FileHeader fh;
+        std::memcpy(fh.magic, MAGIC, sizeof(MAGIC));
+        fh.entrySize = sizeof(Entry);
+        fh.rings = 0;
+
+        _Ring* first = m_rings.load(boost::memory_order_acquire);
+        for (_Ring* r = first; r && fh.rings < rings; r = r->next) {
+            fh.rings++;
+        }
+        if (!writeAll(fd, &fh, sizeof(fh))) { return; }
+
+        unsigned int written = 0;
+        for (_Ring* r = first; r && written < fh.rings; r = r->next, written++) {
+            unsigned long long end = r->head.load(boost::memory_order_acquire);
+            unsigned long long begin = end >= m_capacity ? end - m_capacity + 1 : 0;
+            _RingHeader rh = { r->index, (unsigned int)(end - begin) };
+            if (!writeAll(fd, &rh, sizeof(rh))) { return; }
+
+            //环形缓冲区最多分为两段
+            size_t from = (size_t)(begin & m_mask);
+            size_t count = (size_t)(end - begin);
+            size_t tail = m_capacity - from < count ? m_capacity - from : count;
+            if (!writeAll(fd, &r->entries[from], sizeof(Entry) * tail) ||
+                !writeAll(fd, &r->entries[0], sizeof(Entry) * (count - tail))) {
+                return;
+            }
+        }
+    }
+
+    void Xyh_Recorder::onFatal(int sig) {
+        const Xyh_Recorder* recorder = g_fatal.exchange((const Xyh_Recorder*)0);
+        if (recorder) {
+            int fd = XYH_CREATE(g_fatalPath);
+            if (fd >= 0) {
+                recorder->dumpRaw(fd);
+                XYH_CLOSE(fd);
+            }
+        }
+
+        //恢复默认处理后重新触发，保留原有的退出方式与core dump
+        signal(sig, SIG_DFL);
+        raise(sig);
+    }
+
+    void Xyh_Recorder::dumpOnFatal(const string& path) {
+        g_fatal.store(0);
+        size_t n = path.size() < sizeof(g_fatalPath) - 1 ? path.size() : sizeof(g_fatalPath) - 1;
+        std::memcpy(g_fatalPath, path.c_str(), n);
+        g_fatalPath[n] = 0;
+        g_fatal.store(this);
+
+#ifdef WIN32
+        const int signals[] = { SIGSEGV, SIGFPE, SIGILL, SIGABRT };
+        for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++) {
+            signal(signals[i], &Xyh_Recorder::onFatal);
+        }
+#else
+        const int signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+        struct sigaction sa;
+        std::memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = &Xyh_Recorder::onFatal;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESETHAND;
+        for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++) {
+            sigaction(signals[i], &sa, 0);
+        }
+#endif
+    }
+
+    Xyh_Recorder* Xyh_Recorder::global() {
+        //不析构，进程退出过程中仍在运行的状态机可以继续记录
+        static Xyh_Recorder* recorder = new Xyh_Recorder;
+        return recorder;
+    }
+
+    size_t Xyh_Recorder::read(const string& path, Visitor visitor) throw (std::logic_error) {
+        std::ifstream in(path.c_str(), std::ios::binary);
+        if (!in) {
+            std::stringstream ss;
+            ss << "failed to open flight record(" << path << "): " << std::strerror(errno);
+            throw std::logic_error(ss.str());
+        }
+
+        _FileHeader fh;
+        if (!in.read((char*)&fh, sizeof(fh)) || 0 != std::memcmp(fh.magic, MAGIC, sizeof(MAGIC)) ||
+            fh.entrySize != sizeof(Entry)) {
+            std::stringstream ss;
+            ss << "invalid flight record(" << path << ")";
+            throw std::logic_error(ss.str());
+        }
+
+        size_t total = 0;
+        for (unsigned int i = 0; i < fh.rings; i++) {
+            _RingHeader rh;
+            if (!in.read((char*)&rh, sizeof(rh))) { break; }
+            for (unsigned int k = 0; k < rh.count; k++) {
+                Entry e;
+                if (!in.read((char*)&e, sizeof(e))) { return total; }
+                if (visitor) { visitor(rh.thread, e); }
+                total++;
+            }
+        }
+        return total;
+    }
+
+    const char* Xyh_Recorder::kindName(unsigned char kind) {
+        switch (kind) {
+        case ENT_PLACE: return "place";
+        case ENT_MOVE:  return "move";
+        case ENT_SELF:  return "self";
+        case ENT_TIMER: return "timer";
+        default:        return "unknown";
+        }
+    }
+
+} //namespace XYH_StatusMachine
@@ -0,0 +1,190 @@
+﻿#pragma once
+//std
+#include <string>
+#include <vector>
+#include <stdexcept>
+//boost
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/scoped_array.hpp>
+
+namespace XYH_StatusMachine {
+    using std::string;
+    using std::vector;
+
+    /**
+     说明：转移飞行记录器；
+          每个写入线程拥有一个固定容量的环形缓冲区，只由该线程写入，写满后覆盖最早的记录，
+          记录时不加锁也不分配内存。可随时导出到文件，也可在进程收到致命信号时导出，
+          导出文件由Xyh_Recorder::read或jsm_flight工具解码
+    */
+    class Xyh_Recorder {
+    public:
+        /**
+         说明：记录类型
+        */
+        enum Kind {
+            ENT_PLACE   = 1,    //Xyh_Event::place；from为NO_STATUS
+            ENT_MOVE    = 2,    //由信号触发的转移，包括自环的重新进入
+            ENT_SELF    = 3,    //digestion的自环，只执行信号处理函数
+            ENT_TIMER   = 4     //定时触发的timerRoutine；signal为定时标签
+        };
+
+        //没有所在状态时的状态id
+        static const unsigned int NO_STATUS = 0xFFFFFFFF;
+
+        /**
+         说明：记录；固定32字节，按本机字节序导出
+        */
+        struct Entry {
+            //状态机时刻，单位为ms
+            unsigned long long tick;
+
+            //状态机id
+            unsigned int machine;
+
+            //事件id
+            unsigned int event;
+
+            //起始状态id与目标状态id
+            unsigned int from;
+            unsigned int to;
+
+            //信号或定时标签
+            unsigned int signal;
+
+            //记录类型，Kind
+            unsigned char kind;
+            unsigned char reserved[3];
+        };
+
+        //导出文件的记录回调 <线程序号, 记录>；同一线程的记录按时间先后回调
+        typedef boost::function<void(unsigned int, const Entry&)> Visitor;
+
+    public:
+        /**
+         描述：构造函数
+         参数：
+           capacity：    每个线程保留的记录数量，向上取整为2的幂
+         返回值：无
+        */
+        explicit Xyh_Recorder(size_t capacity = 4096);
+
+        /**
+         描述：析构函数；若本对象已登记为致命错误时导出，取消登记
+        */
+        ~Xyh_Recorder();
+
+        /**
+         描述：在当前线程的缓冲区中追加一条记录
+         参数：
+           kind：    记录类型
+           tick：    状态机时刻，单位为ms
+           machine： 状态机id
+           event：   事件id
+           from：    起始状态id
+           to：      目标状态id
+           signal：  信号或定时标签
+         返回值：无
+        */
+        void record(unsigned char kind, unsigned long long tick, unsigned int machine, unsigned int event,
+            unsigned int from, unsigned int to, unsigned int signal);
+
+        /**
+         描述：复制所有线程缓冲区中的记录；复制期间被覆盖的记录会被丢弃
+         参数：
+           visitor： 每条记录的回调
+         返回值：记录数量
+        */
+        size_t collect(Visitor visitor) const;
+
+        /**
+         描述：将所有线程缓冲区中的记录写入文件
+         参数：
+           path：    文件路径；已存在时被覆盖
+         返回值：写入的记录数量
+        */
+        size_t dump(const string& path) const throw (std::logic_error);
+
+        /**
+         描述：登记本记录器，进程收到SIGSEGV、SIGBUS、SIGFPE、SIGILL或SIGABRT时(包括未捕获的异常)
+              先导出到文件再按默认方式结束；同一时刻只有一个记录器被登记，后登记的替换先登记的
+         参数：
+           path：    文件路径
+         返回值：无
+        */
+        void dumpOnFatal(const string& path);
+
+        /**
+         描述：获取进程级记录器；状态机默认记录到该记录器
+         参数：无
+         返回值：记录器
+        */
+        static Xyh_Recorder* global();
+
+        /**
+         描述：按顺序读取导出文件中的记录
+         参数：
+           path：    文件路径
+           visitor： 每条记录的回调
+         返回值：记录数量；文件格式不正确时抛出异常
+        */
+        static size_t read(const string& path, Visitor visitor) throw (std::logic_error);
+
+        /**
+         描述：获取记录类型的名称
+        */
+        static const char* kindName(unsigned char kind);
+
+    private:
+        Xyh_Recorder(const Xyh_Recorder&);
+        Xyh_Recorder& operator=(const Xyh_Recorder&);
+
+        /**
+         说明：单个线程的环形缓冲区
+        */
+        struct _Ring {
+            //下一个缓冲区
+            _Ring* next;
+
+            //所属线程的标识
+            const void* thread;
+
+            //线程序号，按创建顺序从0开始
+            unsigned int index;
+
+            //已写入的记录总数；只由所属线程增加
+            boost::atomic<unsigned long long> head;
+
+            //记录
+            boost::scoped_array<Entry> entries;
+        };
+
+        /**
+         描述：获取当前线程的缓冲区，没有时创建
+        */
+        _Ring* attach();
+
+        /**
+         描述：不分配内存地将所有缓冲区写入文件描述符；用于信号处理函数
+        */
+        void dumpRaw(int fd) const;
+
+        static void onFatal(int sig);
+
+    private:
+        //每个线程的记录数量与下标掩码
+        size_t m_capacity;
+        size_t m_mask;
+
+        //进程内唯一的记录器序号，用于线程本地缓存
+        unsigned long long m_serial;
+
+        //所有线程的缓冲区；只在头部插入，析构前不删除
+        boost::atomic<_Ring*> m_rings;
+
+        //已创建的缓冲区数量
+        boost::atomic<unsigned int> m_ringCount;
+    };
+
+} //namespace XYH_StatusMachine
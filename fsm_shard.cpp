@@ -0,0 +1,149 @@
+﻿//local
+#include "fsm_shard.h"
+//boost
+#include "boost/bind.hpp"
+
+namespace XYH_StatusMachine {
+
+    Xyh_ShardedJsm::Xyh_ShardedJsm(unsigned int id, unsigned int shards, TopologyBuilder builder,
+        size_t capacity, size_t highWater) :
+        m_rejected(0),
+        m_started(false) {
+
+        if (!shards) {
+            shards = boost::thread::hardware_concurrency();
+        }
+        if (!shards) {
+            shards = 1;
+        }
+
+        //拓扑只构建一次，各分片只分配自己的事件表与定时
+        shared_ptr<Xyh_Definition> definition(new Xyh_Definition);
+        builder(*definition);
+        definition->freeze();
+
+        for (unsigned int i = 0; i < shards; i++) {
+            shared_ptr<Shard> s(new Shard);
+            s->work.reset(new boost::asio::io_service::work(s->io));
+            s->jsm.reset(new Xyh_Jsm(id, s->io, definition));
+            s->jsm->enableIngress(capacity, highWater);
+            m_shards.push_back(s);
+        }
+    }
+
+    Xyh_ShardedJsm::~Xyh_ShardedJsm() {
+        stop();
+    }
+
+    void Xyh_ShardedJsm::start() {
+        if (m_started) {
+            return;
+        }
+        m_started = true;
+
+        BOOST_FOREACH(shared_ptr<Shard>& s, m_shards) {
+            boost::asio::io_service& io = s->io;
+            s->thread = boost::thread(boost::bind(&boost::asio::io_service::run, &io));
+        }
+    }
+
+    void Xyh_ShardedJsm::stop() {
+        BOOST_FOREACH(shared_ptr<Shard>& s, m_shards) {
+            if (s->work) {
+                s->jsm->submitCall(boost::bind(&Xyh_Jsm::stop, _1));
+                s->work.reset();
+            }
+        }
+
+        BOOST_FOREACH(shared_ptr<Shard>& s, m_shards) {
+            if (s->thread.joinable()) {
+                s->thread.join();
+            }
+        }
+    }
+
+    void Xyh_ShardedJsm::addEvent(shared_ptr<Xyh_Event> e) {
+        m_shards[shardOf(e->getId())]->jsm->submitCall(
+            boost::bind(&Xyh_ShardedJsm::doAdd, this, _1, e, 0, 0, (const void*)0, false));
+    }
+
+    void Xyh_ShardedJsm::addEvent(shared_ptr<Xyh_Event> e, unsigned int status, unsigned int signal, const void* msg) {
+        m_shards[shardOf(e->getId())]->jsm->submitCall(
+            boost::bind(&Xyh_ShardedJsm::doAdd, this, _1, e, status, signal, msg, true));
+    }
+
+    void Xyh_ShardedJsm::relEvent(unsigned int id) {
+        m_shards[shardOf(id)]->jsm->submitCall(boost::bind(&Xyh_ShardedJsm::doRel, this, _1, id));
+    }
+
+    void Xyh_ShardedJsm::expireEvent(unsigned int id) {
+        m_shards[shardOf(id)]->jsm->submitCall(boost::bind(&Xyh_ShardedJsm::doExpire, this, _1, id));
+    }
+
+    Xyh_Result Xyh_ShardedJsm::digestion(unsigned int event, unsigned int signal, const void* msg) {
+        return m_shards[shardOf(event)]->jsm->submitDigestion(event, signal, msg);
+    }
+
+    Xyh_Result Xyh_ShardedJsm::process(unsigned int event, unsigned int signal, const void* msg) {
+        return m_shards[shardOf(event)]->jsm->submit(event, signal, msg);
+    }
+
+    void Xyh_ShardedJsm::process(unsigned int signal, const void* msg) {
+        BOOST_FOREACH(shared_ptr<Shard>& s, m_shards) {
+            s->jsm->submitCall(boost::bind(&Xyh_ShardedJsm::doBroadcast, this, _1, signal, msg));
+        }
+    }
+
+    void Xyh_ShardedJsm::doAdd(Xyh_Jsm& jsm, shared_ptr<Xyh_Event> e, unsigned int status, unsigned int signal, const void* msg, bool place) {
+        jsm.addEvent(e);
+        if (!place) {
+            return;
+        }
+
+        shared_ptr<Xyh_Status> st = jsm.findStatus(status);
+        if (!st) {
+            m_rejected.fetch_add(1, boost::memory_order_relaxed);
+            return;
+        }
+
+        //处理函数抛出的任何异常都不能逃出分片线程
+        try {
+            e->place(st, signal, msg);
+        }
+        catch (std::exception&) {
+            m_rejected.fetch_add(1, boost::memory_order_relaxed);
+        }
+        catch (...) {
+            m_rejected.fetch_add(1, boost::memory_order_relaxed);
+        }
+    }
+
+    void Xyh_ShardedJsm::doRel(Xyh_Jsm& jsm, unsigned int id) {
+        jsm.relEvent(id);
+    }
+
+    void Xyh_ShardedJsm::doExpire(Xyh_Jsm& jsm, unsigned int id) {
+        jsm.expireEvent(id);
+    }
+
+    unsigned long long Xyh_ShardedJsm::rejected() const {
+        unsigned long long n = m_rejected.load(boost::memory_order_relaxed);
+        BOOST_FOREACH(const shared_ptr<Shard>& s, m_shards) {
+            n += s->jsm->ingressRejected();
+        }
+        return n;
+    }
+
+    unsigned long long Xyh_ShardedJsm::busy() const {
+        unsigned long long n = 0;
+        BOOST_FOREACH(const shared_ptr<Shard>& s, m_shards) {
+            n += s->jsm->ingressBusy();
+        }
+        return n;
+    }
+
+    void Xyh_ShardedJsm::doBroadcast(Xyh_Jsm& jsm, unsigned int signal, const void* msg) {
+        jsm.process(signal, msg);
+    }
+
+} //namespace XYH_StatusMachine
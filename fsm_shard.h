@@ -0,0 +1,202 @@
+﻿#pragma once
+//local
+#include "fsm.h"
+//boost
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/scoped_ptr.hpp>
+
+namespace XYH_StatusMachine {
+
+    /**
+     描述：拓扑构建函数；向状态机定义添加状态和转移路线，只调用一次
+    */
+    typedef boost::function<void(Xyh_Definition&)> TopologyBuilder;
+
+    /**
+     说明：分片状态机；
+          按事件id将事件分配到N个分片，每个分片拥有独立的线程、io_service、事件表、
+          状态事件列表和定时器，分片之间互不加锁；
+          所有分片共享同一个冻结的状态机定义，状态的处理函数会在多个分片线程上并发调用，
+          必须线程安全；事件的增删与信号都经由分片状态机的无锁入口队列投递到
+          事件所属的分片异步处理，同一生产者提交的操作与信号按提交顺序处理
+    */
+    class Xyh_ShardedJsm {
+    public:
+        /**
+         描述：构造函数
+         参数：
+           id：      全局唯一的状态机id
+           shards：  分片数量，为0时使用硬件线程数
+           builder： 拓扑构建函数；构建的定义被冻结后由所有分片共享
+           capacity：每个分片入口队列的容量
+           highWater：每个分片入口队列的高水位，为0时等于容量
+         返回值：无
+        */
+        Xyh_ShardedJsm(unsigned int id, unsigned int shards, TopologyBuilder builder,
+            size_t capacity = 65536, size_t highWater = 0);
+
+        /**
+         描述：析构函数；停止所有分片并等待线程退出
+        */
+        ~Xyh_ShardedJsm();
+
+        /**
+         描述：启动所有分片线程
+         参数：无
+         返回值：无
+        */
+        void start();
+
+        /**
+         描述：停止所有分片；已提交的操作与信号处理完毕后线程退出
+         参数：无
+         返回值：无
+        */
+        void stop();
+
+        /**
+         描述：添加事件到所属分片
+         参数：
+           e：事件
+         返回值：无
+         说明：以下增删事件的操作与信号经同一入口队列按提交顺序处理，不受高水位限制；
+              队列已满时等待分片线程取走记录，因此不能在分片线程上调用，
+              分片启动前提交的操作与信号总数不能超过队列容量
+        */
+        void addEvent(shared_ptr<Xyh_Event> e);
+
+        /**
+         描述：添加事件到所属分片，并将事件加入指定状态
+         参数：
+           e：       事件
+           status：  状态id
+           signal：  驱动本次操作的信号
+           msg：     附加信息
+         返回值：无；状态不存在或放入时抛出异常(包括处理函数抛出的任何异常)时计入rejected
+        */
+        void addEvent(shared_ptr<Xyh_Event> e, unsigned int status, unsigned int signal, const void* msg);
+
+        /**
+         描述：删除事件
+         参数：
+           id：事件id
+         返回值：无
+        */
+        void relEvent(unsigned int id);
+
+        /**
+         描述：标记事件即将过期
+         参数：
+           id：事件id
+         返回值：无
+        */
+        void expireEvent(unsigned int id);
+
+        /**
+         描述：异步驱动指定事件处理信号，语义同Xyh_Jsm::digestion；
+              msg须在信号被处理前保持有效；无法处理的信号计入rejected
+         参数：
+           event:   事件id
+           signal:  信号
+           msg:     附加信息
+         返回值：入队成功返回RES_OK；分片入口队列达到高水位返回RES_BUSY
+        */
+        Xyh_Result digestion(unsigned int event, unsigned int signal, const void* msg);
+
+        /**
+         描述：异步驱动指定事件处理信号，语义同Xyh_Jsm::process；
+              msg须在信号被处理前保持有效；无法处理的信号计入rejected
+         参数：
+           event:   事件id
+           signal:  信号
+           msg:     附加信息
+         返回值：入队成功返回RES_OK；分片入口队列达到高水位返回RES_BUSY
+        */
+        Xyh_Result process(unsigned int event, unsigned int signal, const void* msg);
+
+        /**
+         描述：异步广播信号到所有分片，语义同Xyh_Jsm::process(signal, msg)
+         参数：
+           signal：  信号
+           msg：     附加信息
+         返回值：无
+        */
+        void process(unsigned int signal, const void* msg);
+
+        /**
+         描述：获取事件所属的分片
+         参数：
+           event：事件id
+         返回值：分片下标
+        */
+        unsigned int shardOf(unsigned int event) const { return event % (unsigned int)m_shards.size(); }
+
+        /**
+         描述：获取分片数量
+         参数：无
+         返回值：分片数量
+        */
+        unsigned int shards() const { return (unsigned int)m_shards.size(); }
+
+        /**
+         描述：获取分片的状态机；只能在该分片的线程上访问
+         参数：
+           i：分片下标
+         返回值：状态机
+        */
+        Xyh_Jsm& shard(unsigned int i) { return *m_shards[i]->jsm; }
+
+        /**
+         描述：获取分片的io_service，可用于向分片线程投递任务
+         参数：
+           i：分片下标
+         返回值：io_service
+        */
+        boost::asio::io_service& service(unsigned int i) { return m_shards[i]->io; }
+
+        /**
+         描述：获取因事件不存在或没有转移路线而未能处理的信号数量
+         参数：无
+         返回值：信号数量
+        */
+        unsigned long long rejected() const;
+
+        /**
+         描述：获取因分片入口队列达到高水位而被拒绝的提交次数
+         参数：无
+         返回值：提交次数
+        */
+        unsigned long long busy() const;
+
+    private:
+        Xyh_ShardedJsm(const Xyh_ShardedJsm&);
+        Xyh_ShardedJsm& operator=(const Xyh_ShardedJsm&);
+
+        struct Shard {
+            boost::asio::io_service io;
+            boost::scoped_ptr<boost::asio::io_service::work> work;
+            boost::scoped_ptr<Xyh_Jsm> jsm;
+            boost::thread thread;
+        };
+
+        /**
+         描述：以下方法在分片线程上执行
+        */
+        void doAdd(Xyh_Jsm& jsm, shared_ptr<Xyh_Event> e, unsigned int status, unsigned int signal, const void* msg, bool place);
+        void doRel(Xyh_Jsm& jsm, unsigned int id);
+        void doExpire(Xyh_Jsm& jsm, unsigned int id);
+        void doBroadcast(Xyh_Jsm& jsm, unsigned int signal, const void* msg);
+
+    private:
+        //所有分片
+        vector<shared_ptr<Shard> > m_shards;
+
+        //加入状态失败的事件数量；分片信号的拒绝数量由各分片的入口队列统计
+        boost::atomic<unsigned long long> m_rejected;
+
+        //是否已启动
+        bool m_started;
+    };
+
+} //namespace XYH_StatusMachine
@@ -0,0 +1,448 @@
+﻿#pragma once
+//local
+#include "fsm.h"
+#include "fsm_journal.h"
+//boost
+#include <boost/mpl/deref.hpp>
+#include <boost/mpl/next.hpp>
+#include <boost/mpl/size.hpp>
+#include <boost/mpl/vector.hpp>
+#include <boost/mpl/begin_end.hpp>
+#include <boost/static_assert.hpp>
+
+namespace XYH_StatusMachine {
+
+    /**
+     说明：编译期状态声明
+     参数：
+       Id：  状态id；状态机内唯一
+       Fade：状态是否允许回收事件，同Xyh_Status的fade
+    */
+    template <unsigned int Id, bool Fade = false>
+    struct Xyh_State {
+        static const unsigned int id = Id;
+        static const bool fade = Fade;
+    };
+
+    /**
+     说明：编译期转移路线声明；From与To相同时为自环路线
+     参数：
+       From：  起始状态id
+       Signal：触发信号
+       To：    目的状态id
+    */
+    template <unsigned int From, unsigned int Signal, unsigned int To>
+    struct Xyh_Link {
+        static const unsigned int from = From;
+        static const unsigned int signal = Signal;
+        static const unsigned int to = To;
+    };
+
+    /**
+     说明：编译期定时声明，同Xyh_Status::regularMs
+     参数：
+       State： 状态id
+       Label： 超时调用timeout时传递的信号参数
+       Period：超时时长，单位为ms
+    */
+    template <unsigned int State, unsigned int Label, unsigned long long Period>
+    struct Xyh_Timeout {
+        static const unsigned int state = State;
+        static const unsigned int label = Label;
+        static const unsigned long long period = Period;
+    };
+
+    /**
+     说明：状态标签；用于按状态重载信号处理函数与超时处理函数
+    */
+    template <unsigned int Id>
+    struct Xyh_StateTag {
+        static const unsigned int id = Id;
+    };
+
+    namespace _Static {
+        using boost::mpl::deref;
+        using boost::mpl::next;
+
+        //状态在列表中的下标；不存在时为-1
+        template <class It, class End, unsigned int Id, int N = 0>
+        struct IndexOf {
+            static const int value = (deref<It>::type::id == Id) ? N :
+                IndexOf<typename next<It>::type, End, Id, N + 1>::value;
+        };
+
+        template <class End, unsigned int Id, int N>
+        struct IndexOf<End, End, Id, N> {
+            static const int value = -1;
+        };
+
+        //起始状态与信号都相同的路线数量
+        template <class It, class End, unsigned int From, unsigned int Signal>
+        struct LinkCount {
+            typedef typename deref<It>::type L;
+            static const int value = (L::from == From && L::signal == Signal ? 1 : 0) +
+                LinkCount<typename next<It>::type, End, From, Signal>::value;
+        };
+
+        template <class End, unsigned int From, unsigned int Signal>
+        struct LinkCount<End, End, From, Signal> {
+            static const int value = 0;
+        };
+
+        //使用指定信号的路线数量
+        template <class It, class End, unsigned int Signal>
+        struct SignalCount {
+            static const int value = (deref<It>::type::signal == Signal ? 1 : 0) +
+                SignalCount<typename next<It>::type, End, Signal>::value;
+        };
+
+        template <class End, unsigned int Signal>
+        struct SignalCount<End, End, Signal> {
+            static const int value = 0;
+        };
+
+        //指定起始状态与信号的目的状态；found为false时没有该路线
+        template <class It, class End, unsigned int From, unsigned int Signal>
+        struct Target {
+            typedef typename deref<It>::type L;
+            typedef Target<typename next<It>::type, End, From, Signal> Rest;
+            static const bool hit = (L::from == From && L::signal == Signal);
+            static const bool found = hit || Rest::found;
+            static const unsigned int to = hit ? L::to : Rest::to;
+        };
+
+        template <class End, unsigned int From, unsigned int Signal>
+        struct Target<End, End, From, Signal> {
+            static const bool found = false;
+            static const unsigned int to = 0;
+        };
+
+        //校验所有路线：起止状态均已声明，且同一状态上一个信号只有一条路线
+        template <class It, class End, class SBegin, class SEnd>
+        struct CheckLinks : CheckLinks<typename next<It>::type, End, SBegin, SEnd> {
+            typedef typename deref<It>::type L;
+            BOOST_STATIC_ASSERT((IndexOf<SBegin, SEnd, L::from>::value >= 0));
+            BOOST_STATIC_ASSERT((IndexOf<SBegin, SEnd, L::to>::value >= 0));
+            BOOST_STATIC_ASSERT((LinkCount<It, End, L::from, L::signal>::value == 1));
+        };
+
+        template <class End, class SBegin, class SEnd>
+        struct CheckLinks<End, End, SBegin, SEnd> { };
+
+        //校验所有定时：所在状态已声明
+        template <class It, class End, class SBegin, class SEnd>
+        struct CheckTimeouts : CheckTimeouts<typename next<It>::type, End, SBegin, SEnd> {
+            BOOST_STATIC_ASSERT((IndexOf<SBegin, SEnd, deref<It>::type::state>::value >= 0));
+        };
+
+        template <class End, class SBegin, class SEnd>
+        struct CheckTimeouts<End, End, SBegin, SEnd> { };
+
+        /**
+         说明：编译期状态对应的运行期状态；虚函数转发到状态机的静态处理函数，
+              供process、批量处理、广播等按运行期转移表驱动的路径使用
+        */
+        template <class Machine, class S>
+        class Status : public Xyh_Status {
+        public:
+            explicit Status(Machine* m) : Xyh_Status(S::id, "", S::fade), m_derived(m) { }
+
+            virtual void routine(shared_ptr<Xyh_Event>& e, unsigned int label, const void* msg) {
+                m_derived->routine(Xyh_StateTag<S::id>(), *e, label, msg);
+            }
+
+            virtual void timerRoutine(unsigned int label, shared_ptr<Xyh_Event>& e) {
+                m_derived->timeout(Xyh_StateTag<S::id>(), *e, label);
+            }
+
+        private:
+            Machine* m_derived;
+        };
+
+        //创建所有运行期状态
+        template <class Machine, class It, class End, int N = 0>
+        struct MakeStates {
+            static void run(Machine* m, vector<shared_ptr<Xyh_Status> >& states) {
+                states[N].reset(new Status<Machine, typename deref<It>::type>(m));
+                MakeStates<Machine, typename next<It>::type, End, N + 1>::run(m, states);
+            }
+        };
+
+        template <class Machine, class End, int N>
+        struct MakeStates<Machine, End, End, N> {
+            static void run(Machine*, vector<shared_ptr<Xyh_Status> >&) { }
+        };
+
+        //设置所有运行期转移路线
+        template <class It, class End, class SBegin, class SEnd>
+        struct MakeLinks {
+            static void run(vector<shared_ptr<Xyh_Status> >& states) {
+                typedef typename deref<It>::type L;
+                shared_ptr<Xyh_Status>& from = states[IndexOf<SBegin, SEnd, L::from>::value];
+                if (L::from == L::to) {
+                    from->addLink(L::signal);
+                }
+                else {
+                    from->addLink(L::signal, states[IndexOf<SBegin, SEnd, L::to>::value]);
+                }
+                MakeLinks<typename next<It>::type, End, SBegin, SEnd>::run(states);
+            }
+        };
+
+        template <class End, class SBegin, class SEnd>
+        struct MakeLinks<End, End, SBegin, SEnd> {
+            static void run(vector<shared_ptr<Xyh_Status> >&) { }
+        };
+
+        //设置所有运行期定时
+        template <class It, class End, class SBegin, class SEnd>
+        struct MakeTimeouts {
+            static void run(vector<shared_ptr<Xyh_Status> >& states) {
+                typedef typename deref<It>::type T;
+                states[IndexOf<SBegin, SEnd, T::state>::value]->regularMs(T::label, T::period);
+                MakeTimeouts<typename next<It>::type, End, SBegin, SEnd>::run(states);
+            }
+        };
+
+        template <class End, class SBegin, class SEnd>
+        struct MakeTimeouts<End, End, SBegin, SEnd> {
+            static void run(vector<shared_ptr<Xyh_Status> >&) { }
+        };
+
+        //编译期信号：只展开使用该信号的路线，逐条比较起始状态
+        template <class Machine, class It, class End, unsigned int Signal>
+        struct Fire;
+
+        template <class Machine, class It, class End, unsigned int Signal, bool Match>
+        struct FireIf {
+            static bool run(Machine& m, Xyh_Event& e, unsigned int from, const void* msg) {
+                typedef typename deref<It>::type L;
+                if (from == L::from) {
+                    m.template transit<L>(e, msg);
+                    return true;
+                }
+                return Fire<Machine, typename next<It>::type, End, Signal>::run(m, e, from, msg);
+            }
+        };
+
+        template <class Machine, class It, class End, unsigned int Signal>
+        struct FireIf<Machine, It, End, Signal, false> {
+            static bool run(Machine& m, Xyh_Event& e, unsigned int from, const void* msg) {
+                return Fire<Machine, typename next<It>::type, End, Signal>::run(m, e, from, msg);
+            }
+        };
+
+        template <class Machine, class It, class End, unsigned int Signal>
+        struct Fire {
+            static bool run(Machine& m, Xyh_Event& e, unsigned int from, const void* msg) {
+                return FireIf<Machine, It, End, Signal, deref<It>::type::signal == Signal>::run(m, e, from, msg);
+            }
+        };
+
+        template <class Machine, class End, unsigned int Signal>
+        struct Fire<Machine, End, End, Signal> {
+            static bool run(Machine&, Xyh_Event&, unsigned int, const void*) { return false; }
+        };
+
+        //运行期信号：逐条比较起始状态与信号
+        template <class Machine, class It, class End>
+        struct FireAny {
+            static bool run(Machine& m, Xyh_Event& e, unsigned int from, unsigned int signal, const void* msg) {
+                typedef typename deref<It>::type L;
+                if (from == L::from && signal == L::signal) {
+                    m.template transit<L>(e, msg);
+                    return true;
+                }
+                return FireAny<Machine, typename next<It>::type, End>::run(m, e, from, signal, msg);
+            }
+        };
+
+        template <class Machine, class End>
+        struct FireAny<Machine, End, End> {
+            static bool run(Machine&, Xyh_Event&, unsigned int, unsigned int, const void*) { return false; }
+        };
+    } //namespace _Static
+
+
+    /**
+     说明：查询编译期转移路线；found为false时没有该路线，否则to为目的状态id。
+          可配合BOOST_STATIC_ASSERT在编译期拒绝无效转移
+    */
+    template <class Links, unsigned int From, unsigned int Signal>
+    struct Xyh_StaticTarget : _Static::Target<typename boost::mpl::begin<Links>::type,
+        typename boost::mpl::end<Links>::type, From, Signal> { };
+
+
+    /**
+     说明：编译期定义的状态机；
+          States、Links、Timeouts分别为Xyh_State、Xyh_Link、Xyh_Timeout的boost::mpl序列，
+          路线的起止状态未声明、同一状态上一个信号有多条路线、定时所在状态未声明时编译失败。
+          构造时按声明生成运行期状态、转移路线与定时并执行freeze，事件登记、定时、批量处理、
+          广播等仍由Xyh_Jsm完成；fire按编译期生成的比较链转移并直接调用派生类的处理函数，
+          不经过转移表与虚函数。
+          派生类Derived以如下成员函数处理各状态，未声明的状态使用基类的空实现
+          （派生类需using Base::routine、using Base::timeout）：
+            void routine(Xyh_StateTag<Id>, Xyh_Event& e, unsigned int signal, const void* msg);
+            void timeout(Xyh_StateTag<Id>, Xyh_Event& e, unsigned int label);
+    */
+    template <class Derived, class States, class Links, class Timeouts = boost::mpl::vector0<> >
+    class Xyh_StaticJsm : public Xyh_Jsm {
+        typedef typename boost::mpl::begin<States>::type SBegin;
+        typedef typename boost::mpl::end<States>::type SEnd;
+        typedef typename boost::mpl::begin<Links>::type LBegin;
+        typedef typename boost::mpl::end<Links>::type LEnd;
+        typedef typename boost::mpl::begin<Timeouts>::type TBegin;
+        typedef typename boost::mpl::end<Timeouts>::type TEnd;
+
+        template <class M, class It, class End, unsigned int Signal, bool Match> friend struct _Static::FireIf;
+        template <class M, class It, class End> friend struct _Static::FireAny;
+
+    public:
+        /**
+         描述：构造函数；生成运行期状态、转移路线与定时并冻结状态机
+         参数：
+           id：          状态机id
+           io_service：  状态机使用的io_service
+         返回值：无
+        */
+        Xyh_StaticJsm(unsigned int id, boost::asio::io_service& io_service) : Xyh_Jsm(id, io_service) {
+            (void)sizeof(_Static::CheckLinks<LBegin, LEnd, SBegin, SEnd>);
+            (void)sizeof(_Static::CheckTimeouts<TBegin, TEnd, SBegin, SEnd>);
+
+            m_states.resize(boost::mpl::size<States>::value);
+            _Static::MakeStates<Derived, SBegin, SEnd>::run(static_cast<Derived*>(this), m_states);
+            _Static::MakeLinks<LBegin, LEnd, SBegin, SEnd>::run(m_states);
+            _Static::MakeTimeouts<TBegin, TEnd, SBegin, SEnd>::run(m_states);
+
+            for (size_t i = 0; i < m_states.size(); i++) {
+                addStatus(m_states[i]);
+            }
+            freeze();
+        }
+
+        /**
+         描述：获取编译期声明的状态对应的运行期状态；未声明的状态编译失败
+         参数：无
+         返回值：运行期状态
+        */
+        template <unsigned int Id>
+        shared_ptr<Xyh_Status>& status() {
+            BOOST_STATIC_ASSERT((_Static::IndexOf<SBegin, SEnd, Id>::value >= 0));
+            return m_states[_Static::IndexOf<SBegin, SEnd, Id>::value];
+        }
+
+        /**
+         描述：驱动句柄指定的事件处理编译期信号，语义同tryProcess；
+              没有任何路线使用该信号时编译失败
+         参数：
+           event：   事件句柄
+           msg：     附加信息
+         返回值：RES_OK、RES_NO_EVENT、RES_EXPIRED、RES_NO_ROUTE；事件的异步处理函数挂起中时
+              信号排队并返回RES_DEFERRED
+        */
+        template <unsigned int Signal>
+        Xyh_Result fire(Xyh_Handle event, const void* msg) {
+            BOOST_STATIC_ASSERT((_Static::SignalCount<LBegin, LEnd, Signal>::value > 0));
+
+            Xyh_Event* e = eventOf(event);
+            if (!e) {
+                reject(RES_NO_EVENT, 0, Signal);
+                return RES_NO_EVENT;
+            }
+
+            Xyh_Status* cur = e->currentStatus();
+            if (e->expired()) {
+                reject(RES_EXPIRED, cur, Signal);
+                return RES_EXPIRED;
+            }
+
+            journal(Xyh_Journal::REC_PROCESS, e->getId(), Signal, 0, msg);
+            _JournalScope scope(this);
+            if (e->suspended()) {
+                defer(*e, Signal, msg, false, 0);
+                return RES_DEFERRED;
+            }
+            if (!cur || !_Static::Fire<Xyh_StaticJsm, LBegin, LEnd, Signal>::run(*this, *e, cur->getId(), msg)) {
+                reject(RES_NO_ROUTE, cur, Signal);
+                return RES_NO_ROUTE;
+            }
+            return RES_OK;
+        }
+
+        /**
+         描述：驱动句柄指定的事件处理运行期信号；除信号在运行期给出外与fire<Signal>相同
+         参数：
+           event：   事件句柄
+           signal：  信号
+           msg：     附加信息
+         返回值：同fire<Signal>
+        */
+        Xyh_Result fire(Xyh_Handle event, unsigned int signal, const void* msg) {
+            Xyh_Event* e = eventOf(event);
+            if (!e) {
+                reject(RES_NO_EVENT, 0, signal);
+                return RES_NO_EVENT;
+            }
+
+            Xyh_Status* cur = e->currentStatus();
+            if (e->expired()) {
+                reject(RES_EXPIRED, cur, signal);
+                return RES_EXPIRED;
+            }
+
+            journal(Xyh_Journal::REC_PROCESS, e->getId(), signal, 0, msg);
+            _JournalScope scope(this);
+            if (e->suspended()) {
+                defer(*e, signal, msg, false, 0);
+                return RES_DEFERRED;
+            }
+            if (!cur || !_Static::FireAny<Xyh_StaticJsm, LBegin, LEnd>::run(*this, *e, cur->getId(), signal, msg)) {
+                reject(RES_NO_ROUTE, cur, signal);
+                return RES_NO_ROUTE;
+            }
+            return RES_OK;
+        }
+
+        /**
+         描述：默认信号处理函数，不做任何处理
+        */
+        template <unsigned int Id>
+        void routine(Xyh_StateTag<Id>, Xyh_Event& e, unsigned int signal, const void* msg) { }
+
+        /**
+         描述：默认超时处理函数，不做任何处理
+        */
+        template <unsigned int Id>
+        void timeout(Xyh_StateTag<Id>, Xyh_Event& e, unsigned int label) { }
+
+    private:
+        /**
+         描述：按编译期路线转移事件并直接调用派生类的信号处理函数
+         参数：
+           e：   事件
+           msg： 附加信息
+         返回值：无
+        */
+        template <class L>
+        void transit(Xyh_Event& e, const void* msg) {
+            //持有事件的引用，防止信号处理函数中删除事件
+            shared_ptr<Xyh_Event> self = e.shared_from_this();
+            if (!e.enter(m_states[_Static::IndexOf<SBegin, SEnd, L::to>::value], L::signal)) {
+                return;
+            }
+
+            Xyh_Metrics* metrics = liveMetrics();
+            unsigned long long start = metrics ? Xyh_Metrics::now() : 0;
+            static_cast<Derived*>(this)->routine(Xyh_StateTag<L::to>(), e, L::signal, msg);
+            if (metrics) {
+                metrics->routine(m_states[_Static::IndexOf<SBegin, SEnd, L::to>::value]->getIndex(),
+                    Xyh_Metrics::now() - start);
+            }
+        }
+
+    private:
+        //运行期状态，按States中的声明顺序存放
+        vector<shared_ptr<Xyh_Status> > m_states;
+    };
+
+} //namespace XYH_StatusMachine
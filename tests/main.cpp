@@ -0,0 +1,79 @@
+﻿//local
+#include "test.h"
+//std
+#include <cstring>
+#include <exception>
+
+namespace XYH_StatusMachine {
+    namespace Test {
+
+        namespace {
+            struct Entry {
+                const char* group;
+                const char* name;
+                Case run;
+            };
+
+            vector<Entry>& registry() {
+                static vector<Entry> cases;
+                return cases;
+            }
+
+            //当前用例的失败次数
+            unsigned int g_failures = 0;
+        }
+
+        Registrar::Registrar(const char* group, const char* name, Case run) {
+            Entry e = { group, name, run };
+            registry().push_back(e);
+        }
+
+        void fail(const char* file, int line, const char* expr) {
+            std::fprintf(stderr, "  %s:%d: check failed: %s\n", file, line, expr);
+            g_failures++;
+        }
+
+        std::string tempPath(const char* name) {
+            std::string path = std::string("jsm_test.") + name;
+            std::remove(path.c_str());
+            std::remove((path + ".tmp").c_str());
+            return path;
+        }
+
+    } //namespace Test
+} //namespace XYH_StatusMachine
+
+using namespace XYH_StatusMachine::Test;
+
+int main(int argc, char* argv[]) {
+    const char* group = argc > 1 ? argv[1] : 0;
+
+    unsigned int run = 0;
+    unsigned int failed = 0;
+    for (size_t i = 0; i < registry().size(); i++) {
+        const Entry& c = registry()[i];
+        if (group && 0 != std::strcmp(group, c.group)) {
+            continue;
+        }
+
+        g_failures = 0;
+        try {
+            c.run();
+        }
+        catch (std::exception& e) {
+            fail(c.group, 0, e.what());
+        }
+        run++;
+        if (g_failures) {
+            failed++;
+        }
+        std::fprintf(stderr, "%-6s %s.%s\n", g_failures ? "FAIL" : "ok", c.group, c.name);
+    }
+
+    if (!run) {
+        std::fprintf(stderr, "no test case in group(%s)\n", group ? group : "");
+        return 1;
+    }
+    std::fprintf(stderr, "%u of %u cases failed\n", failed, run);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+﻿#pragma once
+//local
+#include "fsm.h"
+#include "fsm_clock.h"
+//std
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ 说明：行为测试；
+      用例以JSM_TEST(组, 名称)定义并在启动时登记，jsm_tests不带参数时执行所有用例，
+      带参数时只执行指定组的用例；任一检查失败时返回非0
+*/
+namespace XYH_StatusMachine {
+    namespace Test {
+
+        typedef void (*Case)();
+
+        /**
+         说明：用例登记；在静态初始化期间加入用例列表
+        */
+        struct Registrar {
+            Registrar(const char* group, const char* name, Case run);
+        };
+
+        /**
+         描述：记录一次检查失败
+         参数：
+           file：    源文件
+           line：    行号
+           expr：    检查的表达式
+         返回值：无
+        */
+        void fail(const char* file, int line, const char* expr);
+
+        //测试状态机使用的信号
+        enum {
+            SIG_GO      = 1,    //A -> B
+            SIG_BACK    = 2,    //B -> A
+            SIG_SELF    = 3,    //A、B上的自环
+            SIG_TIMEOUT = 4,    //B上的定时标签
+            SIG_UNKNOWN = 9     //没有任何路线使用
+        };
+
+        /**
+         说明：计数状态；记录信号处理函数与超时处理函数的调用
+        */
+        class CountStatus : public Xyh_Status {
+        public:
+            CountStatus(unsigned int id, bool fade = false) :
+                Xyh_Status(id, "count", fade), routines(0), timers(0), lastLabel(0) { }
+
+            virtual void routine(shared_ptr<Xyh_Event>& e, unsigned int label, const void* msg) {
+                routines++;
+                lastLabel = label;
+            }
+
+            virtual void timerRoutine(unsigned int label, shared_ptr<Xyh_Event>& e) {
+                timers++;
+                lastLabel = label;
+            }
+
+            unsigned long long routines;
+            unsigned long long timers;
+            unsigned int lastLabel;
+        };
+
+        /**
+         说明：A、B两个计数状态的状态机，B上可设置定时；C为没有路线的回收状态
+        */
+        struct Machine {
+            boost::asio::io_service io;
+            Xyh_Jsm jsm;
+            shared_ptr<Xyh_Status> a;
+            shared_ptr<Xyh_Status> b;
+            shared_ptr<Xyh_Status> c;
+            shared_ptr<Xyh_VirtualClock> clock;
+
+            explicit Machine(unsigned long long timeoutMs = 0, bool frozen = true) :
+                jsm(1, io),
+                a(new CountStatus(1)),
+                b(new CountStatus(2)),
+                c(new CountStatus(3, true)) {
+                a->addLink(SIG_GO, b);
+                a->addLink(SIG_SELF);
+                b->addLink(SIG_BACK, a);
+                b->addLink(SIG_SELF);
+                if (timeoutMs) {
+                    b->regularMs(SIG_TIMEOUT, timeoutMs);
+                }
+                jsm.addStatus(a);
+                jsm.addStatus(b);
+                jsm.addStatus(c);
+                if (frozen) {
+                    jsm.freeze();
+                }
+            }
+
+            /**
+             描述：改用虚拟时钟，之后的时间只随clock推进
+            */
+            void virtualTime() {
+                clock.reset(new Xyh_VirtualClock);
+                jsm.useClock(clock);
+            }
+
+            /**
+             描述：创建事件并放入指定状态
+             参数：
+               id：  事件id
+               s：   状态；为空时只加入状态机
+             返回值：事件句柄
+            */
+            Xyh_Handle add(unsigned int id, shared_ptr<Xyh_Status> s) {
+                shared_ptr<Xyh_Event> e = jsm.createEvent(id, "");
+                Xyh_Handle h = jsm.addEvent(e);
+                if (s) {
+                    e->place(s, 0, 0);
+                }
+                return h;
+            }
+
+            /**
+             描述：获取事件当前所在状态的id；事件不存在或未放入状态时返回NO_STATUS
+            */
+            unsigned int where(unsigned int id) {
+                shared_ptr<Xyh_Event> e = jsm.findEvent(id);
+                return (e && e->getCurrentStatus()) ? e->getCurrentStatus()->getId() : Xyh_Jsm::NO_STATUS;
+            }
+
+            CountStatus& count(shared_ptr<Xyh_Status>& s) { return (CountStatus&)*s; }
+        };
+
+        /**
+         描述：生成测试使用的临时文件路径并删除已有文件
+        */
+        std::string tempPath(const char* name);
+
+    } //namespace Test
+} //namespace XYH_StatusMachine
+
+#define JSM_TEST(group, name) \
+    static void group##_##name(); \
+    static XYH_StatusMachine::Test::Registrar group##_##name##_registrar(#group, #name, &group##_##name); \
+    static void group##_##name()
+
+#define JSM_CHECK(expr) \
+    do { if (!(expr)) { XYH_StatusMachine::Test::fail(__FILE__, __LINE__, #expr); } } while (0)
+
+#define JSM_CHECK_THROW(expr) \
+    do { \
+        bool thrown_ = false; \
+        try { expr; } catch (std::logic_error&) { thrown_ = true; } \
+        if (!thrown_) { XYH_StatusMachine::Test::fail(__FILE__, __LINE__, "expected exception: " #expr); } \
+    } while (0)
@@ -0,0 +1,120 @@
+﻿//local
+#include "test.h"
+#include "fsm_async.h"
+
+using namespace XYH_StatusMachine;
+using namespace XYH_StatusMachine::Test;
+
+namespace {
+    /**
+     说明：异步状态；处理函数等待一个短定时后结束，按顺序记录开始与结束
+    */
+    class WaitStatus : public Xyh_AsyncStatus {
+    public:
+        WaitStatus(unsigned int id, boost::asio::io_service& io) : Xyh_AsyncStatus(id, "wait"), m_io(io) { }
+
+        vector<unsigned int> log;
+
+    protected:
+        virtual void asyncRoutine(shared_ptr<Xyh_Event>& e, unsigned int label, const void* msg,
+            boost::asio::yield_context yield) {
+            log.push_back(label);
+            boost::asio::steady_timer t(m_io, boost::asio::chrono::milliseconds(2));
+            t.async_wait(yield);
+            log.push_back(label + 100);
+        }
+
+        virtual void asyncTimerRoutine(unsigned int label, shared_ptr<Xyh_Event>& e,
+            boost::asio::yield_context yield) {
+            log.push_back(label + 200);
+        }
+
+    private:
+        boost::asio::io_service& m_io;
+    };
+
+    /**
+     说明：A为普通状态，W为异步状态
+    */
+    struct AsyncMachine {
+        boost::asio::io_service io;
+        Xyh_Jsm jsm;
+        shared_ptr<Xyh_Status> a;
+        shared_ptr<WaitStatus> w;
+
+        explicit AsyncMachine(unsigned long long timeoutMs = 0) :
+            jsm(1, io),
+            a(new CountStatus(1)),
+            w(new WaitStatus(2, io)) {
+            shared_ptr<Xyh_Status> ws = w;
+            a->addLink(SIG_GO, ws);
+            w->addLink(SIG_BACK, a);
+            w->addLink(SIG_SELF);
+            if (timeoutMs) {
+                w->regularMs(SIG_TIMEOUT, timeoutMs);
+            }
+            jsm.addStatus(a);
+            jsm.addStatus(ws);
+            jsm.freeze();
+        }
+    };
+}
+
+JSM_TEST(async, deferred) {
+    AsyncMachine m;
+    shared_ptr<Xyh_Event> e = m.jsm.createEvent(1, "");
+    m.jsm.addEvent(e);
+    e->place(m.a, 0, 0);
+
+    //处理函数挂起期间同一事件的信号排队，完成后按顺序处理
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_GO, 0) == RES_OK);
+    JSM_CHECK(e->suspended());
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_SELF, 0) == RES_DEFERRED);
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_BACK, 0) == RES_DEFERRED);
+    JSM_CHECK(e->getCurrentStatus()->getId() == 2);
+
+    m.io.run();
+    JSM_CHECK(!e->suspended());
+    JSM_CHECK(e->getCurrentStatus()->getId() == 1);
+    const unsigned int expect[] = { SIG_GO, SIG_GO + 100, SIG_SELF, SIG_SELF + 100 };
+    JSM_CHECK(m.w->log == vector<unsigned int>(expect, expect + 4));
+}
+
+JSM_TEST(async, staleTimer) {
+    //挂起期间到期的定时排在离开并重新进入同一状态的信号之后时不再触发
+    AsyncMachine m(1000);
+    shared_ptr<Xyh_VirtualClock> clock(new Xyh_VirtualClock);
+    m.jsm.useClock(clock);
+    shared_ptr<Xyh_Event> e = m.jsm.createEvent(1, "");
+    m.jsm.addEvent(e);
+    e->place(m.a, 0, 0);
+
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_GO, 0) == RES_OK);
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_BACK, 0) == RES_DEFERRED);
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_GO, 0) == RES_DEFERRED);
+    clock->advance(1000);
+
+    m.io.run();
+    JSM_CHECK(e->getCurrentStatus()->getId() == 2);
+    const unsigned int expect[] = { SIG_GO, SIG_GO + 100, SIG_GO, SIG_GO + 100 };
+    JSM_CHECK(m.w->log == vector<unsigned int>(expect, expect + 4));
+}
+
+JSM_TEST(async, others) {
+    //挂起的事件不影响其他事件
+    AsyncMachine m;
+    shared_ptr<Xyh_Event> e1 = m.jsm.createEvent(1, "");
+    shared_ptr<Xyh_Event> e2 = m.jsm.createEvent(2, "");
+    m.jsm.addEvent(e1);
+    m.jsm.addEvent(e2);
+    e1->place(m.a, 0, 0);
+    e2->place(m.a, 0, 0);
+
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_GO, 0) == RES_OK);
+    JSM_CHECK(m.jsm.tryProcess(2, SIG_GO, 0) == RES_OK);
+    JSM_CHECK(e1->suspended() && e2->suspended());
+    JSM_CHECK(m.jsm.tryProcess(2, SIG_BACK, 0) == RES_DEFERRED);
+    m.io.run();
+    JSM_CHECK(e1->getCurrentStatus()->getId() == 2);
+    JSM_CHECK(e2->getCurrentStatus()->getId() == 1);
+}
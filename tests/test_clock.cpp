@@ -0,0 +1,87 @@
+﻿//local
+#include "test.h"
+#include "fsm_hub.h"
+
+using namespace XYH_StatusMachine;
+using namespace XYH_StatusMachine::Test;
+
+JSM_TEST(clock, timeout) {
+    Machine m(1000);
+    m.virtualTime();
+    JSM_CHECK(m.clock->machines() == 1);
+
+    m.add(1, m.b);
+    unsigned long long due = m.jsm.timestampMs() + 1000;
+    Xyh_VirtualClock::TimePoint next;
+    JSM_CHECK(m.clock->next(next));
+
+    //定时在到期时刻准时触发，之前不触发
+    CountStatus& b = m.count(m.b);
+    m.clock->advance(due - 1 - m.jsm.timestampMs());
+    JSM_CHECK(b.timers == 0);
+    m.clock->advance(1);
+    JSM_CHECK(b.timers == 1 && b.lastLabel == SIG_TIMEOUT);
+    JSM_CHECK(m.jsm.timestampMs() == due);
+    JSM_CHECK(m.clock->wakeups() >= 1);
+
+    //定时只触发一次
+    m.clock->advance(10000);
+    JSM_CHECK(b.timers == 1);
+    JSM_CHECK(!m.clock->next(next));
+}
+
+JSM_TEST(clock, leave) {
+    //离开状态时定时被取消，重新进入时重新计时
+    Machine m(1000);
+    m.virtualTime();
+    m.add(1, m.b);
+    m.clock->advance(600);
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_BACK, 0) == RES_OK);
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_GO, 0) == RES_OK);
+    unsigned long long due = m.jsm.timestampMs() + 1000;
+
+    CountStatus& b = m.count(m.b);
+    m.clock->advance(due - 1 - m.jsm.timestampMs());
+    JSM_CHECK(b.timers == 0);
+    m.clock->advance(1);
+    JSM_CHECK(b.timers == 1);
+
+    m.add(2, m.b);
+    m.jsm.relEvent(2);
+    m.clock->advance(5000);
+    JSM_CHECK(b.timers == 1);
+}
+
+JSM_TEST(clock, many) {
+    //同一时钟上的多个状态机按到期先后被唤醒
+    shared_ptr<Xyh_VirtualClock> clock(new Xyh_VirtualClock);
+    Machine m1(300);
+    Machine m2(100);
+    m1.jsm.useClock(clock);
+    m2.jsm.useClock(clock);
+    JSM_CHECK(clock->machines() == 2);
+
+    m1.add(1, m1.b);
+    m2.add(1, m2.b);
+    clock->advance(150);
+    JSM_CHECK(m1.count(m1.b).timers == 0 && m2.count(m2.b).timers == 1);
+    clock->advance(150);
+    JSM_CHECK(m1.count(m1.b).timers == 1);
+    JSM_CHECK(clock->wakeups() >= 2);
+
+    //已经过的时间在改用其他时钟时保持不变
+    m1.jsm.useClock(shared_ptr<Xyh_Clock>());
+    JSM_CHECK(clock->machines() == 1);
+    JSM_CHECK(m1.jsm.timestampMs() >= 300);
+}
+
+JSM_TEST(clock, hub) {
+    //使用共享定时中心时不能同时使用自定义时钟
+    Machine m;
+    shared_ptr<Xyh_TimerHub> hub(new Xyh_TimerHub(m.io));
+    m.jsm.useTimerHub(hub);
+    JSM_CHECK_THROW(m.jsm.useClock(shared_ptr<Xyh_Clock>(new Xyh_VirtualClock)));
+    m.jsm.useTimerHub(shared_ptr<Xyh_TimerHub>());
+    m.virtualTime();
+    JSM_CHECK_THROW(m.jsm.useTimerHub(hub));
+}
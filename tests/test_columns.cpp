@@ -0,0 +1,190 @@
+﻿//local
+#include "test.h"
+#include "fsm_columns.h"
+//std
+#include <climits>
+
+using namespace XYH_StatusMachine;
+using namespace XYH_StatusMachine::Test;
+
+namespace {
+    //参与比较的扫描实现；本机不支持的实现被跳过
+    const char* const KERNELS[] = { "avx2", "sse4.2", "scalar" };
+
+    /**
+     描述：将句柄转换为事件id，保持扫描顺序
+    */
+    vector<unsigned int> idsOf(Xyh_Jsm& jsm, const vector<Xyh_Handle>& handles) {
+        vector<unsigned int> ids;
+        for (size_t i = 0; i < handles.size(); i++) {
+            shared_ptr<Xyh_Event> e = jsm.findEvent(handles[i]);
+            ids.push_back(e ? e->getId() : 0);
+        }
+        return ids;
+    }
+
+    /**
+     描述：在一组查询条件下比较两个状态机的selectEvents与countEvents结果
+     参数：
+       cols：    启用列存储的状态机
+       objs：    逐个检查事件的状态机
+     返回值：无
+    */
+    void compareFilters(Machine& cols, Machine& objs) {
+        const unsigned int statuses[] = { Xyh_EventFilter::ANY_STATUS, 1, 2, 3 };
+        unsigned long long now = objs.jsm.timestampMs();
+        const unsigned long long befores[] = {
+            0, 1, now / 3, now / 2, now, now + 1,
+            (unsigned long long)LLONG_MAX - 1, (unsigned long long)LLONG_MAX,
+            (unsigned long long)LLONG_MAX + 1, ~0ULL - 1, ~0ULL
+        };
+
+        for (size_t s = 0; s < sizeof(statuses) / sizeof(statuses[0]); s++) {
+            for (size_t t = 0; t < sizeof(befores) / sizeof(befores[0]); t++) {
+                for (int live = 0; live < 2; live++) {
+                    Xyh_EventFilter f;
+                    f.status = statuses[s];
+                    f.enteredBefore = befores[t];
+                    f.live = live != 0;
+
+                    vector<Xyh_Handle> expect, actual;
+                    size_t n = objs.jsm.selectEvents(f, expect);
+                    JSM_CHECK(cols.jsm.selectEvents(f, actual) == n);
+                    JSM_CHECK(idsOf(cols.jsm, actual) == idsOf(objs.jsm, expect));
+                    JSM_CHECK(cols.jsm.countEvents(f) == n);
+                    JSM_CHECK(objs.jsm.countEvents(f) == n);
+                }
+            }
+        }
+    }
+
+    /**
+     描述：在每个本机支持的扫描实现下比较两个状态机的查询结果，完成后恢复原来的实现
+     返回值：参与比较的实现数量
+    */
+    size_t compare(Machine& cols, Machine& objs) {
+        std::string original = Xyh_EventColumns::kernel();
+        size_t kernels = 0;
+        for (size_t k = 0; k < sizeof(KERNELS) / sizeof(KERNELS[0]); k++) {
+            if (Xyh_EventColumns::useKernel(KERNELS[k])) {
+                JSM_CHECK(std::string(Xyh_EventColumns::kernel()) == KERNELS[k]);
+                compareFilters(cols, objs);
+                kernels++;
+            }
+        }
+        JSM_CHECK(Xyh_EventColumns::useKernel(original.c_str()));
+        return kernels;
+    }
+
+    /**
+     描述：加入事件[from, to)，按id轮流放入A、B、C或不放入状态；每个事件间隔1ms
+    */
+    void grow(Machine& m, unsigned int from, unsigned int to) {
+        for (unsigned int id = from; id < to; id++) {
+            shared_ptr<Xyh_Status> places[] = { m.a, m.b, m.c, shared_ptr<Xyh_Status>() };
+            m.add(id, places[id % 4]);
+            m.clock->advance(1);
+        }
+    }
+
+    /**
+     描述：转移、删除并标记部分事件；未放入状态的事件被标记后放入回收状态C，变为已过期
+    */
+    void churn(Machine& m, unsigned int to) {
+        for (unsigned int id = 1; id < to; id += 7) {
+            m.jsm.tryProcess(id, m.where(id) == 1 ? SIG_GO : SIG_BACK, 0);
+            m.clock->advance(1);
+        }
+        for (unsigned int id = 3; id < to; id += 11) {
+            m.jsm.relEvent(id);
+        }
+        for (unsigned int id = 5; id < to; id += 5) {
+            if (m.jsm.findEvent(id)) {
+                m.jsm.expireEvent(id);
+                if (m.where(id) == Xyh_Jsm::NO_STATUS) {
+                    m.jsm.findEvent(id)->place(m.c, 0, 0);
+                }
+            }
+        }
+        m.clock->advance(1);
+    }
+}
+
+JSM_TEST(columns, kernels) {
+    //标量实现在任何平台上都可用，未知名称被拒绝且不改变当前实现
+    std::string original = Xyh_EventColumns::kernel();
+    JSM_CHECK(!Xyh_EventColumns::useKernel("bogus"));
+    JSM_CHECK(!Xyh_EventColumns::useKernel(0));
+    JSM_CHECK(std::string(Xyh_EventColumns::kernel()) == original);
+    JSM_CHECK(Xyh_EventColumns::useKernel("scalar"));
+    JSM_CHECK(std::string(Xyh_EventColumns::kernel()) == "scalar");
+    JSM_CHECK(Xyh_EventColumns::useKernel(original.c_str()));
+}
+
+JSM_TEST(columns, tails) {
+    //逐个加入事件，覆盖不是8或4整数倍的尾部长度
+    Machine cols, objs;
+    cols.virtualTime();
+    objs.virtualTime();
+    cols.jsm.enableEventColumns();
+    JSM_CHECK(compare(cols, objs) > 0);
+    for (unsigned int id = 1; id <= 40; id++) {
+        grow(cols, id, id + 1);
+        grow(objs, id, id + 1);
+        compare(cols, objs);
+    }
+}
+
+JSM_TEST(columns, sync) {
+    //超过一个扫描块的事件，经过转移、删除、标记与回收后列存储与事件对象保持一致
+    const unsigned int n = 2500;
+    Machine cols, objs;
+    cols.virtualTime();
+    objs.virtualTime();
+    grow(cols, 1, n / 2);
+    grow(objs, 1, n / 2);
+    //启用前已有的事件也被加入列存储
+    cols.jsm.enableEventColumns();
+    grow(cols, n / 2, n);
+    grow(objs, n / 2, n);
+    compare(cols, objs);
+
+    churn(cols, n);
+    churn(objs, n);
+    Xyh_EventFilter all;
+    all.live = false;
+    JSM_CHECK(objs.jsm.countEvents(Xyh_EventFilter()) < objs.jsm.countEvents(all));
+    compare(cols, objs);
+
+    //被删除的槽位再次使用
+    grow(cols, n, n + 300);
+    grow(objs, n, n + 300);
+    compare(cols, objs);
+}
+
+JSM_TEST(columns, restore) {
+    //从快照恢复后列存储与事件对象一致
+    const unsigned int n = 1100;
+    std::string path = tempPath("columns.snapshot");
+    {
+        Machine m;
+        m.virtualTime();
+        grow(m, 1, n);
+        churn(m, n);
+        m.jsm.snapshot(path);
+    }
+
+    Machine cols, objs;
+    cols.virtualTime();
+    objs.virtualTime();
+    cols.jsm.enableEventColumns();
+    size_t restored = cols.jsm.restore(path);
+    JSM_CHECK(objs.jsm.restore(path) == restored);
+    JSM_CHECK(restored > 0);
+    compare(cols, objs);
+
+    churn(cols, n);
+    churn(objs, n);
+    compare(cols, objs);
+    std::remove(path.c_str());
+}
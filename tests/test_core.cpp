@@ -0,0 +1,383 @@
+﻿//local
+#include "test.h"
+//std
+#include <set>
+
+using namespace XYH_StatusMachine;
+using namespace XYH_StatusMachine::Test;
+
+namespace {
+    /**
+     描述：推进时间轮到指定时刻，取出并释放所有到期的定时
+     返回值：到期的定时数量；labels返回到期定时的标签
+    */
+    size_t expireAll(Xyh_TimerWheel& w, unsigned long long now, vector<unsigned int>* labels) {
+        size_t n = 0;
+        while (Xyh_Timer* t = w.expire(now)) {
+            if (labels) {
+                labels->push_back(t->label);
+            }
+            w.release(t);
+            n++;
+        }
+        return n;
+    }
+}
+
+JSM_TEST(wheel, cascade) {
+    //每一层各放一个定时，经过逐级下放后都应在到期时刻准时取出
+    Xyh_TimerWheel w;
+    const unsigned long long deadlines[] = { 7, 300, 70000, 20000000 };
+    for (unsigned int i = 0; i < 4; i++) {
+        w.schedule(deadlines[i], i, 0, 0);
+    }
+    JSM_CHECK(w.size() == 4);
+
+    unsigned long long now = 0;
+    for (unsigned int i = 0; i < 4; i++) {
+        vector<unsigned int> labels;
+        JSM_CHECK(expireAll(w, deadlines[i] - 1, &labels) == 0);
+        JSM_CHECK(w.nextPending() <= deadlines[i]);
+        JSM_CHECK(expireAll(w, deadlines[i], &labels) == 1);
+        JSM_CHECK(labels.size() == 1 && labels[0] == i);
+        now = deadlines[i];
+    }
+    JSM_CHECK(w.size() == 0);
+    JSM_CHECK(w.nextPending() == Xyh_TimerWheel::NEVER);
+    JSM_CHECK(expireAll(w, now + 100000000, 0) == 0);
+}
+
+JSM_TEST(wheel, cancel) {
+    Xyh_TimerWheel w;
+    Xyh_Timer* a = w.schedule(100, 1, 0, 0);
+    Xyh_Timer* b = w.schedule(1000, 2, 0, 0);
+    Xyh_Timer* c = w.schedule(70000, 3, 0, 0);
+    w.schedule(70001, 4, 0, 0);
+
+    //下放前后各取消一个
+    w.cancel(a);
+    JSM_CHECK(expireAll(w, 900, 0) == 0);
+    w.cancel(b);
+    JSM_CHECK(expireAll(w, 65600, 0) == 0);
+    w.cancel(c);
+    JSM_CHECK(w.size() == 1);
+
+    vector<unsigned int> labels;
+    JSM_CHECK(expireAll(w, 80000, &labels) == 1);
+    JSM_CHECK(labels.size() == 1 && labels[0] == 4);
+    JSM_CHECK(w.size() == 0);
+}
+
+JSM_TEST(wheel, overdue) {
+    //早于已推进时刻的定时在下一个滴答到期
+    Xyh_TimerWheel w;
+    JSM_CHECK(expireAll(w, 5000, 0) == 0);
+    w.schedule(10, 1, 0, 0);
+    JSM_CHECK(w.nextPending() == 5001);
+    JSM_CHECK(expireAll(w, 5001, 0) == 1);
+}
+
+JSM_TEST(table, generation) {
+    Xyh_EventTable t;
+    shared_ptr<Xyh_Event> e1(new Xyh_Event(1, "one"));
+    shared_ptr<Xyh_Event> e2(new Xyh_Event(2, "two"));
+    Xyh_Handle h1 = t.insert(e1);
+    Xyh_Handle h2 = t.insert(e2);
+    JSM_CHECK(h1.valid() && h2.valid() && h1 != h2);
+    JSM_CHECK(t.get(h1) == e1.get());
+    JSM_CHECK(t.find(2) == h2);
+    JSM_CHECK(t.insert(e1) == h1);
+
+    //删除后槽位被重用，代数不同，旧句柄失效
+    JSM_CHECK(t.erase(h1));
+    JSM_CHECK(!t.erase(h1));
+    JSM_CHECK(t.get(h1) == 0);
+    JSM_CHECK(!t.find(1).valid());
+
+    shared_ptr<Xyh_Event> e3(new Xyh_Event(3, "three"));
+    Xyh_Handle h3 = t.insert(e3);
+    JSM_CHECK(h3.index() == h1.index());
+    JSM_CHECK(h3.generation() != h1.generation());
+    JSM_CHECK(t.get(h1) == 0);
+    JSM_CHECK(t.get(h3) == e3.get());
+    JSM_CHECK(t.size() == 2);
+}
+
+JSM_TEST(table, replace) {
+    //相同id的事件替换旧事件，旧句柄失效
+    Xyh_EventTable t;
+    shared_ptr<Xyh_Event> old(new Xyh_Event(7, "old"));
+    shared_ptr<Xyh_Event> now(new Xyh_Event(7, "new"));
+    Xyh_Handle h1 = t.insert(old);
+    Xyh_Handle h2 = t.insert(now);
+    JSM_CHECK(t.get(h1) == 0);
+    JSM_CHECK(t.get(h2) == now.get());
+    JSM_CHECK(t.find(7) == h2);
+    JSM_CHECK(t.size() == 1);
+}
+
+JSM_TEST(table, rehash) {
+    Xyh_EventTable t;
+    vector<shared_ptr<Xyh_Event> > events;
+    vector<Xyh_Handle> handles;
+    for (unsigned int i = 0; i < 5000; i++) {
+        events.push_back(shared_ptr<Xyh_Event>(new Xyh_Event(i * 7919, "")));
+        handles.push_back(t.insert(events.back()));
+    }
+    for (unsigned int i = 0; i < 5000; i += 2) {
+        JSM_CHECK(t.erase(handles[i]));
+    }
+
+    bool found = true;
+    for (unsigned int i = 0; i < 5000; i++) {
+        Xyh_Handle h = t.find(i * 7919);
+        found = found && ((i % 2) ? (h == handles[i] && t.get(h) == events[i].get()) : !h.valid());
+    }
+    JSM_CHECK(found);
+    JSM_CHECK(t.size() == 2500);
+}
+
+JSM_TEST(dispatch, results) {
+    Machine m;
+    m.add(1, m.a);
+    m.add(2, m.a);
+    m.add(3, m.b);
+    m.add(4, shared_ptr<Xyh_Status>());
+    m.jsm.findEvent(4)->expire();
+    m.jsm.findEvent(4)->place(m.c, 0, 0);
+
+    //同一事件的记录按原有顺序处理
+    const Xyh_Signal records[] = {
+        { 1, SIG_GO, 0 },
+        { 99, SIG_GO, 0 },
+        { 3, SIG_GO, 0 },
+        { 1, SIG_BACK, 0 },
+        { 2, SIG_GO, 0 },
+        { 4, SIG_BACK, 0 }
+    };
+    Xyh_Result results[6];
+    JSM_CHECK(m.jsm.processBatch(records, 6, results) == 3);
+    JSM_CHECK(results[0] == RES_OK);
+    JSM_CHECK(results[1] == RES_NO_EVENT);
+    JSM_CHECK(results[2] == RES_NO_ROUTE);
+    JSM_CHECK(results[3] == RES_OK);
+    JSM_CHECK(results[4] == RES_OK);
+    JSM_CHECK(results[5] == RES_EXPIRED);
+    JSM_CHECK(m.where(1) == 1);
+    JSM_CHECK(m.where(2) == 2);
+
+    Xyh_Rejects r = m.jsm.rejects();
+    JSM_CHECK(r.noEvent == 1 && r.noRoute == 1 && r.expired == 1);
+    JSM_CHECK(m.jsm.rejects(2, SIG_GO).noRoute == 1);
+    JSM_CHECK(m.jsm.rejects(Xyh_Jsm::NO_STATUS, SIG_GO).noEvent == 1);
+}
+
+JSM_TEST(dispatch, sparse) {
+    //随机分布在32位范围内的信号：行宽按信号数量而非信号范围分配
+    vector<unsigned int> sigs;
+    std::set<unsigned int> unique;
+    unsigned int seed = 2463534242U;
+    while (sigs.size() < 200) {
+        seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+        if (seed > SIG_UNKNOWN && unique.insert(seed).second) {
+            sigs.push_back(seed);
+        }
+    }
+
+    shared_ptr<Xyh_Status> a(new CountStatus(1));
+    shared_ptr<Xyh_Status> b(new CountStatus(2));
+    for (size_t i = 0; i < sigs.size(); i++) {
+        if (i % 2) {
+            b->addLink(sigs[i]);
+        }
+        else {
+            a->addLink(sigs[i], b);
+        }
+    }
+
+    {
+        vector<shared_ptr<Xyh_Status> > statuses;
+        statuses.push_back(a);
+        statuses.push_back(b);
+        Xyh_Dispatch d(statuses);
+        JSM_CHECK(d.columns() <= 4 * sigs.size());
+        bool ok = true;
+        for (size_t i = 0; i < sigs.size(); i++) {
+            int c = d.column(sigs[i]);
+            ok = ok && c >= 0 && d.signal(c) == sigs[i];
+            ok = ok && d.route(0, sigs[i]) == (i % 2 ? -1 : 1);
+            ok = ok && d.route(1, sigs[i]) == (i % 2 ? 1 : -1);
+        }
+        JSM_CHECK(ok);
+        JSM_CHECK(d.column(SIG_GO) < 0 && d.column(0xFFFFFFFFU) < 0);
+    }
+
+    boost::asio::io_service io;
+    Xyh_Jsm jsm(1, io);
+    jsm.addStatus(a);
+    jsm.addStatus(b);
+    jsm.freeze();
+    shared_ptr<Xyh_Event> e = jsm.createEvent(1, "");
+    jsm.addEvent(e);
+    e->place(a, 0, 0);
+    JSM_CHECK(jsm.tryProcess(1, SIG_GO, 0) == RES_NO_ROUTE);
+    JSM_CHECK(jsm.tryProcess(1, sigs[1], 0) == RES_NO_ROUTE);
+    JSM_CHECK(jsm.tryProcess(1, sigs[0], 0) == RES_OK);
+    JSM_CHECK(jsm.tryProcess(1, sigs[3], 0) == RES_OK);
+    JSM_CHECK(e->getCurrentStatus() == b);
+    JSM_CHECK(jsm.rejects(1, SIG_GO).noRoute == 1);
+}
+
+JSM_TEST(dispatch, digest) {
+    //digestion的自环只执行信号处理函数，不重新进入状态
+    Machine m;
+    m.add(1, m.a);
+    unsigned long long routines = m.count(m.a).routines;
+    JSM_CHECK(m.jsm.tryDigest(1, SIG_SELF, 0) == RES_OK);
+    JSM_CHECK(m.count(m.a).routines == routines + 1);
+
+    const Xyh_Signal records[] = { { 1, SIG_SELF, 0 }, { 1, SIG_GO, 0 } };
+    Xyh_Result results[2];
+    JSM_CHECK(m.jsm.digestBatch(records, 2, results) == 2);
+    JSM_CHECK(m.where(1) == 2);
+    JSM_CHECK(m.jsm.occupancy(1) == 0 && m.jsm.occupancy(2) == 1);
+}
+
+JSM_TEST(dispatch, exceptions) {
+    Machine m;
+    m.add(1, m.a);
+    JSM_CHECK_THROW(m.jsm.process(99, SIG_GO, 0));
+    JSM_CHECK_THROW(m.jsm.process(1, SIG_BACK, 0));
+    m.jsm.process(1, SIG_GO, 0);
+    JSM_CHECK(m.where(1) == 2);
+}
+
+JSM_TEST(dispatch, broadcast) {
+    Machine m;
+    for (unsigned int i = 0; i < 10; i++) {
+        m.add(i, i % 2 ? m.b : m.a);
+    }
+    JSM_CHECK(m.jsm.process(SIG_GO, 0) == 5);
+    JSM_CHECK(m.jsm.occupancy(2) == 10);
+}
+
+namespace {
+    /**
+     说明：信号处理函数抛出非std::exception异常的状态
+    */
+    class ThrowStatus : public Xyh_Status {
+    public:
+        explicit ThrowStatus(unsigned int id) : Xyh_Status(id, "throw") { }
+
+        virtual void routine(shared_ptr<Xyh_Event>& e, unsigned int label, const void* msg) {
+            if (label) {
+                throw 42;
+            }
+        }
+    };
+}
+
+JSM_TEST(dispatch, parallel) {
+    //并行广播中任意异常都转为logic_error在广播线程抛出，其余分组照常完成
+    boost::asio::io_service io;
+    Xyh_Jsm jsm(1, io);
+    shared_ptr<Xyh_Status> a(new CountStatus(1));
+    shared_ptr<Xyh_Status> b(new CountStatus(2));
+    shared_ptr<Xyh_Status> t(new ThrowStatus(3));
+    a->addLink(SIG_GO, b);
+    b->addLink(SIG_GO, t);
+    jsm.addStatus(a);
+    jsm.addStatus(b);
+    jsm.addStatus(t);
+    jsm.freeze();
+    for (unsigned int i = 0; i < 8; i++) {
+        shared_ptr<Xyh_Event> e = jsm.createEvent(i, "");
+        jsm.addEvent(e);
+        e->place(i % 2 ? b : a, 0, 0);
+    }
+
+    boost::asio::thread_pool pool(2);
+    JSM_CHECK_THROW(jsm.process(SIG_GO, 0, pool));
+    JSM_CHECK(jsm.occupancy(2) == 4 && jsm.occupancy(3) == 4);
+    JSM_CHECK(static_cast<CountStatus&>(*b).routines == 8);
+    pool.join();
+}
+
+JSM_TEST(dispatch, metrics) {
+    Machine m;
+    m.add(1, m.a);
+    shared_ptr<Xyh_Metrics> metrics = m.jsm.enableMetrics();
+    m.jsm.tryProcess(1, SIG_GO, 0);
+    m.jsm.tryProcess(1, SIG_BACK, 0);
+    m.jsm.tryProcess(1, SIG_GO, 0);
+
+    Xyh_Metrics::Snapshot s = metrics->snapshot();
+    JSM_CHECK(s.states.size() == 3);
+    JSM_CHECK(s.states[m.a->getIndex()].occupancy == 0);
+    JSM_CHECK(s.states[m.b->getIndex()].occupancy == 1);
+    JSM_CHECK(s.states[m.b->getIndex()].entries == 2);
+
+    unsigned long long go = 0;
+    for (size_t i = 0; i < s.transitions.size(); i++) {
+        if (s.transitions[i].signal == SIG_GO) {
+            JSM_CHECK(s.transitions[i].from == 1 && s.transitions[i].to == 2);
+            go += s.transitions[i].count;
+        }
+    }
+    JSM_CHECK(go == 2);
+}
+
+JSM_TEST(dispatch, enterTime) {
+    //进入时间按ms记录，enterTime换算为s
+    Machine m;
+    m.virtualTime();
+    m.clock->advance(2500);
+    m.add(1, m.a);
+    shared_ptr<Xyh_Event> e = m.jsm.findEvent(1);
+    JSM_CHECK(e->enterTimeMs() == m.jsm.timestampMs());
+    m.clock->advance(1000);
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_GO, 0) == RES_OK);
+    JSM_CHECK(e->enterTimeMs() == m.jsm.timestampMs());
+    JSM_CHECK(e->enterTime() == m.jsm.timestampMs() / 1000);
+}
+
+JSM_TEST(dispatch, unfrozen) {
+    //未冻结的状态机同样可以处理信号与统计拒绝
+    Machine m(0, false);
+    m.add(1, m.a);
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_GO, 0) == RES_OK);
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_GO, 0) == RES_NO_ROUTE);
+    JSM_CHECK(m.jsm.rejects(2, SIG_GO).noRoute == 1);
+
+    //冻结前的计数保留；冻结后不在转移表中的信号在同一状态上共用一个计数
+    m.jsm.freeze();
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_GO, 0) == RES_NO_ROUTE);
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_UNKNOWN, 0) == RES_NO_ROUTE);
+    JSM_CHECK(m.jsm.tryProcess(1, SIG_UNKNOWN + 1, 0) == RES_NO_ROUTE);
+    JSM_CHECK(m.jsm.rejects(2, SIG_GO).noRoute == 2);
+    JSM_CHECK(m.jsm.rejects(2, SIG_UNKNOWN).noRoute == 2);
+    JSM_CHECK(m.jsm.rejects(1, SIG_UNKNOWN).noRoute == 0);
+    JSM_CHECK(m.jsm.rejects().noRoute == 4);
+}
+
+JSM_TEST(dispatch, unplaced) {
+    //尚未放入任何状态的事件没有转移路线
+    Machine m;
+    Xyh_Handle h = m.add(9, shared_ptr<Xyh_Status>());
+    JSM_CHECK(m.jsm.tryProcess(h, 5, 0) == RES_NO_ROUTE);
+    JSM_CHECK(m.jsm.tryProcess(h, SIG_GO, 0) == RES_NO_ROUTE);
+    JSM_CHECK(m.jsm.tryDigest(9, SIG_SELF, 0) == RES_NO_ROUTE);
+    JSM_CHECK_THROW(m.jsm.process(9, SIG_GO, 0));
+    JSM_CHECK_THROW(m.jsm.findEvent(9)->handle(SIG_GO, 0));
+    JSM_CHECK(m.jsm.findEvent(9)->tryHandle(SIG_GO, 0) == RES_NO_ROUTE);
+
+    const Xyh_Signal records[] = { { 9, SIG_GO, 0 } };
+    Xyh_Result results[1];
+    JSM_CHECK(m.jsm.processBatch(records, 1, results) == 0);
+    JSM_CHECK(results[0] == RES_NO_ROUTE);
+    JSM_CHECK(m.jsm.rejects(Xyh_Jsm::NO_STATUS, SIG_GO).noRoute == 5);
+
+    //放入状态后正常处理
+    m.jsm.findEvent(9)->place(m.a, 0, 0);
+    JSM_CHECK(m.jsm.tryProcess(h, SIG_GO, 0) == RES_OK);
+}
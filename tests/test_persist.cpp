@@ -0,0 +1,284 @@
+﻿//local
+#include "test.h"
+#include "fsm_journal.h"
+//std
+#include <cstring>
+#include <fstream>
+#include <iterator>
+//boost
+#include "boost/ref.hpp"
+//system
+#ifndef WIN32
+#include <csignal>
+#include <sys/resource.h>
+#endif
+
+using namespace XYH_StatusMachine;
+using namespace XYH_StatusMachine::Test;
+
+namespace {
+    std::string readFile(const std::string& path) {
+        std::ifstream in(path.c_str(), std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+
+    void writeFile(const std::string& path, const std::string& data) {
+        std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+        out.write(data.data(), data.size());
+    }
+
+    //快照文件头中事件数与别名字节数的偏移，以及单个事件记录的大小
+    const size_t SNAPSHOT_EVENTS = 24;
+    const size_t SNAPSHOT_NICKS = 40;
+    const unsigned long long SNAPSHOT_EVENT_SIZE = 32;
+
+    std::string patch(std::string data, size_t offset, unsigned long long v) {
+        std::memcpy(&data[offset], &v, sizeof(v));
+        return data;
+    }
+
+    /**
+     描述：判断快照是否因长度不符被拒绝
+    */
+    bool rejected(Xyh_Jsm& jsm, const std::string& path) {
+        try {
+            jsm.restore(path);
+        }
+        catch (std::logic_error& e) {
+            return std::string(e.what()) == "snapshot is truncated or corrupt";
+        }
+        return false;
+    }
+
+    /**
+     说明：收集日志记录的序号与类型
+    */
+    struct Collector {
+        vector<unsigned long long> seqs;
+        vector<unsigned char> types;
+
+        void operator()(const Xyh_Journal::Record& r) {
+            seqs.push_back(r.seq);
+            types.push_back(r.type);
+        }
+    };
+
+    /**
+     描述：生成快照：事件1在A，事件2在B且有定时，事件3未放入状态，事件4在A并被标记过期
+     返回值：事件2定时的到期时刻
+    */
+    unsigned long long makeSnapshot(const std::string& path) {
+        Machine m(1000);
+        m.virtualTime();
+        m.jsm.addEvent(m.jsm.createEvent(1, "one"));
+        m.jsm.findEvent(1)->place(m.a, 0, 0);
+        m.jsm.addEvent(m.jsm.createEvent(2, "two"));
+        m.jsm.findEvent(2)->place(m.b, 0, 0);
+        unsigned long long due = m.jsm.timestampMs() + 1000;
+        m.add(3, shared_ptr<Xyh_Status>());
+        m.add(4, m.a);
+        m.jsm.expireEvent(4);
+
+        m.clock->advance(400);
+        m.jsm.snapshot(path);
+        return due;
+    }
+}
+
+JSM_TEST(snapshot, roundTrip) {
+    std::string path = tempPath("snapshot");
+    unsigned long long due = makeSnapshot(path);
+
+    Machine r(1000);
+    r.virtualTime();
+    JSM_CHECK(r.jsm.restore(path) == 4);
+    JSM_CHECK(r.where(1) == 1);
+    JSM_CHECK(r.where(2) == 2);
+    JSM_CHECK(r.where(3) == Xyh_Jsm::NO_STATUS);
+    JSM_CHECK(r.jsm.findEvent(2)->getNick() == "two");
+    JSM_CHECK(r.jsm.findEvent(4)->marked());
+    JSM_CHECK(r.jsm.occupancy(1) == 2 && r.jsm.occupancy(2) == 1);
+
+    //时钟从快照时刻继续，定时按原到期时刻触发
+    CountStatus& b = r.count(r.b);
+    JSM_CHECK(r.jsm.timestampMs() < due);
+    r.clock->advance(due - 1 - r.jsm.timestampMs());
+    JSM_CHECK(b.timers == 0);
+    r.clock->advance(1);
+    JSM_CHECK(b.timers == 1 && b.lastLabel == SIG_TIMEOUT);
+
+    //恢复后的事件可以继续处理信号
+    JSM_CHECK(r.jsm.tryProcess(2, SIG_BACK, 0) == RES_OK);
+    JSM_CHECK(r.jsm.occupancy(1) == 3);
+    std::remove(path.c_str());
+}
+
+JSM_TEST(snapshot, corrupt) {
+    std::string path = tempPath("snapshot");
+    std::string bad = tempPath("snapshot.bad");
+    makeSnapshot(path);
+    std::string data = readFile(path);
+    JSM_CHECK(data.size() > 64);
+
+    //截断、多余字节与错误的标识都被拒绝，状态机保持为空
+    writeFile(bad, data.substr(0, data.size() - 1));
+    Machine r;
+    JSM_CHECK_THROW(r.jsm.restore(bad));
+    writeFile(bad, data + "x");
+    JSM_CHECK_THROW(r.jsm.restore(bad));
+    std::string magic = data;
+    magic[0] = 'Y';
+    writeFile(bad, magic);
+    JSM_CHECK_THROW(r.jsm.restore(bad));
+    writeFile(bad, data.substr(0, 8));
+    JSM_CHECK_THROW(r.jsm.restore(bad));
+
+    //计数过大时各段长度之和回绕为文件大小也被拒绝：空快照声明一个事件，别名字节数回绕抵消事件长度
+    Machine empty;
+    empty.jsm.snapshot(bad);
+    std::string header = readFile(bad);
+    std::string wrap = patch(header, SNAPSHOT_EVENTS, 1);
+    writeFile(bad, patch(wrap, SNAPSHOT_NICKS, 0 - SNAPSHOT_EVENT_SIZE));
+    JSM_CHECK(rejected(r.jsm, bad));
+    writeFile(bad, patch(header, SNAPSHOT_EVENTS, 1ULL << 59));
+    JSM_CHECK(rejected(r.jsm, bad));
+    JSM_CHECK_THROW(r.jsm.restore(tempPath("snapshot.missing")));
+    JSM_CHECK(!r.jsm.findEvent(1));
+
+    //只能恢复到空的状态机
+    r.add(9, r.a);
+    JSM_CHECK_THROW(r.jsm.restore(path));
+    std::remove(path.c_str());
+    std::remove(bad.c_str());
+}
+
+JSM_TEST(journal, torn) {
+    std::string path = tempPath("journal");
+    Xyh_Journal::Policy policy;
+    policy.sync = false;
+    {
+        Xyh_Journal j(path, policy);
+        for (unsigned int i = 0; i < 3; i++) {
+            JSM_CHECK(j.append(Xyh_Journal::REC_PROCESS, i, i, SIG_GO, 0, "abc", 3) == i + 1);
+        }
+        j.flush();
+        JSM_CHECK(j.durable() == 3);
+    }
+
+    //写了一半的尾部记录在读取时被忽略，重新打开时被截掉
+    std::string data = readFile(path);
+    writeFile(path, data + std::string(10, '\x5A'));
+    Collector c;
+    JSM_CHECK(Xyh_Journal::read(path, boost::ref(c)) == data.size());
+    JSM_CHECK(c.seqs.size() == 3);
+    {
+        Xyh_Journal j(path, policy);
+        JSM_CHECK(j.sequence() == 3);
+        JSM_CHECK(j.append(Xyh_Journal::REC_DIGEST, 9, 1, SIG_SELF, 0, 0, 0) == 4);
+    }
+
+    Collector all;
+    Xyh_Journal::read(path, boost::ref(all));
+    JSM_CHECK(all.seqs.size() == 4);
+    JSM_CHECK(all.seqs.size() == 4 && all.seqs[3] == 4 && all.types[3] == Xyh_Journal::REC_DIGEST);
+    std::remove(path.c_str());
+}
+
+JSM_TEST(journal, oversized) {
+    //记录总长超出32位长度字段的负载被拒绝，不占用序号，也不读取负载
+    std::string path = tempPath("journal");
+    Xyh_Journal::Policy policy;
+    policy.sync = false;
+    {
+        Xyh_Journal j(path, policy);
+        JSM_CHECK(j.append(Xyh_Journal::REC_PROCESS, 1, 1, SIG_GO, 0, "abc", 3) == 1);
+        JSM_CHECK_THROW(j.append(Xyh_Journal::REC_PROCESS, 2, 1, SIG_GO, 0, "abc", 0xFFFFFFF0U));
+        JSM_CHECK_THROW(j.append(Xyh_Journal::REC_PROCESS, 2, 1, SIG_GO, 0, "abc", 0xFFFFFFFFU));
+        JSM_CHECK(j.sequence() == 1 && !j.failed());
+        JSM_CHECK(j.append(Xyh_Journal::REC_PROCESS, 3, 1, SIG_BACK, 0, "abc", 3) == 2);
+    }
+
+    Collector c;
+    Xyh_Journal::read(path, boost::ref(c));
+    JSM_CHECK(c.seqs.size() == 2 && c.seqs[1] == 2);
+    std::remove(path.c_str());
+}
+
+#ifndef WIN32
+JSM_TEST(journal, failed) {
+    std::string path = tempPath("journal");
+    Xyh_Journal::Policy policy;
+    policy.sync = false;
+    Xyh_Journal j(path, policy);
+
+    //限制文件大小使写入失败
+    std::signal(SIGXFSZ, SIG_IGN);
+    rlimit old;
+    getrlimit(RLIMIT_FSIZE, &old);
+    rlimit limit = old;
+    limit.rlim_cur = 4096;
+    setrlimit(RLIMIT_FSIZE, &limit);
+
+    std::string payload(1000, 'x');
+    for (unsigned int i = 0; i < 8; i++) {
+        j.append(Xyh_Journal::REC_PROCESS, i, i, SIG_GO, 0, payload.data(), payload.size());
+    }
+    JSM_CHECK_THROW(j.flush());
+    setrlimit(RLIMIT_FSIZE, &old);
+
+    //失败后不再接受记录，已读出的记录序号连续
+    JSM_CHECK(j.failed() && !j.error().empty());
+    JSM_CHECK(j.append(Xyh_Journal::REC_PROCESS, 9, 9, SIG_GO, 0, 0, 0) == 0);
+    JSM_CHECK(j.sequence() == 8);
+    JSM_CHECK_THROW(j.flush());
+
+    Collector c;
+    Xyh_Journal::read(path, boost::ref(c));
+    bool contiguous = c.seqs.size() < 8;
+    for (size_t i = 0; i < c.seqs.size(); i++) {
+        contiguous = contiguous && c.seqs[i] == i + 1;
+    }
+    JSM_CHECK(contiguous);
+    std::remove(path.c_str());
+}
+#endif
+
+JSM_TEST(journal, afterSnapshot) {
+    std::string path = tempPath("journal");
+    std::string snap = tempPath("journal.snapshot");
+    Xyh_Journal::Policy policy;
+    policy.sync = false;
+    {
+        Machine m(1000);
+        m.virtualTime();
+        m.jsm.enableJournal(shared_ptr<Xyh_Journal>(new Xyh_Journal(path, policy)));
+        m.add(1, m.a);
+        m.add(2, m.a);
+        m.jsm.tryProcess(1, SIG_GO, 0);
+        m.clock->advance(100);
+        m.jsm.snapshot(snap);
+
+        //快照之后的记录在回放时重新执行
+        m.jsm.tryProcess(2, SIG_GO, 0);
+        m.clock->advance(100);
+        m.jsm.tryProcess(1, SIG_BACK, 0);
+        m.add(3, m.b);
+        m.jsm.relEvent(2);
+        m.jsm.journal()->flush();
+    }
+
+    Machine r(1000);
+    r.virtualTime();
+    r.jsm.restore(snap);
+    JSM_CHECK(r.where(1) == 2 && r.where(2) == 1);
+    JSM_CHECK(r.jsm.replay(path) == 5);
+    JSM_CHECK(r.where(1) == 1);
+    JSM_CHECK(!r.jsm.findEvent(2));
+    JSM_CHECK(r.where(3) == 2);
+
+    //事件3在回放时刻进入B，其定时按虚拟时钟触发
+    r.clock->advance(1000);
+    JSM_CHECK(r.count(r.b).timers == 1);
+    std::remove(path.c_str());
+    std::remove(snap.c_str());
+}
@@ -0,0 +1,147 @@
+﻿//local
+#include "test.h"
+//boost
+#include "boost/bind.hpp"
+
+using namespace XYH_StatusMachine;
+using namespace XYH_StatusMachine::Test;
+
+JSM_TEST(ingress, ring) {
+    Xyh_IngressQueue q(5);
+    JSM_CHECK(q.capacity() == 8);
+
+    for (unsigned int i = 0; i < 8; i++) {
+        Xyh_Signal r = { i, SIG_GO, 0 };
+        JSM_CHECK(q.push(r, i % 2 ? Xyh_IngressQueue::REC_DIGEST : Xyh_IngressQueue::REC_PROCESS));
+    }
+    Xyh_Signal full = { 8, SIG_GO, 0 };
+    JSM_CHECK(!q.push(full, Xyh_IngressQueue::REC_PROCESS));
+    JSM_CHECK(q.size() == 8);
+
+    //先进先出，处理方式随记录保存
+    Xyh_Signal r;
+    unsigned char kind = 0;
+    for (unsigned int i = 0; i < 8; i++) {
+        JSM_CHECK(q.pop(r, kind));
+        JSM_CHECK(r.event == i && kind == (i % 2 ? Xyh_IngressQueue::REC_DIGEST : Xyh_IngressQueue::REC_PROCESS));
+    }
+    JSM_CHECK(!q.pop(r, kind));
+    JSM_CHECK(q.push(full, Xyh_IngressQueue::REC_PROCESS));
+}
+
+JSM_TEST(ingress, highWater) {
+    Machine m;
+    for (unsigned int i = 0; i < 6; i++) {
+        m.add(i, m.a);
+    }
+    m.jsm.enableIngress(8, 4);
+
+    //达到高水位后拒绝提交，直到状态机线程取走记录
+    for (unsigned int i = 0; i < 4; i++) {
+        JSM_CHECK(m.jsm.submit(i, SIG_GO, 0) == RES_OK);
+    }
+    JSM_CHECK(m.jsm.submit(4, SIG_GO, 0) == RES_BUSY);
+    JSM_CHECK(m.jsm.submitDigestion(4, SIG_SELF, 0) == RES_BUSY);
+    JSM_CHECK(m.jsm.ingressBusy() == 2);
+    JSM_CHECK(m.where(0) == 1);
+
+    m.io.poll();
+    m.io.restart();
+    JSM_CHECK(m.jsm.occupancy(2) == 4);
+
+    JSM_CHECK(m.jsm.submit(4, SIG_GO, 0) == RES_OK);
+    JSM_CHECK(m.jsm.submit(5, SIG_BACK, 0) == RES_OK);
+    JSM_CHECK(m.jsm.submit(99, SIG_GO, 0) == RES_OK);
+    m.io.poll();
+    JSM_CHECK(m.where(4) == 2);
+    JSM_CHECK(m.where(5) == 1);
+    JSM_CHECK(m.jsm.ingressRejected() == 2);
+}
+
+JSM_TEST(ingress, batches) {
+    //超过单批数量的记录分多次处理，同一事件保持提交顺序
+    Machine m;
+    m.add(1, m.a);
+    m.jsm.enableIngress(64, 0, 4);
+    for (unsigned int i = 0; i < 21; i++) {
+        JSM_CHECK(m.jsm.submit(1, i % 2 ? SIG_BACK : SIG_GO, 0) == RES_OK);
+    }
+    m.io.poll();
+    JSM_CHECK(m.where(1) == 2);
+    JSM_CHECK(m.jsm.ingressRejected() == 0);
+}
+
+namespace {
+    void addToB(shared_ptr<Xyh_Status> b, unsigned int id, Xyh_Jsm& jsm) {
+        shared_ptr<Xyh_Event> e = jsm.createEvent(id, "");
+        jsm.addEvent(e);
+        e->place(b, 0, 0);
+    }
+
+    void release(unsigned int id, Xyh_Jsm& jsm) {
+        jsm.relEvent(id);
+    }
+}
+
+JSM_TEST(ingress, calls) {
+    //操作与信号按提交顺序执行，高水位只限制信号
+    Machine m;
+    m.jsm.enableIngress(8, 3);
+    JSM_CHECK(m.jsm.submit(1, SIG_BACK, 0) == RES_OK);
+    m.jsm.submitCall(boost::bind(&addToB, m.b, 1, _1));
+    JSM_CHECK(m.jsm.submit(1, SIG_BACK, 0) == RES_OK);
+    JSM_CHECK(m.jsm.submit(1, SIG_GO, 0) == RES_BUSY);
+    m.jsm.submitCall(boost::bind(&release, 1, _1));
+    m.io.poll();
+    JSM_CHECK(!m.jsm.findEvent(1));
+    JSM_CHECK(m.jsm.ingressRejected() == 1);
+    JSM_CHECK(m.jsm.occupancy(1) == 0);
+    JSM_CHECK(m.count(m.a).routines == 1);
+
+    //未执行的操作随状态机销毁释放
+    Machine d;
+    d.jsm.enableIngress(8);
+    d.jsm.submitCall(boost::bind(&addToB, d.b, 1, _1));
+}
+
+JSM_TEST(post, coalescing) {
+    Machine m;
+    m.add(1, m.a);
+    m.add(2, m.a);
+    m.jsm.setCoalescing(SIG_SELF);
+
+    int first = 1;
+    int second = 2;
+    JSM_CHECK(m.jsm.post(1, SIG_SELF, &first));
+    JSM_CHECK(!m.jsm.post(1, SIG_SELF, &second));
+    JSM_CHECK(m.jsm.post(2, SIG_SELF, &first));
+    JSM_CHECK(m.jsm.post(1, SIG_GO, 0));
+    JSM_CHECK(m.jsm.queued() == 3);
+    JSM_CHECK(m.jsm.coalesced() == 1);
+
+    unsigned long long routines = m.count(m.a).routines;
+    m.io.poll();
+    JSM_CHECK(m.jsm.queued() == 0);
+    JSM_CHECK(m.count(m.a).routines == routines + 2);
+    JSM_CHECK(m.where(1) == 2);
+
+    //已处理的记录不再参与合并
+    JSM_CHECK(m.jsm.post(1, SIG_SELF, &first));
+}
+
+JSM_TEST(post, lanes) {
+    Machine m;
+    m.add(1, m.a);
+    m.jsm.setSignalLane(SIG_BACK, 0);
+    JSM_CHECK_THROW(m.jsm.setSignalLane(SIG_GO, Xyh_Jsm::LANES));
+
+    //低优先级的GO先投递，高优先级的BACK先处理；B上没有BACK之前的事件无法返回
+    m.jsm.post(1, SIG_GO, 0);
+    m.jsm.post(1, SIG_BACK, 0);
+    JSM_CHECK(m.jsm.deliver(1) == 1);
+    JSM_CHECK(m.where(1) == 1);
+    JSM_CHECK(m.jsm.rejects(1, SIG_BACK).noRoute == 1);
+    JSM_CHECK(m.jsm.deliver(10) == 1);
+    JSM_CHECK(m.where(1) == 2);
+    JSM_CHECK(m.jsm.deliver(10) == 0);
+}
@@ -0,0 +1,234 @@
+﻿//local
+#include "test.h"
+#include "fsm_recorder.h"
+//std
+#include <cstring>
+#include <fstream>
+#include <iterator>
+//boost
+#include "boost/bind.hpp"
+#include "boost/ref.hpp"
+#include "boost/thread.hpp"
+//system
+#ifndef WIN32
+#include <csignal>
+#include <cstdlib>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace XYH_StatusMachine;
+using namespace XYH_StatusMachine::Test;
+
+namespace {
+    /**
+     说明：按回调顺序收集记录
+    */
+    struct Collector {
+        vector<unsigned int> threads;
+        vector<Xyh_Recorder::Entry> entries;
+
+        void operator()(unsigned int thread, const Xyh_Recorder::Entry& e) {
+            threads.push_back(thread);
+            entries.push_back(e);
+        }
+
+        /**
+         描述：判断与另一次收集的结果是否相同
+        */
+        bool same(const Collector& rhs) const {
+            if (threads != rhs.threads || entries.size() != rhs.entries.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < entries.size(); i++) {
+                if (0 != std::memcmp(&entries[i], &rhs.entries[i], sizeof(Xyh_Recorder::Entry))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    size_t count(const Xyh_Recorder& r) {
+        Collector c;
+        return r.collect(boost::ref(c));
+    }
+
+    std::string readFile(const std::string& path) {
+        std::ifstream in(path.c_str(), std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+
+    /**
+     描述：以tick为序号追加n条记录
+    */
+    void fill(Xyh_Recorder* r, unsigned int event, unsigned long long from, unsigned long long n) {
+        for (unsigned long long i = from; i < from + n; i++) {
+            r->record(Xyh_Recorder::ENT_MOVE, i, 1, event, 1, 2, SIG_GO);
+        }
+    }
+
+    /**
+     描述：让状态机在记录器中留下放入、转移、自环与定时记录
+    */
+    void drive(Machine& m) {
+        m.virtualTime();
+        m.add(7, m.a);
+        m.clock->advance(5);
+        m.jsm.tryProcess(7, SIG_GO, 0);
+        m.jsm.tryProcess(7, SIG_SELF, 0);
+        m.clock->advance(100);
+    }
+}
+
+JSM_TEST(recorder, wrap) {
+    //容量向上取整为8；写满后覆盖最早的记录，正在写入的槽位不导出，其余按写入顺序回调
+    Xyh_Recorder r(5);
+    Collector c;
+    JSM_CHECK(r.collect(boost::ref(c)) == 0);
+
+    fill(&r, 1, 0, 6);
+    JSM_CHECK(r.collect(boost::ref(c)) == 6);
+    for (size_t i = 0; i < c.entries.size(); i++) {
+        JSM_CHECK(c.entries[i].tick == i && c.threads[i] == 0);
+    }
+
+    fill(&r, 1, 6, 14);
+    Collector w;
+    JSM_CHECK(r.collect(boost::ref(w)) == 7);
+    for (size_t i = 0; i < w.entries.size(); i++) {
+        JSM_CHECK(w.entries[i].tick == 13 + i);
+        JSM_CHECK(w.entries[i].kind == Xyh_Recorder::ENT_MOVE && w.entries[i].event == 1);
+    }
+}
+
+JSM_TEST(recorder, transitions) {
+    //状态机按发生顺序记录放入、转移、自环与定时
+    Machine m(100);
+    shared_ptr<Xyh_Recorder> r(new Xyh_Recorder(64));
+    m.jsm.setRecorder(r);
+    JSM_CHECK(m.jsm.recorder() == r.get());
+    drive(m);
+
+    Collector c;
+    r->collect(boost::ref(c));
+    const unsigned char kinds[] = {
+        Xyh_Recorder::ENT_PLACE, Xyh_Recorder::ENT_MOVE, Xyh_Recorder::ENT_MOVE, Xyh_Recorder::ENT_TIMER
+    };
+    JSM_CHECK(c.entries.size() == sizeof(kinds));
+    for (size_t i = 0; i < c.entries.size() && i < sizeof(kinds); i++) {
+        JSM_CHECK(c.entries[i].kind == kinds[i] && c.entries[i].event == 7);
+    }
+    if (c.entries.size() == sizeof(kinds)) {
+        JSM_CHECK(c.entries[0].from == Xyh_Recorder::NO_STATUS && c.entries[0].to == 1);
+        JSM_CHECK(c.entries[1].from == 1 && c.entries[1].to == 2 && c.entries[1].signal == SIG_GO);
+        JSM_CHECK(c.entries[1].tick == c.entries[0].tick + 5);
+        JSM_CHECK(c.entries[2].from == 2 && c.entries[2].to == 2 && c.entries[2].signal == SIG_SELF);
+        JSM_CHECK(c.entries[3].signal == SIG_TIMEOUT && c.entries[3].tick == c.entries[2].tick + 100);
+    }
+}
+
+JSM_TEST(recorder, disabled) {
+    //设置为空后不再记录，也不回到进程级记录器
+    Machine m(100);
+    shared_ptr<Xyh_Recorder> r(new Xyh_Recorder(64));
+    m.jsm.setRecorder(r);
+    m.virtualTime();
+    m.add(7, m.a);
+    size_t before = count(*r);
+    JSM_CHECK(before == 1);
+
+    m.jsm.setRecorder(shared_ptr<Xyh_Recorder>());
+    JSM_CHECK(m.jsm.recorder() == 0);
+    Collector global;
+    Xyh_Recorder::global()->collect(boost::ref(global));
+
+    m.jsm.tryProcess(7, SIG_GO, 0);
+    m.add(8, m.b);
+    JSM_CHECK(count(*r) == before);
+    Collector after;
+    Xyh_Recorder::global()->collect(boost::ref(after));
+    JSM_CHECK(after.same(global));
+}
+
+JSM_TEST(recorder, dump) {
+    //两个线程各自的缓冲区导出后按线程与时间顺序读回
+    std::string path = tempPath("flight");
+    Xyh_Recorder r(16);
+    fill(&r, 1, 0, 40);
+    boost::thread t(boost::bind(&fill, &r, 2, 100, 5));
+    t.join();
+
+    Collector c;
+    JSM_CHECK(r.collect(boost::ref(c)) == 20);
+    JSM_CHECK(r.dump(path) == 20);
+    Collector d;
+    JSM_CHECK(Xyh_Recorder::read(path, boost::ref(d)) == 20);
+    JSM_CHECK(d.same(c));
+
+    //文件格式不正确时抛出异常
+    std::ofstream(path.c_str(), std::ios::binary | std::ios::trunc) << "not a flight record";
+    JSM_CHECK_THROW(Xyh_Recorder::read(path, Xyh_Recorder::Visitor()));
+    JSM_CHECK_THROW(Xyh_Recorder::read(tempPath("flight.missing"), Xyh_Recorder::Visitor()));
+    std::remove(path.c_str());
+}
+
+#ifndef WIN32
+JSM_TEST(recorder, fatal) {
+    //致命信号时不分配内存地导出，内容与dump相同
+    std::string path = tempPath("flight");
+    std::string fatal = tempPath("flight.fatal");
+    Xyh_Recorder r(16);
+    fill(&r, 1, 0, 21);
+    r.dump(path);
+
+    pid_t child = fork();
+    if (0 == child) {
+        r.dumpOnFatal(fatal);
+        std::abort();
+    }
+    int status = 0;
+    JSM_CHECK(waitpid(child, &status, 0) == child);
+    JSM_CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+
+    std::string dumped = readFile(path);
+    JSM_CHECK(!dumped.empty() && readFile(fatal) == dumped);
+    std::remove(path.c_str());
+    std::remove(fatal.c_str());
+}
+#endif
+
+#if defined(JSM_FLIGHT) && !defined(WIN32)
+JSM_TEST(recorder, decode) {
+    //jsm_flight按事件过滤并逐行输出导出文件中的记录
+    std::string path = tempPath("flight");
+    Machine m(100);
+    shared_ptr<Xyh_Recorder> r(new Xyh_Recorder(64));
+    m.jsm.setRecorder(r);
+    drive(m);
+    m.add(8, m.a);
+    r->dump(path);
+
+    std::string command = std::string(JSM_FLIGHT) + " --json --event 7 " + path + " 2>/dev/null";
+    FILE* out = popen(command.c_str(), "r");
+    JSM_CHECK(out != 0);
+    vector<std::string> lines;
+    char line[512];
+    while (out && std::fgets(line, sizeof(line), out)) {
+        lines.push_back(line);
+    }
+    JSM_CHECK(out && pclose(out) == 0);
+
+    const char* kinds[] = { "place", "move", "move", "timer" };
+    JSM_CHECK(lines.size() == 4);
+    for (size_t i = 0; i < lines.size() && i < 4; i++) {
+        JSM_CHECK(lines[i].find(std::string("\"kind\": \"") + kinds[i] + "\"") != std::string::npos);
+        JSM_CHECK(lines[i].find("\"event\": 7,") != std::string::npos);
+    }
+    if (lines.size() == 4) {
+        JSM_CHECK(lines[0].find("\"from\": -1, \"to\": 1,") != std::string::npos);
+        JSM_CHECK(lines[1].find("\"from\": 1, \"to\": 2, \"signal\": 1}") != std::string::npos);
+    }
+    std::remove(path.c_str());
+}
+#endif
@@ -0,0 +1,140 @@
+﻿//local
+#include "test.h"
+#include "fsm_shard.h"
+
+using namespace XYH_StatusMachine;
+using namespace XYH_StatusMachine::Test;
+
+namespace {
+    void buildTopology(Xyh_Definition& def) {
+        shared_ptr<Xyh_Status> a(new CountStatus(1));
+        shared_ptr<Xyh_Status> b(new CountStatus(2));
+        a->addLink(SIG_GO, b);
+        b->addLink(SIG_BACK, a);
+        b->addLink(SIG_SELF);
+        def.addStatus(a);
+        def.addStatus(b);
+    }
+
+    /**
+     说明：放入时抛出异常的状态；信号1抛出非标准异常，信号2抛出std::runtime_error
+    */
+    class ThrowStatus : public Xyh_Status {
+    public:
+        explicit ThrowStatus(unsigned int id) : Xyh_Status(id, "throw", false) { }
+
+        virtual void routine(shared_ptr<Xyh_Event>& e, unsigned int label, const void* msg) {
+            if (1 == label) {
+                throw 42;
+            }
+            if (2 == label) {
+                throw std::runtime_error("place failed");
+            }
+        }
+    };
+
+    void buildThrowing(Xyh_Definition& def) {
+        buildTopology(def);
+        def.addStatus(shared_ptr<Xyh_Status>(new ThrowStatus(3)));
+    }
+
+    unsigned int whereIn(Xyh_ShardedJsm& s, unsigned int id) {
+        shared_ptr<Xyh_Event> e = s.shard(s.shardOf(id)).findEvent(id);
+        return (e && e->getCurrentStatus()) ? e->getCurrentStatus()->getId() : Xyh_Jsm::NO_STATUS;
+    }
+}
+
+JSM_TEST(shard, process) {
+    Xyh_ShardedJsm s(1, 3, &buildTopology, 64);
+    JSM_CHECK(s.shards() == 3);
+    for (unsigned int i = 0; i < 30; i++) {
+        s.addEvent(shared_ptr<Xyh_Event>(new Xyh_Event(i, "")), 1, 0, 0);
+        JSM_CHECK(s.shard(s.shardOf(i)).frozen());
+    }
+
+    //所有分片共享同一组状态
+    JSM_CHECK(s.shard(0).findStatus(1) == s.shard(2).findStatus(1));
+    for (unsigned int i = 0; i < 30; i++) {
+        JSM_CHECK(s.process(i, SIG_GO, 0) == RES_OK);
+    }
+    JSM_CHECK(s.digestion(5, SIG_SELF, 0) == RES_OK);
+    JSM_CHECK(s.process(1000, SIG_GO, 0) == RES_OK);
+    JSM_CHECK(s.process(7, SIG_GO, 0) == RES_OK);
+    s.start();
+    s.stop();
+
+    bool moved = true;
+    for (unsigned int i = 0; i < 30; i++) {
+        moved = moved && whereIn(s, i) == 2;
+    }
+    JSM_CHECK(moved);
+
+    //不存在的事件与没有路线的信号计入rejected
+    JSM_CHECK(s.rejected() == 2);
+    JSM_CHECK(s.busy() == 0);
+}
+
+JSM_TEST(shard, broadcast) {
+    Xyh_ShardedJsm s(1, 2, &buildTopology);
+    for (unsigned int i = 0; i < 10; i++) {
+        s.addEvent(shared_ptr<Xyh_Event>(new Xyh_Event(i, "")), 2, 0, 0);
+    }
+    s.addEvent(shared_ptr<Xyh_Event>(new Xyh_Event(10, "")), 99, 0, 0);
+    s.process(SIG_BACK, 0);
+    s.start();
+    s.stop();
+
+    unsigned int back = 0;
+    for (unsigned int i = 0; i < 10; i++) {
+        back += whereIn(s, i) == 1 ? 1 : 0;
+    }
+    JSM_CHECK(back == 10);
+    JSM_CHECK(s.rejected() == 1);
+}
+
+JSM_TEST(shard, ordering) {
+    //增删事件与信号按调用顺序在分片上执行
+    Xyh_ShardedJsm s(1, 2, &buildTopology);
+    s.addEvent(shared_ptr<Xyh_Event>(new Xyh_Event(1, "")), 1, 0, 0);
+    JSM_CHECK(s.process(1, SIG_GO, 0) == RES_OK);
+    s.addEvent(shared_ptr<Xyh_Event>(new Xyh_Event(2, "")), 1, 0, 0);
+    JSM_CHECK(s.process(2, SIG_GO, 0) == RES_OK);
+    s.relEvent(3);
+    s.addEvent(shared_ptr<Xyh_Event>(new Xyh_Event(3, "")), 1, 0, 0);
+    s.process(SIG_GO, 0);
+    s.relEvent(3);
+    JSM_CHECK(s.process(3, SIG_BACK, 0) == RES_OK);
+    s.start();
+    s.stop();
+
+    JSM_CHECK(whereIn(s, 1) == 2 && whereIn(s, 2) == 2);
+    JSM_CHECK(!s.shard(s.shardOf(3)).findEvent(3));
+
+    //事件3在收到BACK之前已被删除
+    JSM_CHECK(s.rejected() == 1);
+}
+
+JSM_TEST(shard, unplaced) {
+    //只加入分片而未放入状态的事件收到信号时计入rejected
+    Xyh_ShardedJsm s(1, 2, &buildTopology);
+    s.addEvent(shared_ptr<Xyh_Event>(new Xyh_Event(1, "")));
+    JSM_CHECK(s.process(1, SIG_GO, 0) == RES_OK);
+    JSM_CHECK(s.digestion(1, SIG_SELF, 0) == RES_OK);
+    s.start();
+    s.stop();
+    JSM_CHECK(s.rejected() == 2);
+    JSM_CHECK(s.shard(s.shardOf(1)).findEvent(1));
+}
+
+JSM_TEST(shard, throwingPlace) {
+    //放入状态时处理函数抛出的任何异常都计入rejected，分片线程继续处理后续操作
+    Xyh_ShardedJsm s(1, 1, &buildThrowing);
+    s.addEvent(shared_ptr<Xyh_Event>(new Xyh_Event(1, "")), 3, 1, 0);
+    s.addEvent(shared_ptr<Xyh_Event>(new Xyh_Event(2, "")), 3, 2, 0);
+    s.addEvent(shared_ptr<Xyh_Event>(new Xyh_Event(3, "")), 1, 0, 0);
+    JSM_CHECK(s.process(3, SIG_GO, 0) == RES_OK);
+    s.start();
+    s.stop();
+    JSM_CHECK(s.rejected() == 2);
+    JSM_CHECK(whereIn(s, 3) == 2);
+}
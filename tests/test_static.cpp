@@ -0,0 +1,141 @@
+﻿//local
+#include "test.h"
+#include "fsm_static.h"
+#include "fsm_async.h"
+
+using namespace XYH_StatusMachine;
+using namespace XYH_StatusMachine::Test;
+
+namespace {
+    typedef boost::mpl::vector<Xyh_State<1>, Xyh_State<2> > DoorStates;
+    typedef boost::mpl::vector<
+        Xyh_Link<1, SIG_GO, 2>,
+        Xyh_Link<2, SIG_BACK, 1>,
+        Xyh_Link<2, SIG_SELF, 2> > DoorLinks;
+    typedef boost::mpl::vector<Xyh_Timeout<2, SIG_TIMEOUT, 500> > DoorTimeouts;
+
+    BOOST_STATIC_ASSERT((Xyh_StaticTarget<DoorLinks, 1, SIG_GO>::found));
+    BOOST_STATIC_ASSERT((Xyh_StaticTarget<DoorLinks, 1, SIG_GO>::to == 2));
+    BOOST_STATIC_ASSERT((!Xyh_StaticTarget<DoorLinks, 1, SIG_BACK>::found));
+
+    /**
+     说明：编译期定义的门；1为关闭，2为打开，打开500ms后超时
+    */
+    class Door : public Xyh_StaticJsm<Door, DoorStates, DoorLinks, DoorTimeouts> {
+        typedef Xyh_StaticJsm<Door, DoorStates, DoorLinks, DoorTimeouts> Base;
+
+    public:
+        using Base::routine;
+        using Base::timeout;
+
+        explicit Door(boost::asio::io_service& io) : Base(1, io), opened(0), closed(0), timeouts(0) { }
+
+        void routine(Xyh_StateTag<1>, Xyh_Event& e, unsigned int signal, const void* msg) { closed++; }
+
+        void routine(Xyh_StateTag<2>, Xyh_Event& e, unsigned int signal, const void* msg) { opened++; }
+
+        void timeout(Xyh_StateTag<2>, Xyh_Event& e, unsigned int label) { timeouts++; }
+
+        unsigned int opened;
+        unsigned int closed;
+        unsigned int timeouts;
+    };
+
+    /**
+     说明：异步状态；处理函数等待一个短定时后结束
+    */
+    class HoldStatus : public Xyh_AsyncStatus {
+    public:
+        HoldStatus(unsigned int id, boost::asio::io_service& io) : Xyh_AsyncStatus(id, "hold"), m_io(io) { }
+
+    protected:
+        virtual void asyncRoutine(shared_ptr<Xyh_Event>& e, unsigned int label, const void* msg,
+            boost::asio::yield_context yield) {
+            boost::asio::steady_timer t(m_io, boost::asio::chrono::milliseconds(1));
+            t.async_wait(yield);
+        }
+
+    private:
+        boost::asio::io_service& m_io;
+    };
+}
+
+JSM_TEST(static, fire) {
+    boost::asio::io_service io;
+    Door d(io);
+    JSM_CHECK(d.frozen());
+
+    shared_ptr<Xyh_Event> e = d.createEvent(1, "");
+    Xyh_Handle h = d.addEvent(e);
+    e->place(d.status<1>(), 0, 0);
+    JSM_CHECK(d.closed == 1);
+
+    JSM_CHECK(d.fire<SIG_GO>(h, 0) == RES_OK);
+    JSM_CHECK(e->getCurrentStatus()->getId() == 2 && d.opened == 1);
+    JSM_CHECK(d.fire<SIG_GO>(h, 0) == RES_NO_ROUTE);
+    JSM_CHECK(d.fire(h, SIG_SELF, 0) == RES_OK);
+    JSM_CHECK(d.opened == 2);
+    JSM_CHECK(d.fire(h, SIG_UNKNOWN, 0) == RES_NO_ROUTE);
+    JSM_CHECK(d.fire<SIG_BACK>(h, 0) == RES_OK);
+    JSM_CHECK(d.closed == 2);
+    JSM_CHECK(d.rejects(2, SIG_GO).noRoute == 1);
+
+    //运行期转移表同样调用派生类的处理函数
+    JSM_CHECK(d.tryProcess(h, SIG_GO, 0) == RES_OK);
+    JSM_CHECK(d.opened == 3);
+
+    d.relEvent(h);
+    JSM_CHECK(d.fire<SIG_BACK>(h, 0) == RES_NO_EVENT);
+    JSM_CHECK(d.fire(h, SIG_BACK, 0) == RES_NO_EVENT);
+}
+
+JSM_TEST(static, suspended) {
+    //事件在其他状态机的异步处理函数中挂起时，fire同样排队而不转移
+    boost::asio::io_service io;
+    Xyh_Jsm async(2, io);
+    shared_ptr<Xyh_Status> a(new CountStatus(1));
+    shared_ptr<Xyh_Status> hold(new HoldStatus(2, io));
+    a->addLink(SIG_GO, hold);
+    async.addStatus(a);
+    async.addStatus(hold);
+    async.freeze();
+
+    shared_ptr<Xyh_Event> e = async.createEvent(1, "");
+    async.addEvent(e);
+    e->place(a, 0, 0);
+    JSM_CHECK(async.tryProcess(1, SIG_GO, 0) == RES_OK);
+    JSM_CHECK(e->suspended());
+
+    Door d(io);
+    Xyh_Handle h = d.addEvent(e);
+    JSM_CHECK(d.fire<SIG_BACK>(h, 0) == RES_DEFERRED);
+    JSM_CHECK(d.fire(h, SIG_SELF, 0) == RES_DEFERRED);
+    JSM_CHECK(d.opened == 0 && d.closed == 0);
+    JSM_CHECK(d.rejects().noRoute == 0);
+
+    io.run();
+    JSM_CHECK(!e->suspended());
+}
+
+JSM_TEST(static, timeout) {
+    boost::asio::io_service io;
+    shared_ptr<Xyh_VirtualClock> clock(new Xyh_VirtualClock);
+    Door d(io);
+    d.useClock(clock);
+
+    shared_ptr<Xyh_Event> e = d.createEvent(1, "");
+    Xyh_Handle h = d.addEvent(e);
+    e->place(d.status<1>(), 0, 0);
+    d.fire<SIG_GO>(h, 0);
+    clock->advance(499);
+    JSM_CHECK(d.timeouts == 0);
+    clock->advance(1);
+    JSM_CHECK(d.timeouts == 1);
+
+    //离开状态后定时失效
+    d.fire<SIG_BACK>(h, 0);
+    d.fire<SIG_GO>(h, 0);
+    d.fire<SIG_BACK>(h, 0);
+    clock->advance(1000);
+    JSM_CHECK(d.timeouts == 1);
+}
@@ -0,0 +1,105 @@
+﻿//local
+#include "fsm_recorder.h"
+//std
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+//boost
+#include "boost/bind.hpp"
+
+using namespace XYH_StatusMachine;
+
+namespace {
+    /**
+     说明：输出条件
+    */
+    struct Filter {
+        //只输出该状态机/事件的记录；为NO_FILTER时不限定
+        unsigned int machine;
+        unsigned int event;
+
+        //是否输出JSON行
+        bool json;
+    };
+
+    const unsigned int NO_FILTER = 0xFFFFFFFF;
+
+    void printStatus(unsigned int id) {
+        if (Xyh_Recorder::NO_STATUS == id) {
+            std::printf("%8s", "-");
+        }
+        else {
+            std::printf("%8u", id);
+        }
+    }
+
+    void print(const Filter* f, unsigned int thread, const Xyh_Recorder::Entry& e) {
+        if ((NO_FILTER != f->machine && e.machine != f->machine) || (NO_FILTER != f->event && e.event != f->event)) {
+            return;
+        }
+
+        if (f->json) {
+            std::printf("{\"thread\": %u, \"tick\": %llu, \"kind\": \"%s\", \"machine\": %u, \"event\": %u, "
+                "\"from\": %lld, \"to\": %u, \"signal\": %u}\n",
+                thread, e.tick, Xyh_Recorder::kindName(e.kind), e.machine, e.event,
+                Xyh_Recorder::NO_STATUS == e.from ? -1LL : (long long)e.from, e.to, e.signal);
+            return;
+        }
+
+        std::printf("%6u %12llu %-6s %8u %10u ", thread, e.tick, Xyh_Recorder::kindName(e.kind), e.machine, e.event);
+        printStatus(e.from);
+        std::printf(" -> ");
+        printStatus(e.to);
+        std::printf(" %8u\n", e.signal);
+    }
+
+    void usage(const char* self) {
+        std::fprintf(stderr,
+            "usage: %s [--json] [--machine <id>] [--event <id>] <file>\n"
+            "  --json      print one JSON object per line\n"
+            "  --machine   only print entries of this machine\n"
+            "  --event     only print entries of this event\n", self);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Filter filter = { NO_FILTER, NO_FILTER, false };
+    const char* path = 0;
+    for (int i = 1; i < argc; i++) {
+        if (0 == std::strcmp(argv[i], "--json")) {
+            filter.json = true;
+        }
+        else if (0 == std::strcmp(argv[i], "--machine") && i + 1 < argc) {
+            filter.machine = (unsigned int)std::strtoul(argv[++i], 0, 10);
+        }
+        else if (0 == std::strcmp(argv[i], "--event") && i + 1 < argc) {
+            filter.event = (unsigned int)std::strtoul(argv[++i], 0, 10);
+        }
+        else if (argv[i][0] == '-' || path) {
+            usage(argv[0]);
+            return 1;
+        }
+        else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!filter.json) {
+        std::printf("%6s %12s %-6s %8s %10s %8s    %8s %8s\n",
+            "thread", "tick_ms", "kind", "machine", "event", "from", "to", "signal");
+    }
+    try {
+        size_t n = Xyh_Recorder::read(path, boost::bind(&print, &filter, _1, _2));
+        std::fprintf(stderr, "%lu entries\n", (unsigned long)n);
+    }
+    catch (std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}